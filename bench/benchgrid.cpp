@@ -0,0 +1,178 @@
+/*  Usage: xvfb-run ./benchgrid [WORD...]
+    Measures the building and drawing of the result pages of the words
+    (by default, a few common forms that give several pages each), with
+    the QLabel grid that was used before ConjugationGrid, and with
+    ConjugationGrid.  Each page is laid out and rendered into an image:
+    no window is shown, but Qt 4 needs a display, hence xvfb-run.
+    Then measures a lookup of each word with the pages of all its tabs
+    built, as before the tabs were built lazily, and with the page of
+    the current tab only.
+*/
+
+#ifndef VERBSFRXML
+#error VERBSFRXML expected to be a macro designating the verbs-fr.xml file
+#endif
+#ifndef CONJUGATIONFRXML
+#error CONJUGATIONFRXML expected to be a macro designating the conjugation-fr.xml file
+#endif
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QStringList>
+#include <QtCore/QTextStream>
+#include <QtGui/QApplication>
+#include <QtGui/QGridLayout>
+#include <QtGui/QImage>
+#include <QtGui/QLabel>
+#include <QtGui/QVBoxLayout>
+
+#include "../conjugationgrid.h"
+#include "../lookupjob.h"
+
+static const int numRounds = 20;
+
+static const char *defaultWords[] = {
+    "est", "suis", "avons", "fait", "vis", "pris", "mange", "allions", "dit", "sortes"
+};
+
+/* The result page before ConjugationGrid: a style sheet and a QLabel
+   per tense name, a QLabel per person */
+static QWidget *makeLabelPage(const ResultPageModel &model)
+{
+    QGridLayout *grid = new QGridLayout;
+    for (int c = 0; c < model.cells.size(); ++c) {
+        const ResultCell &cell = model.cells.at(c);
+
+        QLabel *tenseLabel = new QLabel();
+        tenseLabel->setText(cell.tenseName);
+        tenseLabel->setStyleSheet("QLabel {background-color: #44A51C;"
+                                  "border-top-left-radius: 4px;"
+                                  "border-top-right-radius: 4px;"
+                                  "padding-left: 10px; padding-right: 10px}");
+
+        QVBoxLayout *vbox = new QVBoxLayout();
+        vbox->addWidget(tenseLabel);
+        for (int i = 0; i < cell.persons.size(); ++i) {
+            /* The same markup as the former highlighting */
+            QString text = cell.persons.at(i);
+            for (int m = cell.marks.size() - 1; m >= 0; --m) {
+                const ConjugateMark &mark = cell.marks.at(m);
+                if (mark.person == i) {
+                    text.insert(mark.start + mark.length, "</font>");
+                    text.insert(mark.start, "<font color='#D20020'>");
+                }
+            }
+            QLabel *lb = new QLabel(text);
+            lb->setMargin(4);
+            vbox->addWidget(lb, 1);
+        }
+        grid->addLayout(vbox, cell.row, cell.col);
+    }
+    QWidget *page = new QWidget;
+    page->setLayout(grid);
+    return page;
+}
+
+/* Builds, lays out and draws every page; returns the time per page in
+   microseconds, and the number of widgets per page in 'numWidgets' */
+static double measure(const QList<ResultPageModel> &pages, bool withLabels,
+                      double &numWidgets)
+{
+    QImage image(1024, 768, QImage::Format_ARGB32_Premultiplied);
+    long widgets = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int round = 0; round < numRounds; ++round) {
+        for (int p = 0; p < pages.size(); ++p) {
+            QWidget *page;
+            if (withLabels)
+                page = makeLabelPage(pages.at(p));
+            else
+                page = new ConjugationGrid(pages.at(p));
+            page->resize(page->sizeHint());
+            page->render(&image);
+            widgets += 1 + page->findChildren<QWidget *>().size();
+            delete page;
+        }
+    }
+    qint64 ns = timer.nsecsElapsed();
+    long count = long(numRounds) * pages.size();
+    numWidgets = double(widgets) / count;
+    return ns / 1000.0 / count;
+}
+
+/* Builds the pages of each lookup, all of them or the one of the
+   current tab only, and draws the current one; returns the time per
+   lookup in microseconds */
+static double measureLookups(const QList< QList<ResultPageModel> > &lookups, bool lazy)
+{
+    QImage image(1024, 768, QImage::Format_ARGB32_Premultiplied);
+    QElapsedTimer timer;
+    timer.start();
+    for (int round = 0; round < numRounds; ++round) {
+        for (int l = 0; l < lookups.size(); ++l) {
+            const QList<ResultPageModel> &pages = lookups.at(l);
+            int numBuilt = lazy ? qMin(1, pages.size()) : pages.size();
+            QList<QWidget *> built;
+            for (int p = 0; p < numBuilt; ++p) {
+                QWidget *page = new ConjugationGrid(pages.at(p));
+                page->resize(page->sizeHint());
+                built.append(page);
+            }
+            if (!built.isEmpty())
+                built.first()->render(&image);
+            qDeleteAll(built);
+        }
+    }
+    qint64 ns = timer.nsecsElapsed();
+    return ns / 1000.0 / (long(numRounds) * lookups.size());
+}
+
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    QStringList words = app.arguments().mid(1);
+    if (words.isEmpty()) {
+        for (size_t i = 0; i < sizeof(defaultWords) / sizeof(defaultWords[0]); ++i)
+            words.append(QString::fromUtf8(defaultWords[i]));
+    }
+
+    FrenchVerbDictionary fvd(CONJUGATIONFRXML, VERBSFRXML, false,
+                             FrenchVerbDictionary::FRENCH);
+    QList<ResultPageModel> pages;
+    QList< QList<ResultPageModel> > lookups;   // The pages of each word
+    {
+        TypingState typing;
+        QAtomicInt serial(1);
+        for (int w = 0; w < words.size(); ++w) {
+            LookupJob job(&fvd, &typing, words.at(w), false, 1, &serial);
+            lookups.append(job.run().pages);
+            pages.append(lookups.last());
+        }
+    }
+    out << words.size() << " words, " << pages.size() << " pages, "
+        << numRounds << " rounds\n";
+    if (pages.isEmpty())
+        return 1;
+
+    /* A first pass loads the fonts and fills the caches of Qt */
+    double numWidgets;
+    measure(pages, true, numWidgets);
+    measure(pages, false, numWidgets);
+
+    double labelTime = measure(pages, true, numWidgets);
+    out << "QLabel grid:     " << labelTime << " us/page, "
+        << numWidgets << " widgets/page\n";
+    double gridTime = measure(pages, false, numWidgets);
+    out << "ConjugationGrid: " << gridTime << " us/page, "
+        << numWidgets << " widgets/page\n";
+    out << "speed-up:        " << labelTime / gridTime << "\n";
+
+    measureLookups(lookups, false);
+    double eagerTime = measureLookups(lookups, false);
+    out << "all tabs built:  " << eagerTime << " us/lookup\n";
+    double lazyTime = measureLookups(lookups, true);
+    out << "current tab:     " << lazyTime << " us/lookup\n";
+    return 0;
+}
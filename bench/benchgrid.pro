@@ -0,0 +1,33 @@
+# Headless benchmark of the result pages: the QLabel grid that was used
+# before, against ConjugationGrid.
+#   qmake && make && xvfb-run ./benchgrid
+TEMPLATE = app
+TARGET = benchgrid
+CONFIG += console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ..
+SOURCES += benchgrid.cpp \
+    ../conjugationgrid.cpp \
+    ../lookupjob.cpp \
+    ../verbiste/misc-types.cpp \
+    ../verbiste/FrenchVerbDictionary.cpp \
+    ../verbiste/c-api.cpp \
+    ../verbiste/DictionaryRegistry.cpp \
+    ../verbiste/LookupCache.cpp \
+    ../verbiste/BitVector.cpp \
+    ../verbiste/ParallelTasks.cpp \
+    ../verbiste/ReloadableDictionary.cpp \
+    ../verbiste/VerbFormFilter.cpp \
+    ../gui/conjugation.cpp
+HEADERS += ../conjugationgrid.h \
+    ../lookupjob.h
+
+unix: CONFIG += link_pkgconfig
+unix: PKGCONFIG += libxml-2.0
+unix: LIBS += -lpthread
+
+DEFINES += ICONV_CONST=
+DEFINES += LIBDATADIR=\\\"$$PWD/../data\\\"
+DEFINES += CONJUGATIONFRXML=\\\"$$PWD/../data/conjugation-fr.xml\\\"
+DEFINES += VERBSFRXML=\\\"$$PWD/../data/verbs-fr.xml\\\"
@@ -0,0 +1,135 @@
+#include "conjugationgrid.h"
+
+#include <QtCore/QEvent>
+#include <QtGui/QPainter>
+#include <QtGui/QPaintEvent>
+
+/* Same look as the QLabel version: tense names on a green tab,
+   4 pixels around each person */
+static const int margin = 9;
+static const int spacing = 6;
+static const int headerPadding = 10;
+static const int headerRadius = 4;
+static const int personMargin = 4;
+static const QColor headerColor(0x44, 0xA5, 0x1C);
+static const QColor markColor(0xD2, 0x00, 0x20);
+
+ConjugationGrid::ConjugationGrid(const ResultPageModel &model, QWidget *parent)
+    : QWidget(parent),
+      page(model),
+      colX(NUM_COLS), colWidth(NUM_COLS), rowY(NUM_ROWS),
+      headerHeight(0), personHeight(0)
+{
+    relayout();
+}
+
+QSize ConjugationGrid::sizeHint() const
+{
+    return contentSize;
+}
+
+/* Computes the position of the rows and columns from the texts, once
+   per page and font, so that painting only draws */
+void ConjugationGrid::relayout()
+{
+    const QFontMetrics fm = fontMetrics();
+    headerHeight = fm.height() + 2;
+    personHeight = fm.height() + 2 * personMargin;
+
+    QVector<int> rowHeight(NUM_ROWS, 0);
+    colWidth.fill(0);
+    for (int c = 0; c < page.cells.size(); ++c) {
+        const ResultCell &cell = page.cells.at(c);
+        int width = fm.width(cell.tenseName) + 2 * headerPadding;
+        for (int i = 0; i < cell.persons.size(); ++i)
+            width = qMax(width, fm.width(cell.persons.at(i)) + 2 * personMargin);
+        int height = headerHeight + cell.persons.size() * personHeight;
+        colWidth[cell.col] = qMax(colWidth.at(cell.col), width);
+        rowHeight[cell.row] = qMax(rowHeight.at(cell.row), height);
+    }
+
+    /* Like QGridLayout, no spacing around an empty row or column */
+    int x = margin;
+    for (int col = 0; col < NUM_COLS; ++col) {
+        colX[col] = x;
+        if (colWidth.at(col) > 0)
+            x += colWidth.at(col) + spacing;
+    }
+    int y = margin;
+    for (int row = 0; row < NUM_ROWS; ++row) {
+        rowY[row] = y;
+        if (rowHeight.at(row) > 0)
+            y += rowHeight.at(row) + spacing;
+    }
+    contentSize = QSize(x - spacing + margin, y - spacing + margin);
+
+    updateGeometry();
+    resize(contentSize);
+    update();
+}
+
+void ConjugationGrid::changeEvent(QEvent *event)
+{
+    if (event->type() == QEvent::FontChange)
+        relayout();
+    QWidget::changeEvent(event);
+}
+
+void ConjugationGrid::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::Antialiasing, false);
+    const QRect &dirty = event->rect();
+    for (int c = 0; c < page.cells.size(); ++c) {
+        const ResultCell &cell = page.cells.at(c);
+        QRect area(colX.at(cell.col), rowY.at(cell.row), colWidth.at(cell.col),
+                   headerHeight + cell.persons.size() * personHeight);
+        if (area.intersects(dirty))
+            paintCell(painter, cell);
+    }
+}
+
+void ConjugationGrid::paintCell(QPainter &painter, const ResultCell &cell) const
+{
+    const QFontMetrics fm = fontMetrics();
+    const QColor textColor = palette().color(QPalette::WindowText);
+    int x = colX.at(cell.col);
+    int y = rowY.at(cell.row);
+    int width = colWidth.at(cell.col);
+
+    /* Tense name, on a tab rounded at the top only */
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(headerColor);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.drawRoundedRect(x, y, width, headerHeight, headerRadius, headerRadius);
+    painter.setRenderHint(QPainter::Antialiasing, false);
+    painter.drawRect(x, y + headerRadius, width, headerHeight - headerRadius);
+    painter.setPen(textColor);
+    painter.drawText(x + headerPadding, y + 1 + fm.ascent(), cell.tenseName);
+    y += headerHeight;
+
+    /* Persons, with the inflections that match the looked-up word in
+       another color; 'marks' is in the order of the persons */
+    int m = 0;
+    for (int i = 0; i < cell.persons.size(); ++i, y += personHeight) {
+        const QString &text = cell.persons.at(i);
+        int baseline = y + personMargin + fm.ascent();
+        int left = x + personMargin;
+        int done = 0;
+        for (; m < cell.marks.size() && cell.marks.at(m).person == i; ++m) {
+            const ConjugateMark &mark = cell.marks.at(m);
+            painter.setPen(textColor);
+            painter.drawText(left + fm.width(text, done), baseline,
+                             text.mid(done, mark.start - done));
+            painter.setPen(markColor);
+            painter.drawText(left + fm.width(text, mark.start), baseline,
+                             text.mid(mark.start, mark.length));
+            done = mark.start + mark.length;
+        }
+        painter.setPen(textColor);
+        if (done == 0)
+            painter.drawText(left, baseline, text);
+        else if (done < text.size())
+            painter.drawText(left + fm.width(text, done), baseline, text.mid(done));
+    }
+}
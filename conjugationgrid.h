@@ -0,0 +1,39 @@
+#ifndef CONJUGATIONGRID_H
+#define CONJUGATIONGRID_H
+
+#include <QtGui/QWidget>
+#include <QtCore/QVector>
+
+#include "lookupjob.h"
+
+/* Draws the 4x4 table of the tenses of one page by itself, instead of
+   a QLabel per tense name and per person: a page is one widget, laid
+   out once, with no style sheet to parse. */
+class ConjugationGrid : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit ConjugationGrid(const ResultPageModel &model, QWidget *parent = 0);
+
+    virtual QSize sizeHint() const;
+
+protected:
+    virtual void paintEvent(QPaintEvent *event);
+    virtual void changeEvent(QEvent *event);
+
+private:
+    enum { NUM_ROWS = 4, NUM_COLS = 4 };
+
+    ResultPageModel page;
+    QVector<int> colX;        // Left of each column
+    QVector<int> colWidth;    // 0 for a column without tense
+    QVector<int> rowY;        // Top of each row
+    QSize contentSize;
+    int headerHeight;
+    int personHeight;
+
+    void relayout();
+    void paintCell(QPainter &painter, const ResultCell &cell) const;
+};
+
+#endif // CONJUGATIONGRID_H
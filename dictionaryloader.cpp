@@ -0,0 +1,18 @@
+#include "dictionaryloader.h"
+
+DictionaryLoader::DictionaryLoader(DictionaryRegistry *dicts,
+                                   FrenchVerbDictionary::Language language,
+                                   QObject *parent)
+    : QThread(parent), registry(dicts), lang(language), fvd(NULL)
+{
+}
+
+void DictionaryLoader::run()
+{
+    try {
+        fvd = registry->get(lang);
+    }
+    catch (const std::logic_error &e) {
+        error = QString::fromUtf8(e.what());
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef DICTIONARYLOADER_H
+#define DICTIONARYLOADER_H
+
+#include <QtCore/QThread>
+#include <QtCore/QString>
+
+#include <verbiste/DictionaryRegistry.h>
+
+using namespace verbiste;
+
+/* Loads the dictionary of a language on a worker thread, so that the
+   window responds while the dictionary is built. finished() is emitted
+   when the dictionary, or the error, is available. */
+class DictionaryLoader : public QThread
+{
+    Q_OBJECT
+public:
+    DictionaryLoader(DictionaryRegistry *dicts,
+                     FrenchVerbDictionary::Language language,
+                     QObject *parent = 0);
+
+    // Valid after finished(): NULL if the loading failed
+    FrenchVerbDictionary *dictionary() const { return fvd; }
+    QString errorMessage() const { return error; }
+
+protected:
+    virtual void run();
+
+private:
+    DictionaryRegistry *registry;
+    FrenchVerbDictionary::Language lang;
+    FrenchVerbDictionary *fvd;
+    QString error;
+};
+
+#endif // DICTIONARYLOADER_H
@@ -27,12 +27,30 @@
 #define N_(x) (x)
 
 #include <iostream>
-#include <string.h>
 
 using namespace std;
 using namespace verbiste;
 
 
+// Tenses of the conjugation given by getConjugation(), in order.
+static const struct { Mode m; Tense t; } conjugationTenses[] =
+{
+    { INFINITIVE_MODE, PRESENT_TENSE },
+    { INDICATIVE_MODE, PRESENT_TENSE },
+    { INDICATIVE_MODE, IMPERFECT_TENSE },
+    { INDICATIVE_MODE, FUTURE_TENSE },
+    { INDICATIVE_MODE, PAST_TENSE },
+    { CONDITIONAL_MODE, PRESENT_TENSE },
+    { SUBJUNCTIVE_MODE, PRESENT_TENSE },
+    { SUBJUNCTIVE_MODE, IMPERFECT_TENSE },
+    { IMPERATIVE_MODE, PRESENT_TENSE },
+    { PARTICIPLE_MODE, PRESENT_TENSE },
+    { PARTICIPLE_MODE, PAST_TENSE },
+    { GERUND_MODE, PRESENT_TENSE },  // italian only
+    { INVALID_MODE, INVALID_TENSE }  // marks the end
+};
+
+
 void
 getConjugation(const FrenchVerbDictionary &fvd,
                const string &infinitive,
@@ -46,38 +64,21 @@ getConjugation(const FrenchVerbDictionary &fvd,
 
     try
     {
-        static const struct { Mode m; Tense t; } table[] =
-        {
-            { INFINITIVE_MODE, PRESENT_TENSE },
-            { INDICATIVE_MODE, PRESENT_TENSE },
-            { INDICATIVE_MODE, IMPERFECT_TENSE },
-            { INDICATIVE_MODE, FUTURE_TENSE },
-            { INDICATIVE_MODE, PAST_TENSE },
-            { CONDITIONAL_MODE, PRESENT_TENSE },
-            { SUBJUNCTIVE_MODE, PRESENT_TENSE },
-            { SUBJUNCTIVE_MODE, IMPERFECT_TENSE },
-            { IMPERATIVE_MODE, PRESENT_TENSE },
-            { PARTICIPLE_MODE, PRESENT_TENSE },
-            { PARTICIPLE_MODE, PAST_TENSE },
-            { GERUND_MODE, PRESENT_TENSE },  // italian only
-            { INVALID_MODE, INVALID_TENSE }  // marks the end
-        };
-
-
         string radical = FrenchVerbDictionary::getRadical(infinitive, tname);
 
         bool isItalian = (fvd.getLanguage() == FrenchVerbDictionary::ITALIAN);
 
-        for (int j = 0; table[j].m != INVALID_MODE; j++)
+        for (int j = 0; conjugationTenses[j].m != INVALID_MODE; j++)
         {
-            if (table[j].m == GERUND_MODE && !isItalian)
+            if (conjugationTenses[j].m == GERUND_MODE && !isItalian)
                 continue;
 
             dest.push_back(VVS());
             VVS &tenseDest = dest.back();
 
             VVS conjug;
-            fvd.generateTense(radical, *templ, table[j].m, table[j].t, conjug,
+            fvd.generateTense(radical, *templ,
+                                conjugationTenses[j].m, conjugationTenses[j].t, conjug,
                                 includePronouns,
                                 fvd.isVerbStartingWithAspirateH(infinitive),
                                 isItalian);
@@ -137,52 +138,97 @@ string getTenseNameForTableCell(int row, int col, bool isItalian)
 }
 
 
+bool
+getConjugationTense(size_t tenseIndex, bool isItalian, Mode &mode, Tense &tense)
+{
+    // The gerund, which comes last, is only in the Italian conjugation.
+    for (size_t j = 0; conjugationTenses[j].m != INVALID_MODE; j++)
+        if (j == tenseIndex)
+        {
+            if (conjugationTenses[j].m == GERUND_MODE && !isItalian)
+                return false;
+            mode = conjugationTenses[j].m;
+            tense = conjugationTenses[j].t;
+            return true;
+        }
+    return false;
+}
+
+
+// Indicates, for each person of a tense, if the user text is one of its
+// inflections, from the modes, tenses and persons that deconjugate()
+// found: the inflections are not compared with the user text.
+//
 static
-string
-removePronoun(const string &s)
+vector<bool>
+getMatchedPersons(const FrenchVerbDictionary &fvd,
+                  size_t numPersons,
+                  size_t tenseIndex,
+                  const InflectionGroup &group)
 {
-    string::size_type start = 0;
-    if (s.find("que ") == 0)
-        start = 4;
-    else if (s.find("qu'") == 0)
-        start = 3;
-    else if (s.find("che ") == 0)  // Italian
-        start = 4;
-
-    static const char *pronouns[] =
+    vector<bool> matched(numPersons, false);
+    bool isItalian = (fvd.getLanguage() == FrenchVerbDictionary::ITALIAN);
+    Mode mode;
+    Tense tense;
+    if (!getConjugationTense(tenseIndex, isItalian, mode, tense))
+        return matched;
+
+    for (vector<ModeTensePersonNumber>::const_iterator it = group.mtpns.begin();
+                                                       it != group.mtpns.end(); it++)
     {
-        "je ", "j'", "tu ", "il ", "nous ", "vous ", "ils ",
-        "io ", "tu ", "egli ", "noi ", "voi ", "essi ",  // Italian
-        NULL
-    };
+        if (it->mode != mode || it->tense != tense)
+            continue;
+        size_t index = size_t(it->getPersonCounter(isItalian) - 1);
+        if (index < numPersons)
+            matched[index] = true;
+    }
+    return matched;
+}
+
+
+// Indicates if a variant of a matched person is the one that the user
+// typed.  When the person has several variants (e.g., "paie" and "paye"),
+// it is the one that ends with the user text; when none does, the text
+// was recognized without its accents, and all of them are.
+//
+static
+bool
+isMatchedVariant(const VS &person, size_t variantIndex, const string &lowerCaseUTF8UserText)
+{
+    if (person.size() == 1)
+        return true;
 
-    for (size_t i = 0; pronouns[i] != NULL; i++)
+    const string &text = lowerCaseUTF8UserText;
+    bool found = false;
+    for (size_t i = 0; i < person.size(); i++)
     {
-        size_t len = strlen(pronouns[i]);
-        if (s.find(pronouns[i], start) == start)
-        {
-            start += len;
-            break;
-        }
+        const string &v = person[i];
+        bool endsWithText = (v.length() >= text.length()
+                        && v.compare(v.length() - text.length(), string::npos, text) == 0);
+        if (i == variantIndex && endsWithText)
+            return true;
+        found = found || endsWithText;
     }
-
-    return string(s, start, string::npos);
+    return !found;
 }
 
 
 string
-createTableCellText(verbiste::FrenchVerbDictionary &fvd,
+createTableCellText(const FrenchVerbDictionary &fvd,
                     const VVS &tense,
+                    size_t tenseIndex,
+                    const InflectionGroup &group,
                     const string &lowerCaseUTF8UserText,
                     const string &openMark,
                     const string &closeMark)
 {
-    string userTextWOAccents = fvd.removeUTF8Accents(lowerCaseUTF8UserText);
+    vector<bool> matched = getMatchedPersons(fvd, tense.size(), tenseIndex, group);
 
     string persons;
     for (VVS::const_iterator it = tense.begin(); it != tense.end(); it++)
     {
         const VS &person = *it;
+        bool isMatched = matched[it - tense.begin()];
 
         if (it != tense.begin())
             persons += "\n";
@@ -192,8 +238,8 @@ createTableCellText(verbiste::FrenchVerbDictionary &fvd,
             if (i != person.begin())
                 persons += ", ";
 
-            string inflection = fvd.removeUTF8Accents(removePronoun(*i));
-            if (inflection == userTextWOAccents)
+            if (isMatched
+                    && isMatchedVariant(person, i - person.begin(), lowerCaseUTF8UserText))
                 persons += openMark + *i + closeMark;
             else
                 persons += *i;
@@ -203,39 +249,73 @@ createTableCellText(verbiste::FrenchVerbDictionary &fvd,
 }
 
 
-/**
- * Qt version of createTableCellText() above.
- * Return a vertor of QStrings, which are conjugations.
- **/
-QVector<QString> qgetConjugates(verbiste::FrenchVerbDictionary &fvd,
+QVector<QString> qgetConjugates(const FrenchVerbDictionary &fvd,
                                 const VVS &tense,
+                                size_t tenseIndex,
+                                const InflectionGroup &group,
                                 const string &lowerCaseUTF8UserText,
                                 const string &openMark,
                                 const string &closeMark)
 {
-    string userTextWOAccents = fvd.removeUTF8Accents(lowerCaseUTF8UserText);
-    QVector<QString> persons(0);
+    vector<bool> matched = getMatchedPersons(fvd, tense.size(), tenseIndex, group);
+
+    QVector<QString> persons;
+    persons.reserve(int(tense.size()));
     for (VVS::const_iterator it = tense.begin(); it != tense.end(); it++)
     {
         const VS &person = *it;
+        bool isMatched = matched[it - tense.begin()];
         QString ver;
 
-//        if (it != tense.begin())
-//            persons += "\n";
+        for (VS::const_iterator i = person.begin(); i != person.end(); i++)
+        {
+            if (i != person.begin())
+                ver.append(", ");
+
+            if (isMatched
+                    && isMatchedVariant(person, i - person.begin(), lowerCaseUTF8UserText))
+                ver.append(QString::fromUtf8((openMark + *i + closeMark).c_str()));
+            else
+                ver.append(QString::fromUtf8((*i).c_str()));
+        }
+        persons.append(ver);
+    }
+    return persons;
+}
+
+
+QVector<QString> qgetConjugates(const FrenchVerbDictionary &fvd,
+                                const VVS &tense,
+                                size_t tenseIndex,
+                                const InflectionGroup &group,
+                                const string &lowerCaseUTF8UserText,
+                                QVector<ConjugateMark> &marks)
+{
+    vector<bool> matched = getMatchedPersons(fvd, tense.size(), tenseIndex, group);
+
+    QVector<QString> persons;
+    persons.reserve(int(tense.size()));
+    for (VVS::const_iterator it = tense.begin(); it != tense.end(); it++)
+    {
+        const VS &person = *it;
+        bool isMatched = matched[it - tense.begin()];
+        QString ver;
 
         for (VS::const_iterator i = person.begin(); i != person.end(); i++)
         {
             if (i != person.begin())
                 ver.append(", ");
 
-            string inflection = fvd.removeUTF8Accents(removePronoun(*i));
-            if (inflection == userTextWOAccents) {
-                const std::string wrapped = openMark + *i + closeMark;
-                ver.append(QString::fromUtf8(wrapped.c_str()));
-            }
-            else {
-                const char *str = (*i).c_str();
-                ver.append(QString::fromUtf8(str));
+            int start = ver.size();
+            ver.append(QString::fromUtf8((*i).c_str()));
+
+            if (isMatched
+                    && isMatchedVariant(person, i - person.begin(), lowerCaseUTF8UserText)) {
+                ConjugateMark mark;
+                mark.person = persons.size();
+                mark.start = start;
+                mark.length = ver.size() - start;
+                marks.append(mark);
             }
         }
         persons.append(ver);
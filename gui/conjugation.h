@@ -71,15 +71,35 @@ void getConjugation(const verbiste::FrenchVerbDictionary &fvd,
 std::string getTenseNameForTableCell(int row, int col, bool isItalian);
 
 
+/** Gives the mode and tense of a tense of the conjugation obtained
+    from getConjugation().
+    @param      tenseIndex      index of the tense in the conjugation
+    @param      isItalian       language used (true for Italian, false for French)
+    @param      mode            receives the mode of the tense
+    @param      tense           receives the tense
+    @returns                    false if tenseIndex designates no tense
+*/
+bool getConjugationTense(size_t tenseIndex, bool isItalian,
+                         Mode &mode, Tense &tense);
+
+
 /** Composes the text of the conjugation in a certain tense.
     The words of this conjugation that match a certain user text
-    are marked specially.
+    are marked specially.  They are found from the modes, tenses and
+    persons that FrenchVerbDictionary::deconjugate() recognized in the
+    user text, not by comparing each inflection with it.
 
     @param        tense                 structure that represents a certain
                                         tense of a certain verb
+    @param        tenseIndex            index of this tense in the
+                                        conjugation given by getConjugation()
+    @param        group                 inflections of the verb that
+                                        deconjugate() found in the user text
     @param        lowerCaseUTF8UserText conjugated verb as entered by the
                                         user, but converted to lower-case,
-                                        and assumed to be in UTF-8
+                                        and assumed to be in UTF-8; only
+                                        used to choose among the variants
+                                        of a person (e.g., "paie", "paye")
     @param        openMark              ASCII string to be used before verbs
                                         that match lowerCaseUTF8UserText
                                         (e.g., "<b>")
@@ -93,8 +113,10 @@ std::string getTenseNameForTableCell(int row, int col, bool isItalian);
                                         the last line with a newline however;
                                         e.g., "aie\nayons\nayez"
 */
-std::string createTableCellText(verbiste::FrenchVerbDictionary &fvd,
+std::string createTableCellText(const verbiste::FrenchVerbDictionary &fvd,
                                 const VVS &tense,
+                                size_t tenseIndex,
+                                const InflectionGroup &group,
                                 const std::string &lowerCaseUTF8UserText,
                                 const std::string &openMark,
                                 const std::string &closeMark);
@@ -103,9 +125,31 @@ std::string createTableCellText(verbiste::FrenchVerbDictionary &fvd,
  * Qt version of createTableCellText() above.
  * Return a vertor of QStrings, which are conjugations.
  **/
-QVector<QString> qgetConjugates(verbiste::FrenchVerbDictionary &fvd,
+QVector<QString> qgetConjugates(const verbiste::FrenchVerbDictionary &fvd,
                                 const VVS &tense,
+                                size_t tenseIndex,
+                                const InflectionGroup &group,
                                 const std::string &lowerCaseUTF8UserText,
                                 const std::string &openMark,
                                 const std::string &closeMark);
+
+/** Part of a conjugate that matches the user text. */
+struct ConjugateMark
+{
+    int person;  // index of the conjugate in the vector
+    int start;   // position of the matching inflection, in QChars
+    int length;
+};
+
+/**
+ * Version of qgetConjugates() above that returns the matching
+ * inflections in 'marks' instead of surrounding them with markup,
+ * so that the conjugates can be drawn as plain text.
+ **/
+QVector<QString> qgetConjugates(const verbiste::FrenchVerbDictionary &fvd,
+                                const VVS &tense,
+                                size_t tenseIndex,
+                                const InflectionGroup &group,
+                                const std::string &lowerCaseUTF8UserText,
+                                QVector<ConjugateMark> &marks);
 #endif  /* _H_conjugation */
@@ -0,0 +1,124 @@
+#include "lookupjob.h"
+#include "gui/conjugation.h"
+
+#include <QtCore/QtConcurrentMap>
+
+#include <assert.h>
+
+/* Conjugations kept for the next prefixes; beyond that, the user has
+   moved on to other verbs */
+static const int maxCachedConjugations = 64;
+
+/* Functor for QtConcurrent::blockingMapped() */
+struct PageMaker
+{
+    typedef ResultPageModel result_type;
+
+    const LookupJob *job;
+
+    PageMaker(const LookupJob *j) : job(j) {}
+    ResultPageModel operator()(const InflectionGroup &group) const
+    {
+        return job->makePage(group);
+    }
+};
+
+LookupJob::LookupJob(FrenchVerbDictionary *dict, TypingState *typingState,
+                     const QString &input, bool withPronouns,
+                     int serialNumber, const QAtomicInt *current)
+    : fvd(dict), typing(typingState), word(input.toLower().toUtf8().constData()),
+      includePronouns(withPronouns), serial(serialNumber), currentSerial(current)
+{
+}
+
+LookupResult LookupJob::run() const
+{
+    LookupResult result;
+    result.serial = serial;
+    if (isStale()) {
+        result.canceled = true;
+        return result;
+    }
+
+    /* deconjugate() may be called by several jobs at once */
+    std::vector<InflectionGroup> groups;
+    fvd->deconjugate(word, groups);
+    if (isStale()) {
+        result.canceled = true;
+        return result;
+    }
+
+    /* Each group is a distinct (infinitive, template) pair, so each one
+       gets its own page. The calling thread takes part in the work. */
+    QList<ResultPageModel> pages =
+        QtConcurrent::blockingMapped<QList<ResultPageModel> >(groups, PageMaker(this));
+    if (isStale()) {
+        result.canceled = true;
+        return result;
+    }
+
+    for (int i = 0; i < pages.size(); ++i) {
+        if (!pages.at(i).infinitive.isEmpty())
+            result.pages.append(pages.at(i));
+    }
+    return result;
+}
+
+ResultPageModel LookupJob::makePage(const InflectionGroup &group) const
+{
+    ResultPageModel page;
+    if (isStale())
+        return page;
+
+    /* The conjugation does not depend on the typed word, only the
+       highlighting does */
+    QString key = QString::fromUtf8((group.templateName + "/" + group.infinitive).c_str())
+                  + (includePronouns ? "/p" : "");
+    VVVS conjug;
+    {
+        QMutexLocker locker(&typing->mutex);
+        conjug = typing->conjugations.value(key);
+    }
+    if (conjug.empty()) {
+        getConjugation(*fvd, group.infinitive, group.templateName, conjug, includePronouns);
+        QMutexLocker locker(&typing->mutex);
+        if (typing->conjugations.size() >= maxCachedConjugations)
+            typing->conjugations.clear();
+        typing->conjugations.insert(key, conjug);
+    }
+
+    if (conjug.size() == 0           // if no tenses
+        || conjug[0].size() == 0     // if no infinitive tense
+        || conjug[0][0].size() == 0  // if no person in inf. tense
+        || conjug[0][0][0].empty())  // if infinitive string empty
+    {
+        return page;
+    }
+
+    bool isItalian = (fvd->getLanguage() == FrenchVerbDictionary::ITALIAN);
+
+    /* Get modes and tenses of the verb */
+    int i = 0;
+    for (VVVS::const_iterator t = conjug.begin();
+         t != conjug.end(); t++, i++) {
+        if (i == 1)
+            i = 4;
+        else if (i == 11)
+            i = 12;
+        assert(i >= 0 && i < 16);
+
+        ResultCell cell;
+        cell.row = i / 4;
+        cell.col = i % 4;
+
+        std::string utf8TenseName = getTenseNameForTableCell(cell.row, cell.col, isItalian);
+        if (utf8TenseName.empty())
+            continue;
+
+        cell.tenseName = QString::fromUtf8(utf8TenseName.c_str());
+        cell.persons = qgetConjugates(*fvd, *t, t - conjug.begin(), group, word, cell.marks);
+        page.cells.append(cell);
+    }
+    page.infinitive = QString::fromUtf8(conjug[0][0][0].c_str());
+    return page;
+}
@@ -0,0 +1,81 @@
+#ifndef LOOKUPJOB_H
+#define LOOKUPJOB_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+#include <string>
+#include <verbiste/FrenchVerbDictionary.h>
+#include "gui/conjugation.h"
+
+using namespace verbiste;
+
+/* One cell of the conjugation table of a verb */
+struct ResultCell
+{
+    int row;
+    int col;
+    QString tenseName;
+    QVector<QString> persons;   // Plain text, drawn by ConjugationGrid
+    QVector<ConjugateMark> marks;   // Where the looked-up word appears
+};
+
+/* Conjugation of one (infinitive, template) pair, ready to be displayed */
+struct ResultPageModel
+{
+    QString infinitive;         // Empty if the verb could not be conjugated
+    QList<ResultCell> cells;
+};
+
+/* What a lookup gives back to the GUI thread: plain data, no widget */
+struct LookupResult
+{
+    int serial;                 // Serial number of the lookup
+    bool canceled;              // A newer lookup has been started
+    QList<ResultPageModel> pages;
+
+    LookupResult() : serial(0), canceled(false) {}
+};
+
+/* What the lookups of the successive prefixes of a typed word share:
+   the conjugations of the verbs found, which usually stay the same from
+   one prefix to the next. The words themselves are looked up with
+   deconjugate(): resuming the trie walk of the previous prefix was not
+   faster. Belongs to one dictionary; destroyed once no job uses it. */
+struct TypingState
+{
+    QMutex mutex;                       // Protects the member below
+    QHash<QString, VVVS> conjugations;  // By template, infinitive and pronoun flag
+};
+
+/* Deconjugates a word and computes the conjugation of each verb found,
+   in parallel, on the threads of QThreadPool::globalInstance().
+   The lookup stops early, and its result is marked canceled, as soon as
+   'currentSerial' no longer equals its own serial number.
+   The dictionary and 'typing' must stay valid until run() returns. */
+class LookupJob
+{
+public:
+    LookupJob(FrenchVerbDictionary *dict, TypingState *typingState,
+              const QString &input, bool withPronouns,
+              int serialNumber, const QAtomicInt *current);
+
+    LookupResult run() const;
+
+    bool isStale() const { return int(*currentSerial) != serial; }
+    ResultPageModel makePage(const InflectionGroup &group) const;
+
+private:
+    FrenchVerbDictionary *fvd;
+    TypingState *typing;
+    std::string word;           // Lower-case UTF-8
+    bool includePronouns;
+    int serial;
+    const QAtomicInt *currentSerial;
+};
+
+#endif // LOOKUPJOB_H
@@ -5,6 +5,8 @@
 int main(int argc, char *argv[])
 {
     QApplication app(argc, argv);
+    app.setOrganizationName("MVerbiste");   // for QSettings
+    app.setApplicationName("MVerbiste");
 
     MainWindow mainWindow;
     mainWindow.setOrientation(MainWindow::ScreenOrientationLockLandscape);
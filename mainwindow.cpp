@@ -3,9 +3,12 @@
 #include "gui/conjugation.h"
 
 #include <QtCore/QCoreApplication>
+#include <QtCore/QSettings>
+#include <QtCore/QtConcurrentRun>
 
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), ui(new Ui::MainWindow)
+    : QMainWindow(parent), ui(new Ui::MainWindow), dictionaries(NULL), freVerbDic(NULL),
+      loader(NULL), lookupSerial(0), typing(NULL)
 {
 #ifdef Q_WS_MAEMO_5
     this->setAttribute(Qt::WA_Maemo5StackedWindow);
@@ -24,6 +27,16 @@ void MainWindow::setupcodedUI()
     resultPages = new QTabWidget;
     resultPages->setStyleSheet("QTabBar::tab { height: 50px }");
     mlayout->addWidget(resultPages);
+    /* The tabs are filled when they are first shown */
+    connect(resultPages, SIGNAL(currentChanged(int)), this, SLOT(showResultPage(int)));
+
+    /* Busy indicator, while the dictionary is loading */
+    loadProgress = new QProgressBar;
+    loadProgress->setRange(0, 0);
+    loadProgress->setTextVisible(true);
+    loadProgress->setFormat(tr("Loading dictionary..."));
+    loadProgress->hide();
+    mlayout->addWidget(loadProgress);
 
     btnPron = new QCheckBox();
     btnPron->setIcon(QIcon("/usr/share/icons/hicolor/48x48/hildon/general_conference_avatar.png"));
@@ -47,6 +60,13 @@ void MainWindow::setupcodedUI()
     connect(btnLookup, SIGNAL(clicked()), this, SLOT(startLookup()));
     connect(btnPron, SIGNAL(clicked()), this, SLOT(startLookup()));
 
+    /* Search as you type: look up once the typing pauses */
+    typingTimer = new QTimer(this);
+    typingTimer->setSingleShot(true);
+    typingTimer->setInterval(300);
+    connect(wordinput, SIGNAL(textEdited(QString)), this, SLOT(inputEdited()));
+    connect(typingTimer, SIGNAL(timeout()), this, SLOT(startTypingLookup()));
+
     /* Icon */
     QIcon *icon = new QIcon();
     icon->addFile(ICONFILE);
@@ -72,12 +92,24 @@ void MainWindow::setupcodedUI()
     menu->addActions(filterGroup->actions());
     connect(filItalian, SIGNAL(changed()), this, SLOT(switchLang()));
     connect(filFrench, SIGNAL(changed()), this, SLOT(switchLang()));
+    actAsYouType = menu->addAction(tr("Search as you type"));
+    actAsYouType->setCheckable(true);
+    actAsYouType->setChecked(QSettings().value("lookup/asYouType", true).toBool());
+    connect(actAsYouType, SIGNAL(toggled(bool)), this, SLOT(setAsYouType(bool)));
+
+    /* Results of the lookups, computed on worker threads */
+    lookupWatcher = new QFutureWatcher<LookupResult>(this);
+    connect(lookupWatcher, SIGNAL(finished()), this, SLOT(lookupFinished()));
 }
 
 MainWindow::~MainWindow()
 {
+    if (loader)
+        loader->wait();     // It uses the registry
+    cancelLookups(true);    // They use a dictionary of the registry
+    delete typing;
     delete ui;
-    delete freVerbDic;
+    delete dictionaries;
     delete aboutDialog;
 }
 
@@ -147,125 +179,257 @@ void  MainWindow::initverbiste()
         // TODO: If lang code is not supported?
     }
 
-    /* Create verb dictionary, accept non-accent input */
-    freVerbDic = new FrenchVerbDictionary(true);
+    /* Keep the dictionaries of the languages in memory, so that switching
+       language does not load them again. Setting dictionaries/maxResident
+       limits their number on devices short of memory (0: no limit). */
+    QSettings settings;
+    size_t maxResident = settings.value("dictionaries/maxResident", 0).toUInt();
+    dictionaries = new DictionaryRegistry(true, maxResident);   // accept non-accent input
+
+    /* Create verb dictionary on a worker thread: the word input is usable
+       meanwhile, and the lookups are queued until dictionaryLoaded() */
+    loadProgress->show();
+    loader = new DictionaryLoader(dictionaries, lang, this);
+    connect(loader, SIGNAL(finished()), this, SLOT(dictionaryLoaded()));
+    loader->start();
+}
+
+void MainWindow::dictionaryLoaded()
+{
+    loadProgress->hide();
+    if (!loader->dictionary()) {
+        QMessageBox::critical(this, tr("Error"),
+                              tr("Could not load the dictionary: %1").arg(loader->errorMessage()));
+        /* Nothing can be looked up: stop accepting words */
+        pendingLookups.clear();
+        wordinput->setEnabled(false);
+        btnLookup->setEnabled(false);
+        btnPron->setEnabled(false);
+        loader->wait();
+        loader->deleteLater();
+        loader = NULL;
+        return;
+    }
+    useDictionary(loader->dictionary());
+
+    /* The language may have been changed while loading */
+    switchLang();
+
+    /* Load the other language in the background */
+    std::vector<FrenchVerbDictionary::Language> others(1, FrenchVerbDictionary::ITALIAN);
+    dictionaries->prefetch(others);
+
+    /* Only the last word submitted while loading is still wanted */
+    if (!pendingLookups.isEmpty()) {
+        QString word = pendingLookups.last();
+        pendingLookups.clear();
+        lookup(word);
+    }
 }
 
 void MainWindow::switchLang()
 {
+    if (!freVerbDic) {
+        return;     // dictionaryLoaded() will call again
+    }
     FrenchVerbDictionary::Language curlang = freVerbDic->getLanguage();
     FrenchVerbDictionary::Language targetlang = filItalian->isChecked() ? FrenchVerbDictionary::ITALIAN
                                                                         : FrenchVerbDictionary::FRENCH;
     if (curlang == targetlang) {
         return;
     }
-    /* If lang change */
-    std::string conjFN, verbsFN;
-    FrenchVerbDictionary::getXMLFilenames(conjFN, verbsFN, targetlang);
-    delete freVerbDic;
-    freVerbDic = new FrenchVerbDictionary(conjFN, verbsFN, true, targetlang);
+    /* get() may evict the dictionary used by the running lookups */
+    cancelLookups(true);
+    /* If lang change: instant if the dictionary has been prefetched */
+    FrenchVerbDictionary *dict;
+    try {
+        dict = dictionaries->get(targetlang);
+    }
+    catch (const std::logic_error &e) {
+        /* The current dictionary is kept: select its language again */
+        QMessageBox::critical(this, tr("Error"),
+                              tr("Could not load the dictionary: %1").arg(QString::fromUtf8(e.what())));
+        if (curlang == FrenchVerbDictionary::ITALIAN)
+            filItalian->setChecked(true);
+        else
+            filFrench->setChecked(true);
+        return;
+    }
+    useDictionary(dict);
+}
+
+void MainWindow::useDictionary(FrenchVerbDictionary *dict)
+{
+    /* The typing state belongs to the previous dictionary; no job uses it */
+    delete typing;
+    freVerbDic = dict;
+    typing = new TypingState;
 }
 
 void MainWindow::startLookup()
 {
+    typingTimer->stop();
     QString input = wordinput->text().trimmed();
     if (input.isEmpty()) {
         return;
     }
 
-    btnLookup->setText(tr("Please wait..."));
-    btnLookup->setEnabled(false);
-    clearResults();
-    /* Pending the lookup job to the next event loop (redraw the button right now) */
-    QApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
-
-    /* Get input word to look up */
-    const std::string word = input.toLower().toUtf8().constData();
-
-    /*
-     *  For each possible deconjugation, take the infinitive form and
-     *  obtain its complete conjugation.
-     */
-    std::vector<InflectionDesc> infles;
-    bool includePronouns = btnPron->isChecked();
-    bool isItalian = filItalian->isChecked();          // TODO: Will get this value from external
+    if (!freVerbDic) {
+        if (!loader) {
+            return;     // The dictionary could not be loaded
+        }
+        /* Still loading: keep the word until dictionaryLoaded() */
+        pendingLookups.append(input);
+        loadProgress->setFormat(tr("Loading dictionary... (%n lookup(s) waiting)", "",
+                                   pendingLookups.size()));
+        return;
+    }
+    lookup(input);
+}
 
-    freVerbDic->deconjugate(word, infles);
+void MainWindow::inputEdited()
+{
+    if (actAsYouType->isChecked()) {
+        typingTimer->start();   // Restarted by each keystroke
+    }
+}
 
-    resultPages->setUpdatesEnabled(false);
-    std::string prevUTF8Infinitive, prevTemplateName; /* Remember found word
-    to avoid conjugating again */
+void MainWindow::startTypingLookup()
+{
+    QString input = wordinput->text().trimmed();
+    if (input.isEmpty()) {
+        cancelLookups(false);
+        clearResults();
+        return;
+    }
+    if (!freVerbDic) {
+        return;     // Return still queues the word
+    }
+    lookup(input, true);
+}
 
-    for (std::vector<InflectionDesc>::const_iterator it = infles.begin();
-         it != infles.end(); it++)
-    {
-        const InflectionDesc &d = *it;
+void MainWindow::setAsYouType(bool enabled)
+{
+    QSettings().setValue("lookup/asYouType", enabled);
+    if (!enabled) {
+        typingTimer->stop();
+    }
+}
 
-        /* If this infinitive has been conjugated, we skip to the next infinitive */
-        if (d.infinitive == prevUTF8Infinitive && d.templateName == prevTemplateName) {
-            continue;
-        }
+void MainWindow::lookup(const QString &input, bool speculative)
+{
+    /* The previous lookup, if still running, is not wanted anymore */
+    cancelLookups(false);
 
-        VVVS conjug;
-        getConjugation(*freVerbDic, d.infinitive, d.templateName, conjug, includePronouns);
+    /* The results stay until the new ones replace them. A speculative
+       lookup, while typing, does not touch the button either */
+    if (!speculative) {
+        btnLookup->setText(tr("Please wait..."));
+    }
 
-        if (conjug.size() == 0           // if no tenses
-            || conjug[0].size() == 0     // if no infinitive tense
-            || conjug[0][0].size() == 0  // if no person in inf. tense
-            || conjug[0][0][0].empty())  // if infinitive string empty
-        {
-            continue;
-        }
+    /* Deconjugate and conjugate on the worker threads; lookupFinished()
+       builds the widgets */
+    int serial = lookupSerial.fetchAndAddOrdered(1) + 1;
+    LookupJob job(freVerbDic, typing, input, btnPron->isChecked(), serial, &lookupSerial);
+    QFuture<LookupResult> future = QtConcurrent::run(job, &LookupJob::run);
+    runningLookups.append(future);
+    lookupWatcher->setFuture(future);
+}
 
-        std::string utf8Infinitive = conjug[0][0][0];
+void MainWindow::cancelLookups(bool wait)
+{
+    /* The jobs check the serial number between their steps */
+    lookupSerial.fetchAndAddOrdered(1);
+
+    for (int i = runningLookups.size() - 1; i >= 0; --i) {
+        if (wait)
+            runningLookups[i].waitForFinished();
+        if (runningLookups.at(i).isFinished())
+            runningLookups.removeAt(i);
+    }
+    btnLookup->setText("");
+}
 
-        /* Add result to GUI (not show yet) */
-        ResultPage *rsp = addResultPage(utf8Infinitive);
+void MainWindow::lookupFinished()
+{
+    LookupResult result = lookupWatcher->result();
+    if (result.canceled || result.serial != int(lookupSerial)) {
+        return;     // Stale: a newer lookup has been started
+    }
 
-        /* Get modes and tenses of the verb */
-        int i = 0;
-        for (VVVS::const_iterator t = conjug.begin();
-             t != conjug.end(); t++, i++) {
-            if (i == 1)
-                i = 4;
-            else if (i == 11)
-                i = 12;
-            assert(i >= 0 && i < 16);
+    showResults(result);
+    btnLookup->setText("");
+}
 
-            int row = i / 4;
-            int col = i % 4;
+void MainWindow::showResults(const LookupResult &result)
+{
+    /* Replace the content of the existing tabs rather than clearing them
+       first, so that the results do not flicker while the word is typed.
+       The tab of the same verb stays the current one */
+    QString currentVerb = resultPages->tabText(resultPages->currentIndex());
+    int newCurrent = -1;
 
-            std::string utf8TenseName = getTenseNameForTableCell(row, col, isItalian);
-            if (utf8TenseName.empty())
-                continue;
+    /* Only the data is kept for the tabs that are not shown: most of
+       them never are, for an ambiguous word */
+    pageModels = result.pages;
 
-            QVBoxLayout *cell = makeResultCell(*t, utf8TenseName, word, freVerbDic);
-            rsp->grid->addLayout(cell, row, col);
+    resultPages->setUpdatesEnabled(false);
+    for (int p = 0; p < pageModels.size(); ++p) {
+        const ResultPageModel &model = pageModels.at(p);
+        if (p < resultPages->count()) {
+            QScrollArea *page = static_cast<QScrollArea *>(resultPages->widget(p));
+            QWidget *old = page->takeWidget();
+            if (old)
+                old->deleteLater();
+            resultPages->setTabText(p, model.infinitive);
         }
+        else {
+            addResultPage(model.infinitive);
+        }
+        if (model.infinitive == currentVerb && newCurrent < 0)
+            newCurrent = p;
+    }
+    trimResultPages(pageModels.size());
+    if (newCurrent >= 0)
+        resultPages->setCurrentIndex(newCurrent);
+    /* The current tab may not have changed, and is not built yet */
+    showResultPage(resultPages->currentIndex());
+    resultPages->setUpdatesEnabled(true);
+}
 
-        /* Show the result on GUI */
-        rsp->packContent();
-        prevUTF8Infinitive = utf8Infinitive;
-        prevTemplateName = d.templateName;
+void MainWindow::showResultPage(int index)
+{
+    if (index < 0 || index >= pageModels.size() || isResultPageBuilt(index)) {
+        return;
     }
 
-    /* Enable the button again */
-    btnLookup->setEnabled(true);
-    btnLookup->setText("");
-    resultPages->setUpdatesEnabled(true);
+    /* One widget draws the whole table */
+    QScrollArea *page = static_cast<QScrollArea *>(resultPages->widget(index));
+    page->setWidget(new ConjugationGrid(pageModels.at(index)));
+}
+
+bool MainWindow::isResultPageBuilt(int index) const
+{
+    return static_cast<QScrollArea *>(resultPages->widget(index))->widget() != NULL;
 }
 
-ResultPage* MainWindow::addResultPage(const std::string &labelText)
+QScrollArea* MainWindow::addResultPage(const QString &labelText)
 {
-    ResultPage *rp = new ResultPage();
-    QString label = QString::fromUtf8(labelText.c_str());
-    resultPages->addTab(rp->page, label);
-    return rp;
+    /* Empty until showResultPage() */
+    QScrollArea *page = new QScrollArea;
+    resultPages->addTab(page, labelText);
+    return page;
 }
 
 void MainWindow::clearResults()
 {
-    while (resultPages->count()) {
+    trimResultPages(0);
+    pageModels.clear();
+}
+
+void MainWindow::trimResultPages(int count)
+{
+    while (resultPages->count() > count) {
         int lastIndex = resultPages->count() - 1;
         resultPages->widget(lastIndex)->deleteLater();
         resultPages->removeTab(lastIndex);
@@ -274,49 +438,10 @@ void MainWindow::clearResults()
 
 void MainWindow::startAgain()
 {
+    typingTimer->stop();
+    cancelLookups(false);
     wordinput->clear();
     clearResults();
     wordinput->setFocus();
-    btnLookup->setEnabled(true);
-}
-
-QVBoxLayout* MainWindow::makeResultCell(const VVS &tenseIterator,
-                                        const std::string &tenseName,
-                                        const std::string &inputWord,
-                                        FrenchVerbDictionary *verbDict)
-{
-    /* Mode & Tense name */
-    QLabel *tenseLabel = new QLabel();
-    tenseLabel->setText(QString::fromUtf8(tenseName.c_str()));
-    tenseLabel->setStyleSheet("QLabel {background-color: #44A51C;"
-                              "border-top-left-radius: 4px;"
-                              "border-top-right-radius: 4px;"
-                              "padding-left: 10px; padding-right: 10px}");
-
-    /* Conjugaison */
-    QVBoxLayout *vbox = new QVBoxLayout();
-    vbox->addWidget(tenseLabel);
-    QVector<QString> persons = qgetConjugates(*verbDict, tenseIterator,inputWord,
-                                              "<font color='#D20020'>", "</font>");
-    for (int i = 0; i < persons.size(); ++i) {
-        QLabel *lb = new QLabel(persons.at(i));
-        lb->setMargin(4);
-        vbox->addWidget(lb, 1);
-    }
-    return vbox;
-}
-
-/**** For ResultPage class ****/
-ResultPage::ResultPage()
-    : page(new QScrollArea),
-      grid(new QGridLayout)
-{
+    btnLookup->setEnabled(freVerbDic != NULL || loader != NULL);
 }
-
-void ResultPage::packContent()
-{
-    QWidget *immediate = new QWidget();
-    immediate->setLayout(grid);
-    page->setWidget(immediate);
-}
-
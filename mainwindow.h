@@ -12,41 +12,30 @@
 #include <QtGui/QTableWidget>
 #include <QtGui/QMessageBox>
 #include <QtGui/QActionGroup>
+#include <QtGui/QProgressBar>
+#include <QtCore/QStringList>
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QTimer>
 
 /* Verbiste */
 #include <iostream>
 #include <vector>
 #include <string.h>
 #include <verbiste/FrenchVerbDictionary.h>
+#include <verbiste/DictionaryRegistry.h>
 #include "gui/conjugation.h"
 #include "about.h"
-
-#ifndef QT_NO_DEBUG
-#include <QtCore/QDebug>
-#include <QtCore/QElapsedTimer>
-#endif
+#include "dictionaryloader.h"
+#include "lookupjob.h"
+#include "conjugationgrid.h"
 
 using namespace verbiste;
 
 namespace Ui {
     class MainWindow;
-    class ResultPage;
 }
 
-class ResultPage
-{
-public:
-    QScrollArea *page;
-    QGridLayout *grid;
-
-    ResultPage();
-    // No destructor because this object does not own the two widgets.
-    void packContent();
-
-private:
-    QWidget *immediate;
-};
-
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -68,14 +57,15 @@ public:
 
     void showExpanded();
     void initverbiste();
-    QVBoxLayout* makeResultCell(const VVS &tenseIterator,
-                                const std::string &tenseName,
-                                const std::string &inputWord,
-                                FrenchVerbDictionary *verbDict);
 
 public slots:
     void startLookup();
+    void startTypingLookup();
     void switchLang();
+    void dictionaryLoaded();
+    void lookupFinished();
+    void inputEdited();
+    void setAsYouType(bool enabled);
 
 private:
     Ui::MainWindow *ui;
@@ -89,19 +79,37 @@ private:
     QPushButton *btnLookup;          // Lookup button
     QAction     *filFrench;
     QAction     *filItalian;
+    QAction     *actAsYouType;       // Look up while the word is typed
+    QTimer      *typingTimer;        // Debounces the lookups while typing
     QMessageBox *msgbox;
     std::string langCode;
-    FrenchVerbDictionary *freVerbDic;
+    DictionaryRegistry *dictionaries; // Dictionaries of the languages loaded so far
+    FrenchVerbDictionary *freVerbDic;    // Dictionary of the current language, owned by 'dictionaries'
+                                         // NULL until 'loader' has finished
+    DictionaryLoader *loader;            // Loads the first dictionary on a worker thread
+                                         // NULL if it failed: no lookup can be done
+    QProgressBar *loadProgress;          // Shown while the first dictionary is loading
+    QStringList pendingLookups;          // Words submitted before the dictionary was loaded
+    QAtomicInt lookupSerial;             // Serial number of the latest lookup; read by the jobs
+    QList< QFuture<LookupResult> > runningLookups;  // Jobs that may still use freVerbDic
+    QFutureWatcher<LookupResult> *lookupWatcher;    // Watches the latest job only
+    TypingState *typing;                 // Shared by the jobs on freVerbDic
+    QList<ResultPageModel> pageModels;   // One per tab; the widgets of a tab are
+                                         // only built when it is first shown
     AboutDialog *aboutDialog;
 
-    ResultPage* addResultPage(const std::string &labelText);
-#ifndef QT_NO_DEBUG
-    QElapsedTimer timer;
-#endif
+    QScrollArea* addResultPage(const QString &labelText);
+    bool isResultPageBuilt(int index) const;
+    void lookup(const QString &input, bool speculative = false);
+    void showResults(const LookupResult &result);
+    void useDictionary(FrenchVerbDictionary *dict);
+    void trimResultPages(int count);
+    void cancelLookups(bool wait);
 
 private slots:
     void clearResults();
     void startAgain();
+    void showResultPage(int index);
 };
 
 
@@ -24,18 +24,34 @@ symbian:TARGET.CAPABILITY += NetworkServices
 # CONFIG += mobility
 # MOBILITY +=
 
-SOURCES += main.cpp mainwindow.cpp \
+SOURCES += main.cpp mainwindow.cpp dictionaryloader.cpp lookupjob.cpp conjugationgrid.cpp \
     verbiste/Trie.cpp \
     verbiste/misc-types.cpp \
     verbiste/FrenchVerbDictionary.cpp \
     verbiste/c-api.cpp \
+    verbiste/DictionaryRegistry.cpp \
+    verbiste/LookupCache.cpp \
+    verbiste/BitVector.cpp \
+    verbiste/ParallelTasks.cpp \
+    verbiste/ReloadableDictionary.cpp \
+    verbiste/VerbFormFilter.cpp \
     gui/conjugation.cpp \
     about.cpp
-HEADERS += mainwindow.h \
+HEADERS += mainwindow.h dictionaryloader.h lookupjob.h conjugationgrid.h \
+    verbiste/AutoLock.h \
     verbiste/Trie.h \
+    verbiste/BitmapTrie.h \
+    verbiste/BitVector.h \
+    verbiste/LoudsTrie.h \
+    verbiste/ParallelTasks.h \
+    verbiste/ReloadableDictionary.h \
     verbiste/misc-types.h \
     verbiste/FrenchVerbDictionary.h \
     verbiste/c-api.h \
+    verbiste/DictionaryImage.h \
+    verbiste/DictionaryRegistry.h \
+    verbiste/LookupCache.h \
+    verbiste/VerbFormFilter.h \
     gui/conjugation.h \
     about.h
 FORMS += mainwindow.ui
@@ -62,12 +78,38 @@ OTHER_FILES += \
 # To build verbiste
 unix: CONFIG += link_pkgconfig
 unix: PKGCONFIG += libxml-2.0
+unix: LIBS += -lpthread
 
 DEFINES += VERSTR=\\\"1.1\\\"
 
 # For verbiste
 DEFINES += ICONV_CONST=
 
+# Compile the dictionaries of data/ into the program, so that they are
+# loaded without reading the XML files: qmake CONFIG+=embedded_dictionaries
+# The generator runs on the build machine, so this needs a native build.
+embedded_dictionaries {
+    mkdictimage.target = mkdictimage
+    mkdictimage.commands = $$QMAKE_CXX -o mkdictimage $$PWD/verbiste/mkdictimage.cpp \
+                           `pkg-config --cflags --libs libxml-2.0`
+    mkdictimage.depends = $$PWD/verbiste/mkdictimage.cpp
+
+    dictimage.target = dictimage.cpp
+    dictimage.commands = ./mkdictimage $$PWD/data fr it el > dictimage.cpp.tmp && \
+                         mv dictimage.cpp.tmp dictimage.cpp
+    dictimage.depends = mkdictimage \
+                        $$PWD/data/conjugation-fr.xml $$PWD/data/verbs-fr.xml \
+                        $$PWD/data/conjugation-it.xml $$PWD/data/verbs-it.xml \
+                        $$PWD/data/conjugation-el.xml $$PWD/data/verbs-el.xml
+
+    QMAKE_EXTRA_TARGETS += mkdictimage dictimage
+    PRE_TARGETDEPS += dictimage.cpp
+    GENERATED_SOURCES += dictimage.cpp
+    QMAKE_CLEAN += mkdictimage dictimage.cpp
+    INCLUDEPATH += $$PWD/verbiste
+    DEFINES += VERBISTE_EMBEDDED_DICTIONARIES
+}
+
 simulator {    # Build to run on simulator.
     DEFINES += LIBDATADIR=\\\"$$PWD/data\\\"
     DEFINES +=ICONFILE=\\\"$$PWD/icons/mverbiste160.png\\\"
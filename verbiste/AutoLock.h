@@ -0,0 +1,75 @@
+/*  $Id$
+    AutoLock.h - Holders of pthread locks, for the library's own use
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+#ifndef _H_AutoLock
+#define _H_AutoLock
+
+#include <pthread.h>
+
+
+namespace verbiste {
+
+
+/** Locks a pthread mutex for the lifetime of the object.
+    This header is not installed.
+*/
+class AutoMutex
+{
+public:
+    AutoMutex(pthread_mutex_t &m) : mutex(m) { pthread_mutex_lock(&mutex); }
+    ~AutoMutex() { pthread_mutex_unlock(&mutex); }
+private:
+    pthread_mutex_t &mutex;
+
+    // Forbidden operations:
+    AutoMutex(const AutoMutex &);
+    AutoMutex &operator = (const AutoMutex &);
+};
+
+
+/** Locks a pthread read-write lock for the lifetime of the object,
+    for writing if 'write' is true, for reading otherwise.
+*/
+class AutoRWLock
+{
+public:
+    AutoRWLock(pthread_rwlock_t &l, bool write) : lock(l)
+    {
+        if (write)
+            pthread_rwlock_wrlock(&lock);
+        else
+            pthread_rwlock_rdlock(&lock);
+    }
+    ~AutoRWLock() { pthread_rwlock_unlock(&lock); }
+private:
+    pthread_rwlock_t &lock;
+
+    // Forbidden operations:
+    AutoRWLock(const AutoRWLock &);
+    AutoRWLock &operator = (const AutoRWLock &);
+};
+
+
+}  // namespace verbiste
+
+
+#endif  /* _H_AutoLock */
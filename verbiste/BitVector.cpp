@@ -0,0 +1,154 @@
+/*  $Id$
+    BitVector.cpp - Bit vector with rank and select support
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+#include "BitVector.h"
+
+#include <assert.h>
+
+using namespace std;
+using namespace verbiste;
+
+
+static const size_t zeroSampleRate = 256;
+
+
+// Returns the position of the lowest 1 bit of a non-zero word.
+//
+inline
+unsigned
+findLowestBit(unsigned long long word)
+{
+    assert(word != 0);
+#ifdef __GNUC__
+    return __builtin_ctzll(word);
+#else
+    unsigned pos = 0;
+    for ( ; (word & 1) == 0; word >>= 1)
+        ++pos;
+    return pos;
+#endif
+}
+
+
+// Returns the position of the k-th 0 bit (k >= 1) in a word.
+//
+static unsigned
+selectZeroInWord(unsigned long long word, size_t k)
+{
+    unsigned long long zeros = ~word;
+    for (size_t i = 1; i < k; ++i)
+        zeros &= zeros - 1;  // clear the lowest 0 bit of 'word'
+    return findLowestBit(zeros);
+}
+
+
+BitVector::BitVector()
+  : words(),
+    ranks(),
+    zeroSamples(),
+    numBits(0),
+    numZeros(0)
+{
+}
+
+
+void
+BitVector::push_back(bool bit)
+{
+    if (numBits % 64 == 0)
+        words.push_back(0);
+    if (bit)
+        words.back() |= 1ULL << (numBits % 64);
+    else
+    {
+        if (numZeros % zeroSampleRate == 0)
+            zeroSamples.push_back(unsigned(numBits / 64));
+        ++numZeros;
+    }
+    ++numBits;
+}
+
+
+void
+BitVector::build()
+{
+    vector<unsigned long long>(words).swap(words);  // trim the capacity
+    vector<unsigned>(zeroSamples).swap(zeroSamples);
+
+    ranks.assign(words.size() + 1, 0);
+    for (size_t i = 0; i < words.size(); ++i)
+        ranks[i + 1] = ranks[i] + countBits(words[i]);
+}
+
+
+size_t
+BitVector::rank1(size_t pos) const
+{
+    assert(pos <= numBits);
+    size_t w = pos / 64, b = pos % 64;
+    if (b == 0)
+        return ranks[w];
+    return ranks[w] + countBits(words[w] & ((1ULL << b) - 1));
+}
+
+
+size_t
+BitVector::select0(size_t k) const
+{
+    assert(k >= 1 && k <= numZeros);
+
+    // Start from the sampled word and skip the words that end
+    // before the k-th 0 bit.
+    size_t w = zeroSamples[(k - 1) / zeroSampleRate];
+    while (w + 1 < words.size() && (w + 1) * 64 - ranks[w + 1] < k)
+        ++w;
+
+    size_t zerosBefore = w * 64 - ranks[w];
+    return w * 64 + selectZeroInWord(words[w], k - zerosBefore);
+}
+
+
+size_t
+BitVector::nextZero(size_t pos) const
+{
+    while (pos < numBits)
+    {
+        unsigned long long zeros = ~words[pos / 64] >> (pos % 64);
+        if (zeros != 0)
+        {
+            pos += findLowestBit(zeros);
+            return pos < numBits ? pos : numBits;
+        }
+        pos = (pos / 64 + 1) * 64;
+    }
+    return numBits;
+}
+
+
+size_t
+BitVector::computeMemoryConsumption() const
+{
+    return sizeof(*this)
+           + words.capacity() * sizeof(unsigned long long)
+           + ranks.capacity() * sizeof(unsigned)
+           + zeroSamples.capacity() * sizeof(unsigned);
+}
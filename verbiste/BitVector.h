@@ -0,0 +1,114 @@
+/*  $Id$
+    BitVector.h - Bit vector with rank and select support
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+#ifndef _H_BitVector
+#define _H_BitVector
+
+#include <vector>
+#include <stddef.h>
+
+
+namespace verbiste {
+
+
+/** Append-only sequence of bits that can count and locate its bits.
+    After the bits have been appended, build() adds a directory of
+    the number of 1 bits before each 64-bit word (half a bit per bit)
+    and the positions of every 256th 0 bit, which make rank1() a
+    constant-time operation and select0() a short scan.
+*/
+class BitVector
+{
+public:
+
+    /** Creates an empty vector.
+    */
+    BitVector();
+
+    /** Appends a bit.  Must not be called after build().
+    */
+    void push_back(bool bit);
+
+    /** Builds the rank and select directories.
+    */
+    void build();
+
+    /** Returns the number of bits.
+    */
+    size_t size() const { return numBits; }
+
+    /** Returns the bit at the given position (less than size()).
+    */
+    bool get(size_t pos) const
+    {
+        return ((words[pos / 64] >> (pos % 64)) & 1) != 0;
+    }
+
+    /** Returns the number of 1 bits before the given position
+        (at most size()).  Requires build().
+    */
+    size_t rank1(size_t pos) const;
+
+    /** Returns the position of the k-th 0 bit, with k from 1 to
+        the number of 0 bits.  Requires build().
+    */
+    size_t select0(size_t k) const;
+
+    /** Returns the position of the first 0 bit at or after the given
+        position, or size() if there is none.
+    */
+    size_t nextZero(size_t pos) const;
+
+    /** Computes and returns the number of memory bytes consumed by
+        this object.
+        @returns                        number of bytes
+    */
+    size_t computeMemoryConsumption() const;
+
+    /** Returns the number of 1 bits in a word.
+    */
+    static unsigned countBits(unsigned long long bits)
+    {
+    #ifdef __GNUC__
+        return __builtin_popcountll(bits);
+    #else
+        unsigned n = 0;
+        for ( ; bits != 0; bits &= bits - 1)
+            ++n;
+        return n;
+    #endif
+    }
+
+private:
+
+    std::vector<unsigned long long> words;
+    std::vector<unsigned> ranks;  // ranks[i] = number of 1 bits in words[0..i)
+    std::vector<unsigned> zeroSamples;  // word that contains the (256 j + 1)-th 0 bit
+    size_t numBits;
+    size_t numZeros;
+};
+
+
+}  // namespace verbiste
+
+
+#endif  /* _H_BitVector */
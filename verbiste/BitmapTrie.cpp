@@ -0,0 +1,663 @@
+/*  $Id$
+    BitmapTrie.cpp - Trie with bitmap-indexed nodes over a dense alphabet
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+#include "BitmapTrie.h"
+#include "ParallelTasks.h"
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+
+namespace verbiste {
+
+
+template <class T>
+BitmapTrie<T>::BitmapTrie(bool _userDataFromNew)
+  : root(),
+    nodeBlock(NULL),
+    nodeBlockSize(0),
+    numDenseCodes(0),
+    userDataFromNew(_userDataFromNew)
+{
+    memset(codeTable, noCode, sizeof(codeTable));
+    memset(alphabet, 0, sizeof(alphabet));
+}
+
+
+template <class T>
+BitmapTrie<T>::~BitmapTrie()
+{
+    clear(true);
+}
+
+
+template <class T>
+void
+BitmapTrie<T>::deleteNode(Node &node, bool deleteUserData)
+{
+    if (userDataFromNew && deleteUserData)
+        delete node.userData;
+    node.userData = NULL;
+
+    unsigned numChildren = countBits(node.bitmap);
+    for (unsigned i = 0; i < numChildren; ++i)
+        deleteNode(node.children[i], deleteUserData);
+    deleteChildArray(node.children);
+    node.children = NULL;
+    node.bitmap = 0;
+
+    if (node.others != NULL)
+    {
+        for (typename std::vector<OtherChild>::iterator it = node.others->begin();
+                                                        it != node.others->end(); ++it)
+            deleteNode(it->node, deleteUserData);
+        delete node.others;
+        node.others = NULL;
+    }
+}
+
+
+//static
+template <class T>
+inline
+unsigned
+BitmapTrie<T>::countBits(unsigned long long bits)
+{
+#ifdef __GNUC__
+    return __builtin_popcountll(bits);
+#else
+    unsigned n = 0;
+    for ( ; bits != 0; bits &= bits - 1)
+        ++n;
+    return n;
+#endif
+}
+
+
+template <class T>
+inline
+const typename BitmapTrie<T>::Node *
+BitmapTrie<T>::findChild(const Node &node, wchar_t unichar) const
+{
+    unsigned code = getCode(unichar);
+    if (code != unsigned(noCode))
+    {
+        unsigned long long bit = 1ULL << code;
+        const Node *child = node.children + countBits(node.bitmap & (bit - 1));
+        return (node.bitmap & bit) != 0 ? child : NULL;
+    }
+
+    if (node.others == NULL)
+        return NULL;
+    for (typename std::vector<OtherChild>::const_iterator it = node.others->begin();
+                                                          it != node.others->end(); ++it)
+        if (it->unichar == unichar)
+            return &it->node;
+    return NULL;
+}
+
+
+template <class T>
+typename BitmapTrie<T>::Node &
+BitmapTrie<T>::findOrCreateChild(Node &node, wchar_t unichar)
+{
+    unsigned code = getCode(unichar);
+    if (code == unsigned(noCode)
+            && numDenseCodes < size_t(maxDenseCodes)
+            && (unsigned long) unichar < (unsigned long) codeTableSize)
+    {
+        code = (unsigned) numDenseCodes++;
+        codeTable[unichar] = (unsigned char) code;
+        alphabet[code] = unichar;
+    }
+
+    if (code != unsigned(noCode))
+    {
+        unsigned long long bit = 1ULL << code;
+        unsigned rank = countBits(node.bitmap & (bit - 1));
+        if ((node.bitmap & bit) != 0)
+            return node.children[rank];
+
+        // Replace the child array with one that is one node longer.
+        unsigned numChildren = countBits(node.bitmap);
+        Node *newChildren = new Node[numChildren + 1]();
+        std::copy(node.children, node.children + rank, newChildren);
+        std::copy(node.children + rank, node.children + numChildren, newChildren + rank + 1);
+        deleteChildArray(node.children);
+        node.children = newChildren;
+        node.bitmap |= bit;
+        return newChildren[rank];
+    }
+
+    if (node.others == NULL)
+        node.others = new std::vector<OtherChild>();
+    for (typename std::vector<OtherChild>::iterator it = node.others->begin();
+                                                    it != node.others->end(); ++it)
+        if (it->unichar == unichar)
+            return it->node;
+    OtherChild other;
+    other.unichar = unichar;
+    other.node = Node();
+    node.others->push_back(other);
+    return node.others->back().node;
+}
+
+
+template <class T>
+T *
+BitmapTrie<T>::add(const std::wstring &key, T *userData)
+{
+    T **pp = getUserDataPointer(key);
+    T *old = *pp;
+    *pp = userData;
+    return old;
+}
+
+
+template <class T>
+T *
+BitmapTrie<T>::remove(const std::wstring &key)
+{
+    // path[i] is the node of the first i characters of the key.
+    std::vector<Node *> path;
+    path.reserve(key.length() + 1);
+    path.push_back(&root);
+    for (std::wstring::size_type index = 0; index < key.length(); ++index)
+    {
+        Node *child = const_cast<Node *>(findChild(*path.back(), key[index]));
+        if (child == NULL)
+            return NULL;
+        path.push_back(child);
+    }
+
+    T *old = path.back()->userData;
+    path.back()->userData = NULL;
+
+    // Destroy the nodes that have become useless, from the end of the key.
+    // Removing a child only reallocates the child array of its parent,
+    // which does not move the nodes above it.
+    for (std::wstring::size_type index = key.length(); index > 0; --index)
+    {
+        if (!isEmpty(*path[index]))
+            break;
+        removeChild(*path[index - 1], key[index - 1]);
+    }
+    return old;
+}
+
+
+// Removes the child of 'node' reached by 'unichar', which must exist
+// and be empty.
+//
+template <class T>
+void
+BitmapTrie<T>::removeChild(Node &node, wchar_t unichar)
+{
+    unsigned code = getCode(unichar);
+    if (code != unsigned(noCode))
+    {
+        unsigned long long bit = 1ULL << code;
+        assert((node.bitmap & bit) != 0);
+        unsigned rank = countBits(node.bitmap & (bit - 1));
+        unsigned numChildren = countBits(node.bitmap);
+
+        // Replace the child array with one that is one node shorter.
+        Node *newChildren = NULL;
+        if (numChildren > 1)
+        {
+            newChildren = new Node[numChildren - 1]();
+            std::copy(node.children, node.children + rank, newChildren);
+            std::copy(node.children + rank + 1, node.children + numChildren, newChildren + rank);
+        }
+        deleteChildArray(node.children);
+        node.children = newChildren;
+        node.bitmap &= ~bit;
+        return;
+    }
+
+    assert(node.others != NULL);
+    for (typename std::vector<OtherChild>::iterator it = node.others->begin();
+                                                    it != node.others->end(); ++it)
+        if (it->unichar == unichar)
+        {
+            node.others->erase(it);
+            break;
+        }
+    if (node.others->empty())
+    {
+        delete node.others;
+        node.others = NULL;
+    }
+}
+
+
+template <class T>
+void
+BitmapTrie<T>::build(const EntryList &sortedEntries, size_t numThreads)
+{
+    clear(true);
+
+    // Codes given in increasing character order keep the children
+    // of each node, which come in character order, in code order too.
+    bool seen[codeTableSize];
+    memset(seen, 0, sizeof(seen));
+    for (typename EntryList::const_iterator it = sortedEntries.begin();
+                                            it != sortedEntries.end(); ++it)
+        for (std::wstring::const_iterator c = it->first.begin(); c != it->first.end(); ++c)
+            if ((unsigned long) *c < (unsigned long) codeTableSize)
+                seen[*c] = true;
+
+    memset(codeTable, noCode, sizeof(codeTable));
+    numDenseCodes = 0;
+    for (size_t c = 0; c < size_t(codeTableSize) && numDenseCodes < size_t(maxDenseCodes); ++c)
+        if (seen[c])
+        {
+            codeTable[c] = (unsigned char) numDenseCodes;
+            alphabet[numDenseCodes] = wchar_t(c);
+            ++numDenseCodes;
+        }
+
+    nodeBlockSize = countNodes(sortedEntries, 0, sortedEntries.size(), 0);
+    if (nodeBlockSize > 0)
+        nodeBlock = new Node[nodeBlockSize]();
+
+    Node *nextFree = nodeBlock;
+    if (numThreads <= 1)
+    {
+        buildNode(root, sortedEntries, 0, sortedEntries.size(), 0, nextFree);
+        assert(nextFree == nodeBlock + nodeBlockSize);
+        return;
+    }
+
+    // The subtree of each child of the root (one per first character)
+    // is built by a separate task, in the part of the block that the
+    // serial build would give it, so that the result is the same.
+    SubtreeBuild context = { this, &sortedEntries, std::vector<SubtreeRange>() };
+    size_t end = sortedEntries.size();
+    size_t begin = initNode(root, sortedEntries, 0, end, 0, nextFree);
+    unsigned numDense = 0;
+    for (size_t i = begin; i < end; )
+    {
+        wchar_t c = sortedEntries[i].first[0];
+        size_t j = i + 1;
+        while (j < end && sortedEntries[j].first[0] == c)
+            ++j;
+
+        SubtreeRange range = { &getBuildChild(root, c, numDense), i, j, nextFree };
+        context.ranges.push_back(range);
+        nextFree += countNodes(sortedEntries, i, j, 1);
+        i = j;
+    }
+    assert(nextFree == nodeBlock + nodeBlockSize);
+
+    runParallelTasks(context.ranges.size(), numThreads, buildSubtree, &context);
+}
+
+
+// Returns the number of nodes, below depth 'depth', of the entries
+// [begin, end), whose keys all start with the same 'depth' characters.
+// The characters that have no dense code are not counted, since their
+// nodes are not allocated in the node block.
+//
+template <class T>
+size_t
+BitmapTrie<T>::countNodes(const EntryList &sortedEntries,
+                          size_t begin, size_t end, size_t depth) const
+{
+    // Each key adds the nodes of its characters that are not
+    // shared with the previous key.
+    size_t numNodes = 0;
+    for (size_t i = begin; i < end; ++i)
+    {
+        const std::wstring &key = sortedEntries[i].first;
+        std::wstring::size_type common = depth;
+        if (i > begin)
+        {
+            const std::wstring &previous = sortedEntries[i - 1].first;
+            while (common < previous.length() && common < key.length()
+                                              && previous[common] == key[common])
+                ++common;
+        }
+        for (std::wstring::size_type k = common; k < key.length(); ++k)
+            if (getCode(key[k]) != unsigned(noCode))
+                ++numNodes;
+    }
+    return numNodes;
+}
+
+
+// Runs the build of the subtree of context->ranges[index].
+//
+//static
+template <class T>
+void
+BitmapTrie<T>::buildSubtree(void *context, size_t index)
+{
+    const SubtreeBuild &build = *static_cast<SubtreeBuild *>(context);
+    const SubtreeRange &range = build.ranges[index];
+    Node *nextFree = range.firstFree;
+    build.trie->buildNode(*range.node, *build.sortedEntries,
+                          range.begin, range.end, 1, nextFree);
+}
+
+
+// Gives a node the user data of the entry equal to its string, if any,
+// and allocates its children for the entries [begin, end), whose keys
+// all start with the node's first 'depth' characters.
+// Returns the index of the first entry that belongs to a child.
+//
+template <class T>
+size_t
+BitmapTrie<T>::initNode(Node &node, const EntryList &sortedEntries,
+                        size_t begin, size_t end, size_t depth, Node *&nextFree)
+{
+    if (begin < end && sortedEntries[begin].first.length() == depth)
+    {
+        assert(sortedEntries[begin].second != NULL);
+        node.userData = sortedEntries[begin].second;
+        ++begin;
+    }
+
+    size_t numOthers = 0;
+    for (size_t i = begin; i < end; )
+    {
+        wchar_t c = sortedEntries[i].first[depth];
+        unsigned code = getCode(c);
+        if (code != unsigned(noCode))
+            node.bitmap |= 1ULL << code;
+        else
+            ++numOthers;
+        for (++i; i < end && sortedEntries[i].first[depth] == c; ++i)
+            ;
+    }
+    unsigned numChildren = countBits(node.bitmap);
+    if (numChildren > 0)
+    {
+        node.children = nextFree;
+        nextFree += numChildren;
+    }
+    if (numOthers > 0)
+    {
+        node.others = new std::vector<OtherChild>();
+        node.others->reserve(numOthers);  // no reallocation below
+    }
+    return begin;
+}
+
+
+// Returns the next child of a node initialized by initNode(),
+// whose children must be requested in character order.
+// 'numDense' counts the children that have a dense code.
+//
+template <class T>
+typename BitmapTrie<T>::Node &
+BitmapTrie<T>::getBuildChild(Node &node, wchar_t unichar, unsigned &numDense)
+{
+    if (getCode(unichar) != unsigned(noCode))
+        return node.children[numDense++];
+
+    OtherChild other;
+    other.unichar = unichar;
+    other.node = Node();
+    node.others->push_back(other);
+    return node.others->back().node;
+}
+
+
+// Creates the descendants of a node from the entries [begin, end),
+// whose keys all start with the node's first 'depth' characters.
+//
+template <class T>
+void
+BitmapTrie<T>::buildNode(Node &node, const EntryList &sortedEntries,
+                         size_t begin, size_t end, size_t depth, Node *&nextFree)
+{
+    begin = initNode(node, sortedEntries, begin, end, depth, nextFree);
+
+    // Build each child from its range of entries.
+    unsigned numDense = 0;
+    for (size_t i = begin; i < end; )
+    {
+        wchar_t c = sortedEntries[i].first[depth];
+        size_t j = i + 1;
+        while (j < end && sortedEntries[j].first[depth] == c)
+            ++j;
+
+        buildNode(getBuildChild(node, c, numDense), sortedEntries, i, j, depth + 1, nextFree);
+        i = j;
+    }
+}
+
+
+template <class T>
+T **
+BitmapTrie<T>::getUserDataPointer(const std::wstring &key)
+{
+    Node *node = &root;
+    for (std::wstring::size_type index = 0; index < key.length(); ++index)
+        node = &findOrCreateChild(*node, key[index]);
+    return &node->userData;
+}
+
+
+template <class T>
+T *
+BitmapTrie<T>::get(const std::wstring &key, TrieReceiver<T> &receiver) const
+{
+    const Node *node = &root;
+    for (std::wstring::size_type index = 0; ; ++index)
+    {
+        if (node->userData != NULL
+                && !receiver.onFoundPrefixWithUserData(key, index, node->userData))
+            return NULL;  // search stopped by the receiver
+
+        if (index == key.length())
+            return node->userData;
+
+        node = findChild(*node, key[index]);
+        if (node == NULL)
+            return NULL;
+    }
+}
+
+
+template <class T>
+void
+BitmapTrie<T>::getEntries(EntryList &entries) const
+{
+    size_t first = entries.size();
+    std::wstring key;
+    collectEntries(root, key, entries);
+
+    // The dense codes follow the order of first appearance, not the
+    // order of the characters.
+    std::sort(entries.begin() + first, entries.end());
+}
+
+
+template <class T>
+void
+BitmapTrie<T>::collectEntries(const Node &node, std::wstring &key,
+                              EntryList &entries) const
+{
+    if (node.userData != NULL)
+        entries.push_back(std::make_pair(key, node.userData));
+
+    unsigned numChildren = countBits(node.bitmap);
+    unsigned long long bits = node.bitmap;
+    for (unsigned i = 0; i < numChildren; ++i)
+    {
+        unsigned code = countBits((bits & -bits) - 1);  // lowest remaining code
+        bits &= bits - 1;
+        key += alphabet[code];
+        collectEntries(node.children[i], key, entries);
+        key.erase(key.length() - 1);
+    }
+
+    if (node.others != NULL)
+        for (typename std::vector<OtherChild>::const_iterator it = node.others->begin();
+                                                              it != node.others->end(); ++it)
+        {
+            key += it->unichar;
+            collectEntries(it->node, key, entries);
+            key.erase(key.length() - 1);
+        }
+}
+
+
+template <class T>
+bool
+BitmapTrie<T>::getWithPrefix(const std::wstring &prefix, TrieReceiver<T> &receiver) const
+{
+    const Node *node = &root;
+    for (std::wstring::size_type index = 0; index < prefix.length(); ++index)
+    {
+        node = findChild(*node, prefix[index]);
+        if (node == NULL)
+            return true;
+    }
+
+    std::wstring key = prefix;
+    return enumerateNode(*node, key, receiver);
+}
+
+
+// Passes the keys of the subtree of 'node' to the receiver, 'key' being
+// the key of the node.
+//
+template <class T>
+bool
+BitmapTrie<T>::enumerateNode(const Node &node, std::wstring &key,
+                             TrieReceiver<T> &receiver) const
+{
+    if (node.userData != NULL
+            && !receiver.onFoundPrefixWithUserData(key, key.length(), node.userData))
+        return false;
+
+    // The dense codes follow the order of first appearance, not the
+    // order of the characters.
+    std::vector< std::pair<wchar_t, const Node *> > children;
+    unsigned numChildren = countBits(node.bitmap);
+    unsigned long long bits = node.bitmap;
+    for (unsigned i = 0; i < numChildren; ++i)
+    {
+        unsigned code = countBits((bits & -bits) - 1);  // lowest remaining code
+        bits &= bits - 1;
+        children.push_back(std::make_pair(alphabet[code], &node.children[i]));
+    }
+    if (node.others != NULL)
+        for (typename std::vector<OtherChild>::const_iterator it = node.others->begin();
+                                                              it != node.others->end(); ++it)
+            children.push_back(std::make_pair(it->unichar, &it->node));
+    std::sort(children.begin(), children.end());
+
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        key += children[i].first;
+        if (!enumerateNode(*children[i].second, key, receiver))
+            return false;
+        key.erase(key.length() - 1);
+    }
+    return true;
+}
+
+
+// Unlike enumerateNode(), visits the children in the order of
+// their codes, since the walker does not need the keys sorted.
+//
+template <class T>
+bool
+BitmapTrie<T>::walkNode(const Node &node, TrieWalker<T> &walker) const
+{
+    if (node.userData != NULL && !walker.onUserData(node.userData))
+        return false;
+
+    unsigned numChildren = countBits(node.bitmap);
+    unsigned long long bits = node.bitmap;
+    for (unsigned i = 0; i < numChildren; ++i)
+    {
+        unsigned code = countBits((bits & -bits) - 1);  // lowest remaining code
+        bits &= bits - 1;
+        if (!walker.onEnter(alphabet[code]))
+            continue;
+        if (!walkNode(node.children[i], walker))
+            return false;
+        walker.onLeave();
+    }
+    if (node.others != NULL)
+        for (typename std::vector<OtherChild>::const_iterator it = node.others->begin();
+                                                              it != node.others->end(); ++it)
+        {
+            if (!walker.onEnter(it->unichar))
+                continue;
+            if (!walkNode(it->node, walker))
+                return false;
+            walker.onLeave();
+        }
+    return true;
+}
+
+
+template <class T>
+void
+BitmapTrie<T>::clear(bool deleteUserData)
+{
+    deleteNode(root, deleteUserData);
+    delete [] nodeBlock;
+    nodeBlock = NULL;
+    nodeBlockSize = 0;
+}
+
+
+template <class T>
+size_t
+BitmapTrie<T>::computeMemoryConsumption() const
+{
+    return sizeof(*this) + computeNodeMemoryConsumption(root);
+}
+
+
+// Returns the memory used by the descendants of a node, excluding
+// the node itself, which is part of its parent's child array.
+//
+template <class T>
+size_t
+BitmapTrie<T>::computeNodeMemoryConsumption(const Node &node) const
+{
+    unsigned numChildren = countBits(node.bitmap);
+    size_t sum = numChildren * sizeof(Node);
+    for (unsigned i = 0; i < numChildren; ++i)
+        sum += computeNodeMemoryConsumption(node.children[i]);
+
+    if (node.others != NULL)
+    {
+        sum += sizeof(*node.others) + node.others->capacity() * sizeof(OtherChild);
+        for (typename std::vector<OtherChild>::const_iterator it = node.others->begin();
+                                                              it != node.others->end(); ++it)
+            sum += computeNodeMemoryConsumption(it->node);
+    }
+    return sum;
+}
+
+
+}  // namespace verbiste
@@ -0,0 +1,291 @@
+/*  $Id$
+    BitmapTrie.h - Trie with bitmap-indexed nodes over a dense alphabet
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+#ifndef _H_BitmapTrie
+#define _H_BitmapTrie
+
+#include <verbiste/Trie.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace verbiste {
+
+
+/** Tree structure for (wide character) string storage, with compact nodes.
+    The characters that appear in the keys are given dense codes
+    (0 to 63) as they are first added.  A node records which of these
+    codes have a child in a 64-bit bitmap, and keeps its children in an
+    array of exactly that many nodes, in the order of their codes.
+    The position of a child in the array is the number of bits set in
+    the bitmap below its code, which is computed with a single popcount.
+    The characters that do not receive a dense code (beyond the 64th
+    distinct character, or above U+03FF) are stored in a separate list
+    in the nodes that need them.
+    The interface follows the one of Trie<T>.
+    @param        T     type of the user data attached to the stored strings;
+                        pointers to objects of type T will be stored in the
+                        trie, but no T object will be created, copied,
+                        assigned or destroyed by the trie, unless
+                        userDataFromNew is true (see the constructor)
+*/
+template <class T>
+class BitmapTrie
+{
+private:
+
+    struct Node;
+
+public:
+
+    /** List of keys and of their user data.
+    */
+    typedef std::vector< std::pair<std::wstring, T *> > EntryList;
+
+    /** Constructs an empty trie.
+        @param        userDataFromNew   determines if the destructor
+                                        must assume that all "user data"
+                                        pointers come from new and must
+                                        thus be destroyed with delete
+    */
+    BitmapTrie(bool userDataFromNew);
+
+
+    /** Destroys the trie and its contents.
+    */
+    ~BitmapTrie();
+
+
+    /** Adds the given (wide character) key and associates it with
+        the given user data pointer.
+        @returns        the user data previously associated with the key,
+                        or NULL is no user data was associated
+    */
+    T *add(const std::wstring &key, T *userData);
+
+    /** Removes the given key.  The nodes left without user data and
+        without children are destroyed, so that the trie has the shape
+        it would have if the key had never been added.
+        Takes time in proportion to the length of the key.
+        @returns        the user data that was associated with the key,
+                        which the caller must destroy if needed,
+                        or NULL if the key was not in the trie
+    */
+    T *remove(const std::wstring &key);
+
+
+    /** Replaces the contents of the trie with the given entries.
+        Faster than calling add() for each entry: the nodes are
+        created in a single pass, in one block of memory, each child
+        array with its final size.
+        The characters are given dense codes in increasing order.
+        With several threads, the subtrees of the first characters
+        of the keys are built in parallel; the resulting trie is
+        the same, node for node.
+        @param  sortedEntries   entries sorted by key, without duplicate keys;
+                                the user data pointers must not be null
+        @param  numThreads      maximum number of threads to use
+    */
+    void build(const EntryList &sortedEntries, size_t numThreads = 1);
+
+
+    /** Searches the trie with the given (wide character) key.
+        Invokes receiver.onFoundPrefixWithUserData() for each find.
+        The search stops as soon as the receiver returns false.
+        This method does not modify the trie and may be called
+        concurrently by several threads, as long as no thread
+        modifies the trie at the same time.
+        @param  key         wide character string to search for
+        @param  receiver    object that receives the found prefixes
+        @returns            a pointer to the user data pointer
+                            associated with 'key', or NULL if
+                            nothing was found or if the receiver
+                            stopped the search
+    */
+    T *get(const std::wstring &key, TrieReceiver<T> &receiver) const;
+
+
+    /** Enumerates the keys that begin with the given prefix, in
+        increasing order of their characters.
+        See Trie<T>::getWithPrefix().
+        @param  prefix      wide character string that begins the keys
+        @param  receiver    object that receives the keys
+        @returns            false if the receiver stopped the enumeration
+    */
+    bool getWithPrefix(const std::wstring &prefix, TrieReceiver<T> &receiver) const;
+
+
+    /** Walks through the nodes of the trie under the guidance of the walker.
+        See Trie<T>::walk().
+        @param  walker      object that accepts or skips the subtrees
+        @returns            false if the walker stopped the walk
+    */
+    bool walk(TrieWalker<T> &walker) const { return walkNode(root, walker); }
+
+
+    /** Obtains the address of the user data associated with 'key'
+        and adds an entry if necessary.
+        The address is only valid until the next modification of the trie.
+        @returns        a non-null pointer to the user data pointer
+                        associated with 'key';
+                        if a new entry was created, the T * is null.
+    */
+    T **getUserDataPointer(const std::wstring &key);
+
+
+    /** Lists the keys that have user data, with that data.
+        @param  entries     vector to which the (key, user data) pairs
+                            are appended, in increasing key order
+    */
+    void getEntries(EntryList &entries) const;
+
+
+    /** Removes all keys.
+        @param  deleteUserData  if true and if the trie was constructed with
+                                userDataFromNew set to true, the user data
+                                is destroyed; otherwise it is left alone,
+                                for example because it has been handed to
+                                another structure with getEntries()
+    */
+    void clear(bool deleteUserData);
+
+
+    /** Computes and returns the number of memory bytes consumed by
+        this object, excluding the size of the user data instances.
+        @returns                        number of bytes
+    */
+    size_t computeMemoryConsumption() const;
+
+
+    /** Returns the number of characters that have received a dense code.
+    */
+    size_t getAlphabetSize() const { return numDenseCodes; }
+
+private:
+
+    struct OtherChild;
+
+    /** Node of the trie.  The root is the node of the empty key.
+        A node is copied bitwise when its parent's child array is
+        reallocated; it does not point to itself.
+    */
+    struct Node
+    {
+        unsigned long long bitmap;  // bit c is set if a child has the dense code c
+        Node *children;  // one per bit of 'bitmap', by increasing code
+        std::vector<OtherChild> *others;  // children without a dense code, or NULL
+        T *userData;  // user data of the key that ends at this node, or NULL
+    };
+
+    /** Child whose character has no dense code.
+    */
+    struct OtherChild
+    {
+        wchar_t unichar;
+        Node node;
+    };
+
+    /** Subtree built by one of the tasks of build().
+    */
+    struct SubtreeRange
+    {
+        Node *node;  // child of the root
+        size_t begin, end;  // entries of the subtree
+        Node *firstFree;  // part of the node block reserved for the subtree
+    };
+
+    /** Context of the tasks of build().
+    */
+    struct SubtreeBuild
+    {
+        BitmapTrie<T> *trie;
+        const EntryList *sortedEntries;
+        std::vector<SubtreeRange> ranges;
+    };
+
+    enum
+    {
+        maxDenseCodes = 64,
+        codeTableSize = 0x400,  // covers Latin and Greek
+        noCode = 0xFF
+    };
+
+    unsigned getCode(wchar_t unichar) const
+    {
+        unsigned long u = (unsigned long) unichar;
+        return u < (unsigned long) codeTableSize ? codeTable[u] : (unsigned) noCode;
+    }
+
+    static unsigned countBits(unsigned long long bits);
+    const Node *findChild(const Node &node, wchar_t unichar) const;
+    Node &findOrCreateChild(Node &node, wchar_t unichar);
+    void removeChild(Node &node, wchar_t unichar);
+    static bool isEmpty(const Node &node)
+    {
+        return node.userData == NULL && node.bitmap == 0 && node.others == NULL;
+    }
+    void deleteNode(Node &node, bool deleteUserData);
+    void collectEntries(const Node &node, std::wstring &key, EntryList &entries) const;
+    bool enumerateNode(const Node &node, std::wstring &key,
+                       TrieReceiver<T> &receiver) const;
+    bool walkNode(const Node &node, TrieWalker<T> &walker) const;
+    size_t countNodes(const EntryList &sortedEntries,
+                      size_t begin, size_t end, size_t depth) const;
+    static void buildSubtree(void *context, size_t index);
+    size_t initNode(Node &node, const EntryList &sortedEntries,
+                    size_t begin, size_t end, size_t depth, Node *&nextFree);
+    Node &getBuildChild(Node &node, wchar_t unichar, unsigned &numDense);
+    void buildNode(Node &node, const EntryList &sortedEntries,
+                   size_t begin, size_t end, size_t depth, Node *&nextFree);
+    void deleteChildArray(Node *children)
+    {
+        if (children < nodeBlock || children >= nodeBlock + nodeBlockSize)
+            delete [] children;
+    }
+    size_t computeNodeMemoryConsumption(const Node &node) const;
+
+
+    Node root;  // node of the empty string key
+    Node *nodeBlock;  // child arrays allocated by build(), or NULL
+    size_t nodeBlockSize;
+    unsigned char codeTable[codeTableSize];  // dense code of each character, or noCode
+    wchar_t alphabet[maxDenseCodes];  // character of each dense code
+    size_t numDenseCodes;
+    bool userDataFromNew;
+
+
+    // Forbidden operations:
+    BitmapTrie(const BitmapTrie &);
+    BitmapTrie &operator = (const BitmapTrie &);
+
+};
+
+
+}  // namespace verbiste
+
+
+#include "BitmapTrie.cpp"
+
+
+#endif  /* _H_BitmapTrie */
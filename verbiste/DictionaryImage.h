@@ -0,0 +1,92 @@
+/*  $Id$
+    DictionaryImage.h - Conjugation and verb tables compiled into the library
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+#ifndef _H_DictionaryImage
+#define _H_DictionaryImage
+
+#include <stddef.h>
+
+
+namespace verbiste {
+
+
+/** Contents of the conjugation and verbs documents of a language,
+    as constant tables generated at build time by mkdictimage.
+    The tables follow the documents node for node, so that
+    FrenchVerbDictionary builds the same dictionary from them as
+    from the XML files, without file access or parsing.
+    All the strings are in UTF-8.
+*/
+struct DictionaryImage
+{
+    /** Inflection of a <p> node of a conjugation template,
+        in document order.
+        Modes without tenses, tenses without persons and persons
+        without inflections are kept as rows whose 'tense', 'person'
+        or 'inflection' field is null.
+    */
+    struct TemplateRow
+    {
+        const char *mode;  // name of the mode node, e.g. "indicative"
+        const char *tense;  // name of the tense node, or NULL
+        unsigned char person;  // 1 for the first <p> of the tense, etc., or 0
+        bool startsPerson;  // true for the first row of a <p> node
+        const char *inflection;  // text of the inflection, or NULL
+    };
+
+    /** Conjugation template, e.g. "aim:er".
+    */
+    struct Template
+    {
+        const char *name;
+        size_t firstRow;  // index in 'templateRows'
+        size_t numRows;
+    };
+
+    /** Verb, with one of its templates.
+    */
+    struct Verb
+    {
+        const char *infinitive;
+        const char *templateName;
+        bool aspirateH;  // true if the verb starts with an aspirate h
+    };
+
+    const char *languageCode;  // e.g. "fr"
+    const Template *templates;  // in document order
+    size_t numTemplates;
+    const TemplateRow *templateRows;
+    const Verb *verbs;  // in document order
+    size_t numVerbs;
+};
+
+
+/** Images generated by mkdictimage, one per language.
+*/
+extern const DictionaryImage dictionaryImages[];
+extern const size_t numDictionaryImages;
+
+
+}  // namespace verbiste
+
+
+#endif  /* _H_DictionaryImage */
@@ -0,0 +1,308 @@
+/*  $Id$
+    DictionaryRegistry.cpp - Dictionaries of several languages kept in memory
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+#include "DictionaryRegistry.h"
+#include "AutoLock.h"
+
+using namespace std;
+using namespace verbiste;
+
+
+// Releases a locked mutex for the lifetime of the object,
+// e.g., while a dictionary is loaded.
+//
+class AutoUnlock
+{
+public:
+    AutoUnlock(pthread_mutex_t &m) : mutex(m) { pthread_mutex_unlock(&mutex); }
+    ~AutoUnlock() { pthread_mutex_lock(&mutex); }
+private:
+    pthread_mutex_t &mutex;
+
+    // Forbidden operations:
+    AutoUnlock(const AutoUnlock &);
+    AutoUnlock &operator = (const AutoUnlock &);
+};
+
+
+DictionaryRegistry::DictionaryRegistry(bool _includeWithoutAccents, size_t _maxResident)
+  : includeWithoutAccents(_includeWithoutAccents),
+    maxResident(_maxResident),
+    langSlots(FrenchVerbDictionary::GREEK + 1),
+    current(FrenchVerbDictionary::NO_LANGUAGE),
+    useCounter(0),
+    prefetchLangs(),
+    prefetching(false),
+    stopPrefetch(false)
+{
+    for (vector<Slot>::iterator it = langSlots.begin(); it != langSlots.end(); ++it)
+    {
+        it->state = ABSENT;
+        it->fvd = NULL;
+        it->lastUse = 0;
+    }
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&loadedCond, NULL);
+}
+
+
+DictionaryRegistry::~DictionaryRegistry()
+{
+    {
+        AutoMutex lock(mutex);
+        stopPrefetch = true;  // read by prefetchAll() between languages
+    }
+    if (prefetching)
+        pthread_join(prefetchThread, NULL);
+
+    for (vector<Slot>::iterator it = langSlots.begin(); it != langSlots.end(); ++it)
+        delete it->fvd;
+    pthread_cond_destroy(&loadedCond);
+    pthread_mutex_destroy(&mutex);
+}
+
+
+FrenchVerbDictionary *
+DictionaryRegistry::load(FrenchVerbDictionary::Language lang) const
+                                                throw (logic_error)
+{
+    return new FrenchVerbDictionary(lang, includeWithoutAccents);
+}
+
+
+FrenchVerbDictionary *
+DictionaryRegistry::get(FrenchVerbDictionary::Language lang) throw (logic_error)
+{
+    if (lang == FrenchVerbDictionary::NO_LANGUAGE || size_t(lang) >= langSlots.size())
+        throw logic_error("invalid language");
+
+    AutoMutex lock(mutex);
+    Slot &slot = langSlots[lang];
+    while (slot.state == LOADING)
+        pthread_cond_wait(&loadedCond, &mutex);
+
+    if (slot.state == ABSENT)
+    {
+        // Load without the lock, so that isLoaded() and the
+        // background thread do not wait.
+        slot.state = LOADING;
+        FrenchVerbDictionary *fvd = NULL;
+        string error;
+        {
+            AutoUnlock unlock(mutex);
+            try
+            {
+                fvd = load(lang);
+            }
+            catch (const logic_error &e)
+            {
+                error = e.what();
+            }
+        }
+        slot.state = (fvd != NULL ? LOADED : ABSENT);
+        slot.fvd = fvd;
+        pthread_cond_broadcast(&loadedCond);
+        if (fvd == NULL)
+            throw logic_error(error);
+    }
+
+    slot.lastUse = ++useCounter;
+    current = lang;
+    evictExcess();
+    return slot.fvd;
+}
+
+
+bool
+DictionaryRegistry::isLoaded(FrenchVerbDictionary::Language lang) const
+{
+    if (size_t(lang) >= langSlots.size())
+        return false;
+    AutoMutex lock(mutex);
+    return langSlots[lang].state == LOADED;
+}
+
+
+bool
+DictionaryRegistry::prefetch(const vector<FrenchVerbDictionary::Language> &langs)
+{
+    if (prefetching)
+    {
+        {
+            AutoMutex lock(mutex);
+            if (!prefetchLangs.empty())
+                return true;  // still running
+        }
+        pthread_join(prefetchThread, NULL);
+        prefetching = false;
+    }
+
+    {
+        AutoMutex lock(mutex);
+        prefetchLangs = langs;
+        if (prefetchLangs.empty())
+            return true;
+    }
+    if (pthread_create(&prefetchThread, NULL, runPrefetch, this) != 0)
+    {
+        AutoMutex lock(mutex);
+        prefetchLangs.clear();
+        return false;
+    }
+    prefetching = true;
+    return true;
+}
+
+
+//static
+void *
+DictionaryRegistry::runPrefetch(void *arg)
+{
+    static_cast<DictionaryRegistry *>(arg)->prefetchAll();
+    return NULL;
+}
+
+
+// Body of the prefetch thread.  Empties 'prefetchLangs' when it is done.
+//
+void
+DictionaryRegistry::prefetchAll()
+{
+    AutoMutex lock(mutex);
+    for (size_t i = 0; i < prefetchLangs.size() && !stopPrefetch; ++i)
+    {
+        FrenchVerbDictionary::Language lang = prefetchLangs[i];
+        if (lang == FrenchVerbDictionary::NO_LANGUAGE || size_t(lang) >= langSlots.size())
+            continue;
+        Slot &slot = langSlots[lang];
+        if (slot.state != ABSENT)
+            continue;
+
+        // Do not make room by evicting: the languages that have been
+        // used are more likely to be used again than a prefetched one.
+        size_t numResident = 0;
+        for (vector<Slot>::const_iterator it = langSlots.begin(); it != langSlots.end(); ++it)
+            if (it->state != ABSENT)
+                ++numResident;
+        if (maxResident != 0 && numResident >= maxResident)
+            break;
+
+        slot.state = LOADING;
+        FrenchVerbDictionary *fvd = NULL;
+        {
+            AutoUnlock unlock(mutex);
+            try
+            {
+                fvd = load(lang);
+            }
+            catch (const logic_error &)
+            {
+                // get() will try again and report the error.
+            }
+        }
+        slot.state = (fvd != NULL ? LOADED : ABSENT);
+        slot.fvd = fvd;
+        slot.lastUse = 0;  // older than any language that has been used
+        pthread_cond_broadcast(&loadedCond);
+    }
+    prefetchLangs.clear();
+}
+
+
+void
+DictionaryRegistry::setMaxResident(size_t _maxResident)
+{
+    AutoMutex lock(mutex);
+    maxResident = _maxResident;
+    evictExcess();
+}
+
+
+size_t
+DictionaryRegistry::getMaxResident() const
+{
+    AutoMutex lock(mutex);
+    return maxResident;
+}
+
+
+// Evicts the least recently used dictionaries until at most 'maxResident'
+// are loaded, without evicting the one of the current language.
+// The caller must hold 'mutex'.
+//
+void
+DictionaryRegistry::evictExcess()
+{
+    if (maxResident == 0)
+        return;
+    while (countLoaded() > maxResident)
+    {
+        Slot *victim = NULL;
+        for (size_t i = 0; i < langSlots.size(); ++i)
+            if (langSlots[i].state == LOADED && i != size_t(current)
+                    && (victim == NULL || langSlots[i].lastUse < victim->lastUse))
+                victim = &langSlots[i];
+        if (victim == NULL)
+            return;
+        delete victim->fvd;
+        victim->fvd = NULL;
+        victim->state = ABSENT;
+    }
+}
+
+
+size_t
+DictionaryRegistry::evictUnused()
+{
+    AutoMutex lock(mutex);
+    size_t numEvicted = 0;
+    for (size_t i = 0; i < langSlots.size(); ++i)
+        if (langSlots[i].state == LOADED && i != size_t(current))
+        {
+            delete langSlots[i].fvd;
+            langSlots[i].fvd = NULL;
+            langSlots[i].state = ABSENT;
+            ++numEvicted;
+        }
+    return numEvicted;
+}
+
+
+size_t
+DictionaryRegistry::getNumLoaded() const
+{
+    AutoMutex lock(mutex);
+    return countLoaded();
+}
+
+
+// The caller must hold 'mutex'.
+//
+size_t
+DictionaryRegistry::countLoaded() const
+{
+    size_t n = 0;
+    for (vector<Slot>::const_iterator it = langSlots.begin(); it != langSlots.end(); ++it)
+        if (it->state == LOADED)
+            ++n;
+    return n;
+}
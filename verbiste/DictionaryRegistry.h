@@ -0,0 +1,148 @@
+/*  $Id$
+    DictionaryRegistry.h - Dictionaries of several languages kept in memory
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+#ifndef _H_DictionaryRegistry
+#define _H_DictionaryRegistry
+
+#include <verbiste/FrenchVerbDictionary.h>
+
+#include <pthread.h>
+#include <stdexcept>
+#include <vector>
+
+
+namespace verbiste {
+
+
+/** Dictionaries of several languages, loaded once and kept in memory,
+    so that switching from one language to another does not load
+    the dictionary again.
+    Other languages can be loaded in advance by a background thread.
+
+    The dictionary of the current language, i.e., the last one given
+    to get(), is never evicted.  The others are evicted, least recently
+    used first, when more than getMaxResident() dictionaries are loaded,
+    and by evictUnused(), which is meant to be called when the system
+    is short of memory.
+*/
+class DictionaryRegistry
+{
+public:
+
+    /** Creates an empty registry.
+        @param    includeWithoutAccents see FrenchVerbDictionary
+        @param    maxResident           maximum number of dictionaries
+                                        kept in memory, or 0 for no limit
+    */
+    DictionaryRegistry(bool includeWithoutAccents, size_t maxResident = 0);
+
+    /** Stops the background loading, waiting for the dictionary being
+        loaded, if any, and destroys all of the dictionaries.
+    */
+    ~DictionaryRegistry();
+
+    /** Returns the dictionary of a language and makes it the current one.
+        Returns immediately if the dictionary is in memory; waits for it
+        if the background thread is loading it; loads it otherwise.
+        The dictionary stays valid until get() is called for another
+        language, evictUnused() is called, or the registry is destroyed.
+        @param    lang          language of the dictionary
+        @returns                a non-null pointer
+        @throws   logic_error   if the dictionary cannot be loaded
+    */
+    FrenchVerbDictionary *get(FrenchVerbDictionary::Language lang)
+                                                throw (std::logic_error);
+
+    /** Indicates if the dictionary of a language is in memory.
+        Does not wait for a dictionary being loaded.
+    */
+    bool isLoaded(FrenchVerbDictionary::Language lang) const;
+
+    /** Starts a thread that loads the dictionaries of the given languages,
+        in that order, unless they are already in memory.  The thread
+        does not load more than getMaxResident() dictionaries in all,
+        nor evict any.  A language whose dictionary cannot be loaded is
+        skipped; get() reports the error.
+        Does nothing if a prefetch is already running.
+        @returns                false if the thread could not be started
+    */
+    bool prefetch(const std::vector<FrenchVerbDictionary::Language> &langs);
+
+    /** Changes the maximum number of dictionaries kept in memory
+        (0 for no limit), evicting some if needed.
+    */
+    void setMaxResident(size_t maxResident);
+
+    /** Returns the maximum number of dictionaries kept in memory, or 0. */
+    size_t getMaxResident() const;
+
+    /** Destroys all of the dictionaries in memory except the one of the
+        current language.
+        @returns                the number of destroyed dictionaries
+    */
+    size_t evictUnused();
+
+    /** Returns the number of dictionaries in memory. */
+    size_t getNumLoaded() const;
+
+private:
+
+    enum State { ABSENT, LOADING, LOADED };
+
+    /** Dictionary of one language, in the order of the Language enum. */
+    struct Slot
+    {
+        State state;
+        FrenchVerbDictionary *fvd;  // non-null if 'state' is LOADED
+        unsigned long lastUse;  // value of 'useCounter' at the last get()
+    };
+
+    FrenchVerbDictionary *load(FrenchVerbDictionary::Language lang) const
+                                                throw (std::logic_error);
+    void evictExcess();
+    size_t countLoaded() const;
+    static void *runPrefetch(void *arg);
+    void prefetchAll();
+
+    bool includeWithoutAccents;
+    size_t maxResident;
+    std::vector<Slot> langSlots;  // indexed by Language
+    FrenchVerbDictionary::Language current;  // NO_LANGUAGE before the first get()
+    unsigned long useCounter;
+    mutable pthread_mutex_t mutex;  // protects the members above
+    pthread_cond_t loadedCond;  // signaled when a LOADING slot changes
+
+    std::vector<FrenchVerbDictionary::Language> prefetchLangs;  // protected by 'mutex'
+    bool prefetching;  // true if prefetchThread has been started and not joined
+    bool stopPrefetch;  // protected by 'mutex'
+    pthread_t prefetchThread;
+
+    // Forbidden operations:
+    DictionaryRegistry(const DictionaryRegistry &);
+    DictionaryRegistry &operator = (const DictionaryRegistry &);
+};
+
+
+}  // namespace verbiste
+
+
+#endif  /* _H_DictionaryRegistry */
@@ -21,14 +21,19 @@
 */
 
 #include "FrenchVerbDictionary.h"
+#include "DictionaryImage.h"
+#include "ParallelTasks.h"
+#include "AutoLock.h"
 
 #include <assert.h>
 #include <iostream>
 #include <errno.h>
 #include <string.h>
+#include <algorithm>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <unistd.h>
 
 using namespace std;
@@ -54,6 +59,56 @@ private:
 };
 
 
+// Reads a variable that another thread may change without holding the
+// lock of the reader, so that the reads that follow are not done before
+// it.  This is not a __sync read-modify-write, which would write to the
+// cache line of the variable in every lookup.
+//
+template <class T>
+static inline T
+loadShared(const volatile T &variable)
+{
+    T value = variable;
+    __sync_synchronize();
+    return value;
+}
+
+
+// Holds a read-write lock for reading, if 'active' is true.
+//
+class OptionalReadLock
+{
+public:
+    OptionalReadLock(pthread_rwlock_t &l, bool active) : lock(active ? &l : NULL)
+    {
+        if (lock != NULL)
+            pthread_rwlock_rdlock(lock);
+    }
+    ~OptionalReadLock() { if (lock != NULL) pthread_rwlock_unlock(lock); }
+    bool isHeld() const { return lock != NULL; }
+private:
+    pthread_rwlock_t *lock;
+
+    // Forbidden operations:
+    OptionalReadLock(const OptionalReadLock &);
+    OptionalReadLock &operator = (const OptionalReadLock &);
+};
+
+
+// Receiver that ignores the prefixes, for searches that only want
+// the user data of the whole key.
+//
+template <class T>
+class NullReceiver : public TrieReceiver<T>
+{
+public:
+    virtual bool onFoundPrefixWithUserData(const wstring &, wstring::size_type, const T *)
+    {
+        return true;
+    }
+};
+
+
 class AutoString
 {
 public:
@@ -165,7 +220,7 @@ removeWideCharAccent(wchar_t c)
 
 
 string
-FrenchVerbDictionary::removeUTF8Accents(const string &utf8String)
+FrenchVerbDictionary::removeUTF8Accents(const string &utf8String) const
 {
     wstring result = utf8ToWide(utf8String);
     for (size_t i = 0; i < result.length(); ++i)
@@ -177,7 +232,7 @@ FrenchVerbDictionary::removeUTF8Accents(const string &utf8String)
 void
 FrenchVerbDictionary::formUTF8UnaccentedVariants(const wstring &wideString,
                                                 size_t index,
-                                                vector<string> &utf8Variants)
+                                                vector<string> &utf8Variants) const
 {
     for ( ; index < wideString.length(); ++index)
     {
@@ -199,7 +254,7 @@ FrenchVerbDictionary::formUTF8UnaccentedVariants(const wstring &wideString,
 void
 FrenchVerbDictionary::formUTF8UnaccentedVariants(const string &utf8String,
                                                 size_t index,
-                                                vector<string> &utf8Variants)
+                                                vector<string> &utf8Variants) const
 {
     wstring wideString = utf8ToWide(utf8String);
     formUTF8UnaccentedVariants(wideString, index, utf8Variants);
@@ -251,53 +306,138 @@ FrenchVerbDictionary::FrenchVerbDictionary(
                                 const string &conjugationFilename,
                                 const string &verbsFilename,
                                 bool includeWithoutAccents,
-                                Language _lang)
+                                Language _lang,
+                                size_t numLoadingThreads)
                                         throw (logic_error)
   : conjugSys(),
     knownVerbs(),
     aspirateHVerbs(),
     inflectionTable(),
-    wideToUTF8Conv((iconv_t) -1),
-    utf8ToWideConv((iconv_t) -1),
-    verbTrie(*this),
-    lang(_lang)
+    lazyImage(NULL),
+    lazyTemplateOrder(),
+    withoutAccents(includeWithoutAccents),
+    verbTrie(true),
+    radicalTuples(),
+    succinctVerbTrie(NULL),
+    formFilter(),
+    lang(_lang),
+    lookupCache(NULL),
+    userVerbs(),
+    userAspirateHVerbs(),
+    userVerbTrie(true),
+    hasUserVerbs(false),
+    userLayerVersion(0)
 {
     if (lang == NO_LANGUAGE)
         throw logic_error("Invalid language code");
-    init(conjugationFilename, verbsFilename, includeWithoutAccents);
+    init(conjugationFilename, verbsFilename, NULL, false,
+         includeWithoutAccents, numLoadingThreads);
+}
+
+
+FrenchVerbDictionary::FrenchVerbDictionary(bool includeWithoutAccents,
+                                           size_t numLoadingThreads)
+                                                throw (std::logic_error)
+  : conjugSys(),
+    knownVerbs(),
+    aspirateHVerbs(),
+    inflectionTable(),
+    lazyImage(NULL),
+    lazyTemplateOrder(),
+    withoutAccents(includeWithoutAccents),
+    verbTrie(true),
+    radicalTuples(),
+    succinctVerbTrie(NULL),
+    formFilter(),
+    lang(FRENCH),
+    lookupCache(NULL),
+    userVerbs(),
+    userAspirateHVerbs(),
+    userVerbTrie(true),
+    hasUserVerbs(false),
+    userLayerVersion(0)
+{
+    string conjFN, verbsFN;
+    getXMLFilenames(conjFN, verbsFN, lang);
+
+    init(conjFN, verbsFN, findDictionaryImage(lang), true,
+         includeWithoutAccents, numLoadingThreads);
 }
 
 
-FrenchVerbDictionary::FrenchVerbDictionary(bool includeWithoutAccents)
+FrenchVerbDictionary::FrenchVerbDictionary(Language _lang,
+                                           bool includeWithoutAccents,
+                                           size_t numLoadingThreads,
+                                           bool lazyTemplates)
                                                 throw (std::logic_error)
   : conjugSys(),
     knownVerbs(),
     aspirateHVerbs(),
     inflectionTable(),
-    wideToUTF8Conv((iconv_t) -1),
-    utf8ToWideConv((iconv_t) -1),
-    verbTrie(*this),
-    lang(FRENCH)
+    lazyImage(NULL),
+    lazyTemplateOrder(),
+    withoutAccents(includeWithoutAccents),
+    verbTrie(true),
+    radicalTuples(),
+    succinctVerbTrie(NULL),
+    formFilter(),
+    lang(_lang),
+    lookupCache(NULL),
+    userVerbs(),
+    userAspirateHVerbs(),
+    userVerbTrie(true),
+    hasUserVerbs(false),
+    userLayerVersion(0)
 {
+    if (lang == NO_LANGUAGE)
+        throw logic_error("Invalid language code");
+
     string conjFN, verbsFN;
     getXMLFilenames(conjFN, verbsFN, lang);
 
-    init(conjFN, verbsFN, includeWithoutAccents);
+    init(conjFN, verbsFN, findDictionaryImage(lang), lazyTemplates,
+         includeWithoutAccents, numLoadingThreads);
+}
+
+
+// Returns the image of the dictionary of a language that has been
+// compiled into the library, or NULL if there is none.
+//
+//static
+const DictionaryImage *
+FrenchVerbDictionary::findDictionaryImage(Language l)
+{
+#ifdef VERBISTE_EMBEDDED_DICTIONARIES
+    string languageCode = getLanguageCode(l);
+    for (size_t i = 0; i < numDictionaryImages; ++i)
+        if (languageCode == dictionaryImages[i].languageCode)
+            return &dictionaryImages[i];
+#else
+    (void) l;
+#endif
+    return NULL;
+}
+
+
+//static
+bool
+FrenchVerbDictionary::hasEmbeddedDictionary(Language l)
+{
+    return findDictionaryImage(l) != NULL;
 }
 
 
 void
 FrenchVerbDictionary::init(const string &conjugationFilename,
                             const string &verbsFilename,
-                            bool includeWithoutAccents)
+                            const DictionaryImage *image,
+                            bool lazyTemplates,
+                            bool includeWithoutAccents,
+                            size_t numLoadingThreads)
                                         throw (logic_error)
 {
-    wideToUTF8Conv = iconv_open("UTF-8", "WCHAR_T");
-    if (wideToUTF8Conv == (iconv_t) -1)
-        throw logic_error("conversion from wide characters to UTF-8 not supported");
-    utf8ToWideConv = iconv_open("WCHAR_T", "UTF-8");
-    if (utf8ToWideConv == (iconv_t) -1)
-        throw logic_error("conversion from UTF-8 to wide characters not supported");
+    pthread_rwlock_init(&templateLock, NULL);
+    pthread_rwlock_init(&userLayerLock, NULL);
 
     #ifndef NDEBUG  // self-test for the wide character string conversions:
     try
@@ -347,11 +487,40 @@ FrenchVerbDictionary::init(const string &conjugationFilename,
             latin1TolowerTable[i] = char(i);
     }
 
-    loadConjugationDatabase(conjugationFilename.c_str(), includeWithoutAccents);
-    loadVerbDatabase(verbsFilename.c_str(), includeWithoutAccents);
+    size_t numThreads = (numLoadingThreads != 0 ? numLoadingThreads : getNumProcessors());
+    if (trace)
+        numThreads = 1;  // keeps the trace in reading order
+
+    // A dictionary image replaces the conjugation and verbs documents.
+    // With lazy templates, only an index of the image's templates
+    // is built here, and each template is decoded when first needed.
+    if (image != NULL)
+    {
+        if (lazyTemplates)
+        {
+            lazyImage = image;
+            indexImageTemplates(*image);
+        }
+        else
+            readConjugation(*image, includeWithoutAccents);
+        readVerbs(*image, includeWithoutAccents, numThreads);
+    }
+
+    // The documents are parsed in parallel.  The conjugation templates,
+    // which the verbs refer to, are read by the task that parses them,
+    // while the verbs documents are still being parsed.
+    //
+    LoadContext context = { this, includeWithoutAccents, image == NULL, vector<DocumentLoad>() };
+    if (image == NULL)
+    {
+        context.documents.push_back(DocumentLoad(conjugationFilename));
+        context.documents.push_back(DocumentLoad(verbsFilename));
+    }
 
-    // Load additional verbs from $HOME/.verbiste/verbs-<lang>.xml, if present.
+    // Load additional verbs from $HOME/.verbiste/verbs-<lang>.xml, if present,
+    // into the user layer.
     //
+    size_t userDocument = size_t(-1);
     const char *home = getenv("HOME");
     if (home != NULL)  // do nothing if $HOME not defined
     {
@@ -360,55 +529,119 @@ FrenchVerbDictionary::init(const string &conjugationFilename,
         if (stat(otherVerbsFilename.c_str(), &statbuf) == 0)  // if file exists
         {
             //cout << "otherVerbsFilename=" << otherVerbsFilename << endl;
-            loadVerbDatabase(otherVerbsFilename.c_str(), includeWithoutAccents);
+            userDocument = context.documents.size();
+            context.documents.push_back(DocumentLoad(otherVerbsFilename));
         }
     }
 
-    if (trace)
-        cout << "FrenchVerbDictionary::init: trie takes "
-             << verbTrie.computeMemoryConsumption() << " bytes\n";
-}
-
+    xmlInitParser();  // required before parsing in several threads
+    runParallelTasks(context.documents.size(), numThreads, loadDocument, &context);
 
-void
-FrenchVerbDictionary::loadConjugationDatabase(
-                                const char *conjugationFilename,
-                                bool includeWithoutAccents)
-                                        throw (logic_error)
-{
-    if (conjugationFilename == NULL)
-        throw invalid_argument("conjugationFilename");
+    // The errors are reported in the order in which a serial
+    // loading would have met them.
+    try
+    {
+        for (size_t k = 0; k < context.documents.size(); ++k)
+        {
+            DocumentLoad &load = context.documents[k];
+            if (!load.error.empty())
+                throw logic_error(load.error);
+            if (k > 0 || !context.hasConjugationDocument)
+                readVerbs(load.doc, includeWithoutAccents, numThreads, k == userDocument);
+            xmlFreeDoc(load.doc);
+            load.doc = NULL;
+        }
+    }
+    catch (...)
+    {
+        for (size_t k = 0; k < context.documents.size(); ++k)
+            if (context.documents[k].doc != NULL)
+                xmlFreeDoc(context.documents[k].doc);
+        throw;
+    }
 
-    AutoDoc conjDoc(xmlParseFile(conjugationFilename));
-    if (!conjDoc)
-        throw logic_error("could not parse " + string(conjugationFilename));
+    buildVerbTrie(numThreads);
+
+    // The radicals have been given to the filter by readVerbs().
+    // The terminations of the templates that have not been decoded
+    // are taken from the rows of the image, with the variants that
+    // addTemplateInflection() would add.
+    for (InflectionTable::const_iterator i = inflectionTable.begin();
+                                         i != inflectionTable.end(); ++i)
+        for (TemplateInflectionTable::const_iterator j = i->second.begin();
+                                                     j != i->second.end(); ++j)
+            formFilter.addTermination(j->first);
+    if (lazyImage != NULL)
+    {
+        set<string> inflections;
+        for (size_t k = 0; k < lazyImage->numTemplates; ++k)
+        {
+            const DictionaryImage::Template &templ = lazyImage->templates[k];
+            for (size_t r = 0; r < templ.numRows; ++r)
+            {
+                const char *inflection = lazyImage->templateRows[templ.firstRow + r].inflection;
+                if (inflection != NULL)
+                    inflections.insert(inflection);
+            }
+        }
+        for (set<string>::const_iterator it = inflections.begin();
+                                         it != inflections.end(); ++it)
+        {
+            formFilter.addTermination(*it);
+            if (includeWithoutAccents)
+            {
+                vector<string> unaccentedVariants;
+                formUTF8UnaccentedVariants(*it, 0, unaccentedVariants);
+                for (vector<string>::const_iterator jt = unaccentedVariants.begin();
+                                                    jt != unaccentedVariants.end(); ++jt)
+                    formFilter.addTermination(*jt);
+            }
+        }
+    }
+    formFilter.build();
 
-    readConjugation(conjDoc.get(), includeWithoutAccents);
+    if (trace)
+        cout << "FrenchVerbDictionary::init: trie takes "
+             << verbTrie.computeMemoryConsumption() << " bytes ("
+             << verbTrie.getAlphabetSize() << " characters), filter takes "
+             << formFilter.computeMemoryConsumption() << " bytes\n";
 }
 
 
+// Parses context->documents[index] and, if it is the conjugation
+// document, reads it.  Runs as one of the tasks of init().
+//
+//static
 void
-FrenchVerbDictionary::loadVerbDatabase(
-                                const char *verbsFilename,
-                                bool includeWithoutAccents)
-                                        throw (logic_error)
+FrenchVerbDictionary::loadDocument(void *context, size_t index)
 {
-    if (verbsFilename == NULL)
-        throw invalid_argument("verbsFilename");
+    LoadContext &loadContext = *static_cast<LoadContext *>(context);
+    DocumentLoad &load = loadContext.documents[index];
 
-    AutoDoc verbsDoc(xmlParseFile(verbsFilename));
-    if (!verbsDoc)
-        throw logic_error("could not parse " + string(verbsFilename));
+    load.doc = xmlParseFile(load.filename.c_str());
+    if (load.doc == NULL)
+    {
+        load.error = "could not parse " + load.filename;
+        return;
+    }
 
-    readVerbs(verbsDoc.get(), includeWithoutAccents);
+    if (index == 0 && loadContext.hasConjugationDocument)
+    {
+        try
+        {
+            loadContext.fvd->readConjugation(load.doc, loadContext.includeWithoutAccents);
+        }
+        catch (const logic_error &e)
+        {
+            load.error = e.what();
+        }
+    }
 }
 
 
 void
 FrenchVerbDictionary::readConjugation(xmlDocPtr doc, bool includeWithoutAccents) throw(logic_error)
 {
-    const bool isItalian = (lang == ITALIAN);
-
     xmlNodePtr rootNodePtr = xmlDocGetRootElement(doc);
 
     if (rootNodePtr == NULL)
@@ -495,29 +728,12 @@ FrenchVerbDictionary::readConjugation(xmlDocPtr doc, bool includeWithoutAccents)
                     {
                         string variant = getUTF8XmlNodeText(
                                                     doc, inf->xmlChildrenNode);
-                        thePersonSpec.push_back(InflectionSpec(variant, true));
-
-                        ModeTensePersonNumber mtpn(
+                        addTemplateInflection(ti, thePersonSpec,
                                 reinterpret_cast<const char *>(mode->name),
                                 reinterpret_cast<const char *>(tense->name),
                                 personCounter,
-                                true,
-                                isItalian);
-                        ti[variant].push_back(mtpn);
-
-                        if (includeWithoutAccents)
-                        {
-                            // Also include versions where some or all accents are missing.
-                            vector<string> unaccentedVariants;
-                            formUTF8UnaccentedVariants(variant, 0, unaccentedVariants);
-                            for (vector<string>::const_iterator it = unaccentedVariants.begin();
-                                                                it != unaccentedVariants.end(); ++it)
-                            {
-                                thePersonSpec.push_back(InflectionSpec(*it, false));
-                                mtpn.correct = false;  // 'false' marks this spelling as incorrect.
-                                ti[*it].push_back(mtpn);
-                            }
-                        }
+                                variant,
+                                includeWithoutAccents);
                     }
                 }
             }
@@ -526,14 +742,211 @@ FrenchVerbDictionary::readConjugation(xmlDocPtr doc, bool includeWithoutAccents)
 }
 
 
+// Reads the conjugation templates of a dictionary image, whose rows
+// describe the nodes that readConjugation(xmlDocPtr, bool) reads.
+//
+void
+FrenchVerbDictionary::readConjugation(const DictionaryImage &image,
+                                      bool includeWithoutAccents) throw(logic_error)
+{
+    for (size_t k = 0; k < image.numTemplates; ++k)
+        readImageTemplate(k, image, includeWithoutAccents);
+}
+
+
+// Adds template number 'index' of a dictionary image to conjugSys
+// and inflectionTable.  When templates are decoded on demand,
+// the caller must hold templateLock for writing.
+//
+void
+FrenchVerbDictionary::readImageTemplate(size_t index,
+                                        const DictionaryImage &image,
+                                        bool includeWithoutAccents) const
+{
+    const DictionaryImage::Template &templ = image.templates[index];
+    TemplateSpec &theTemplateSpec = conjugSys[templ.name];
+    TemplateInflectionTable &ti = inflectionTable[templ.name];
+
+    const DictionaryImage::TemplateRow *row = image.templateRows + templ.firstRow;
+    const DictionaryImage::TemplateRow *end = row + templ.numRows;
+    for ( ; row != end; ++row)
+    {
+        ModeSpec &theModeSpec = theTemplateSpec[convertModeName(row->mode)];
+        if (row->tense == NULL)
+            continue;
+
+        TenseSpec &theTenseSpec = theModeSpec[convertTenseName(row->tense)];
+        if (row->startsPerson)
+            theTenseSpec.push_back(PersonSpec());
+        if (row->inflection == NULL)
+            continue;
+
+        assert(!theTenseSpec.empty());
+        addTemplateInflection(ti, theTenseSpec.back(),
+                              row->mode, row->tense, row->person,
+                              row->inflection, includeWithoutAccents);
+    }
+}
+
+
+// Orders template indices by the names of the templates.
+//
+class ImageTemplateLess
+{
+public:
+    ImageTemplateLess(const DictionaryImage &i) : image(i) {}
+    bool operator () (size_t a, size_t b) const
+    {
+        return strcmp(image.templates[a].name, image.templates[b].name) < 0;
+    }
+    bool operator () (size_t a, const string &b) const
+    {
+        return strcmp(image.templates[a].name, b.c_str()) < 0;
+    }
+    bool operator () (const string &a, size_t b) const
+    {
+        return strcmp(a.c_str(), image.templates[b].name) < 0;
+    }
+private:
+    const DictionaryImage &image;
+};
+
+
+// Builds the index through which the templates of a dictionary image
+// are found without being decoded.  A name that appears more than once
+// in the image keeps its document order, so that its templates are
+// decoded in the order readConjugation() would read them.
+//
+void
+FrenchVerbDictionary::indexImageTemplates(const DictionaryImage &image)
+{
+    lazyTemplateOrder.resize(image.numTemplates);
+    for (size_t k = 0; k < image.numTemplates; ++k)
+        lazyTemplateOrder[k] = k;
+    stable_sort(lazyTemplateOrder.begin(), lazyTemplateOrder.end(),
+                ImageTemplateLess(image));
+}
+
+
+// Returns the range of lazyTemplateOrder that designates the
+// templates of lazyImage that have the given name.
+//
+pair<vector<size_t>::const_iterator, vector<size_t>::const_iterator>
+FrenchVerbDictionary::findImageTemplates(const string &templateName) const
+{
+    assert(lazyImage != NULL);
+    return equal_range(lazyTemplateOrder.begin(), lazyTemplateOrder.end(),
+                       templateName, ImageTemplateLess(*lazyImage));
+}
+
+
+// Indicates if a template exists, without decoding it.
+//
+bool
+FrenchVerbDictionary::hasTemplate(const string &templateName) const
+{
+    if (lazyImage == NULL)
+        return conjugSys.find(templateName) != conjugSys.end();
+    pair<vector<size_t>::const_iterator, vector<size_t>::const_iterator>
+                                    range = findImageTemplates(templateName);
+    return range.first != range.second;
+}
+
+
+// Decodes the template of lazyImage that has the given name,
+// unless it has already been decoded.
+// Returns false if lazyImage has no such template.
+//
+bool
+FrenchVerbDictionary::decodeTemplate(const string &templateName) const
+{
+    assert(lazyImage != NULL);
+    {
+        AutoRWLock lock(templateLock, false);
+        if (conjugSys.find(templateName) != conjugSys.end())
+            return true;
+    }
+
+    pair<vector<size_t>::const_iterator, vector<size_t>::const_iterator>
+                                    range = findImageTemplates(templateName);
+    if (range.first == range.second)
+        return false;
+
+    AutoRWLock lock(templateLock, true);
+    if (conjugSys.find(templateName) == conjugSys.end())  // not decoded by another thread
+        for (vector<size_t>::const_iterator it = range.first; it != range.second; ++it)
+            readImageTemplate(*it, *lazyImage, withoutAccents);
+    return true;
+}
+
+
+// Returns the inflection table of a template, decoding the template
+// if needed, or NULL if the template does not exist.
+//
+const TemplateInflectionTable *
+FrenchVerbDictionary::findTemplateInflectionTable(const string &templateName) const
+{
+    if (lazyImage == NULL)
+    {
+        InflectionTable::const_iterator i = inflectionTable.find(templateName);
+        return i == inflectionTable.end() ? NULL : &i->second;
+    }
+
+    {
+        AutoRWLock lock(templateLock, false);
+        InflectionTable::const_iterator i = inflectionTable.find(templateName);
+        if (i != inflectionTable.end())
+            return &i->second;  // decoded templates are never removed
+    }
+    if (!decodeTemplate(templateName))
+        return NULL;
+    AutoRWLock lock(templateLock, false);
+    return &inflectionTable.find(templateName)->second;
+}
+
+
+// Adds an inflection of a template, and its unaccented variants
+// if requested, to the template's person and inflection table.
+//
+void
+FrenchVerbDictionary::addTemplateInflection(TemplateInflectionTable &ti,
+                                            PersonSpec &thePersonSpec,
+                                            const char *modeName,
+                                            const char *tenseName,
+                                            int personCounter,
+                                            const string &variant,
+                                            bool includeWithoutAccents) const
+{
+    thePersonSpec.push_back(InflectionSpec(variant, true));
+
+    ModeTensePersonNumber mtpn(modeName, tenseName, personCounter, true,
+                               lang == ITALIAN);
+    ti[variant].push_back(mtpn);
+
+    if (includeWithoutAccents)
+    {
+        // Also include versions where some or all accents are missing.
+        vector<string> unaccentedVariants;
+        formUTF8UnaccentedVariants(variant, 0, unaccentedVariants);
+        for (vector<string>::const_iterator it = unaccentedVariants.begin();
+                                            it != unaccentedVariants.end(); ++it)
+        {
+            thePersonSpec.push_back(InflectionSpec(*it, false));
+            mtpn.correct = false;  // 'false' marks this spelling as incorrect.
+            ti[*it].push_back(mtpn);
+        }
+    }
+}
+
+
 string
 FrenchVerbDictionary::getUTF8XmlNodeText(xmlDocPtr doc, xmlNodePtr node)
                                                                 throw(int)
 {
-    xmlChar *s = getString(doc, node);
-    if (s == NULL)
+    AutoString s(getString(doc, node));
+    if (!s)
         return string();
-    return reinterpret_cast<char *>(s);
+    return reinterpret_cast<char *>(s.get());
 }
 
 
@@ -541,19 +954,24 @@ string
 FrenchVerbDictionary::getUTF8XmlProp(xmlNodePtr node, const char *propName)
                                                                 throw(int)
 {
-    xmlChar *s = getProp(node, propName);
-    if (s == NULL)
+    AutoString s(getProp(node, propName));
+    if (!s)
         return string();
-    return reinterpret_cast<char *>(s);
+    return reinterpret_cast<char *>(s.get());
 }
 
 
 // Reads the given XML document and adds data to members knownVerbs,
-// aspirateHVerbs and verbTrie.
+// aspirateHVerbs and radicalTuples.
+// The verbs are read in chunks by up to 'numThreads' threads, then the
+// chunks are added in document order, so that the result does not
+// depend on the number of threads.
 //
 void
 FrenchVerbDictionary::readVerbs(xmlDocPtr doc,
-                                bool includeWithoutAccents)
+                                bool includeWithoutAccents,
+                                size_t numThreads,
+                                bool userLayer)
                                                 throw(logic_error)
 {
     if (trace)
@@ -568,376 +986,1663 @@ FrenchVerbDictionary::readVerbs(xmlDocPtr doc,
     if (different(rootNodePtr->name, ("verbs-" + langCode).c_str()))
         throw logic_error("wrong top node in verbs document");
 
+    VerbReading reading = { this, doc, NULL, includeWithoutAccents, userLayer,
+                            vector<xmlNodePtr>(), 0, vector<VerbChunk>() };
     for (xmlNodePtr v = rootNodePtr->xmlChildrenNode; v != NULL; v = v->next)
-    {
-        if (equal(v->name, "text") || equal(v->name, "comment"))
-            continue;
-
-        xmlNodePtr i = v->xmlChildrenNode;
-        if (i == NULL || i->xmlChildrenNode == NULL)
-            throw logic_error("missing <i> node");
-
-        string utf8Infinitive = getUTF8XmlNodeText(doc, i->xmlChildrenNode);
-        wstring wideInfinitive = utf8ToWide(utf8Infinitive);
-        if (wideInfinitive.empty())
-            throw logic_error("empty <i> node");
-        size_t lenInfinitive = wideInfinitive.length();
-        if (trace) cout << "utf8Infinitive='" << utf8Infinitive << "'\n";
-
-        if (i->next == NULL)
-            throw logic_error("unexpected end after <i> node");
-
-        xmlNodePtr t = i->next->next;
-        if (t == NULL)
-            throw logic_error("missing <t> node");
-
-        #if 0
-        cout << "t=" << t << ", t->xmlChildrenNode=" << t->xmlChildrenNode << "\n";
-        if (t->xmlChildrenNode == NULL)
-            cout << "  t->next=" << t->next << ", " << (t->next ? getUTF8XmlNodeText(doc, t->next->xmlChildrenNode) : 0) << endl;
-        #endif
-
-        // Get template name (e.g., "aim:er") in UTF-8.
-        string utf8TName = getUTF8XmlNodeText(doc, t->xmlChildrenNode);
-        if (utf8TName.empty())
-            throw logic_error("empty <t> node");
-        if (trace) cout << "  utf8TName='" << utf8TName << "'\n";
-
-        // Check that this template name (seen in verbs-*.xml) has been
-        // seen in conjugation-*.xml.
-        //
-        if (conjugSys.find(utf8TName) == conjugSys.end())
-            throw logic_error("unknown template name: " + utf8TName);
-
-        // Find the offset of the colon in the template name.
-        // For example: the offset is 3 in the case of "aim:er".
-        // Find this offset in a wide character string, because
-        // the offset in a UTF-8 string is in bytes, not characters.
-        //
-        wstring wideTName = utf8ToWide(utf8TName);
-        wstring::size_type posColon = wideTName.find(':');
-        if (posColon == wstring::npos)
-            throw logic_error("missing colon in <t> node");
-        assert(wideTName[posColon] == ':');
-
-
-        knownVerbs[utf8Infinitive].insert(utf8TName);
-
-        if (includeWithoutAccents)
-        {
-            // Also include versions where some of all accents are missing.
-            vector<string> unaccentedVariants;
-            formUTF8UnaccentedVariants(wideInfinitive, 0, unaccentedVariants);
-            for (vector<string>::const_iterator it = unaccentedVariants.begin();
-                                                it != unaccentedVariants.end(); ++it)
-            {
-                if (trace) cout << "  unaccvar: '" << *it << "'\n";
-                knownVerbs[*it].insert(utf8TName);
-            }
-        }
-
-        // <aspirate-h>: If this verb starts with an aspirate h, remember it:
-        if (t->next != NULL && t->next->next != NULL)
-            aspirateHVerbs.insert(utf8Infinitive);
+        if (!equal(v->name, "text") && !equal(v->name, "comment"))
+            reading.verbNodes.push_back(v);
+    reading.numVerbs = reading.verbNodes.size();
 
-        // Insert the verb in the trie.
-        // A list of template names is associated to each verb in this trie.
-
-        size_t lenTermination = wideTName.length() - posColon - 1;
-        assert(lenTermination > 0);
-        assert(lenInfinitive >= lenTermination);
-
-        wstring wideVerbRadical(wideInfinitive, 0, lenInfinitive - lenTermination);
-        string utf8VerbRadical = wideToUTF8(wideVerbRadical);
-
-        insertVerbRadicalInTrie(utf8VerbRadical, utf8TName, utf8VerbRadical);
-
-        if (includeWithoutAccents)
-        {
-            // Also include versions where some of all accents are missing.
-            vector<string> unaccentedVariants;
-            formUTF8UnaccentedVariants(wideVerbRadical, 0, unaccentedVariants);
-            for (vector<string>::const_iterator it = unaccentedVariants.begin();
-                                                it != unaccentedVariants.end(); ++it)
-            {
-                insertVerbRadicalInTrie(*it, utf8TName, utf8VerbRadical);  // pass correct verb radical as 3rd argument
-            }
-        }
-    }
+    readVerbChunks(reading, numThreads);
 
     if (trace)
         cout << "Number of known verbs (lang " << langCode << "): " << knownVerbs.size() << endl;
 }
 
 
-// String parameters expected to be in UTF-8.
-// Adds to 'verbTrie', which contains wide character strings.
+// Reads the verbs of a dictionary image, like readVerbs(xmlDocPtr, ...).
 //
 void
-FrenchVerbDictionary::insertVerbRadicalInTrie(
-                                    const std::string &verbRadical,
-                                    const std::string &tname,
-                                    const std::string &correctVerbRadical)
+FrenchVerbDictionary::readVerbs(const DictionaryImage &image,
+                                bool includeWithoutAccents,
+                                size_t numThreads)
+                                                throw(logic_error)
 {
-    wstring wideVerbRadical = utf8ToWide(verbRadical);
-    if (trace)
-        cout << "insertVerbRadicalInTrie('"
-              << verbRadical << "' (len=" << wideVerbRadical.length()
-              << "), '" << tname
-              << "', '" << correctVerbRadical
-              << "')\n";
-
-    vector<TrieValue> **templateListPtr =
-                            verbTrie.getUserDataPointer(wideVerbRadical);
-    assert(templateListPtr != NULL);
-
-    // If a new entry was created for 'wideVerbRadical', then the associated
-    // user data pointer is null.  Make this pointer point to a new,
-    // empty vector of template names.
-    //
-    if (*templateListPtr == NULL)
-        *templateListPtr = new vector<TrieValue>();
-
-    // Associate the given template name to the given verb radical.
-    //
-    (*templateListPtr)->push_back(TrieValue(tname, correctVerbRadical));
+    VerbReading reading = { this, NULL, &image, includeWithoutAccents, false,
+                            vector<xmlNodePtr>(), image.numVerbs, vector<VerbChunk>() };
+    readVerbChunks(reading, numThreads);
 }
 
 
-FrenchVerbDictionary::~FrenchVerbDictionary()
+// Reads the verbs of 'reading' in chunks, on up to 'numThreads' threads,
+// then adds the chunks to the dictionary in order, unless one of them
+// has an error.
+//
+void
+FrenchVerbDictionary::readVerbChunks(VerbReading &reading, size_t numThreads)
+                                                throw(logic_error)
 {
-    iconv_close(utf8ToWideConv);
-    iconv_close(wideToUTF8Conv);
-}
+    // A few chunks per thread even out the differences between chunks.
+    size_t numChunks = (numThreads <= 1 ? 1 : numThreads * 4);
+    reading.chunks.resize(min(numChunks, max(reading.numVerbs, size_t(1))));
+    runParallelTasks(reading.chunks.size(), numThreads, readVerbChunk, &reading);
 
+    for (vector<VerbChunk>::const_iterator c = reading.chunks.begin();
+                                           c != reading.chunks.end(); ++c)
+        if (!c->error.empty())
+            throw logic_error(c->error);
 
-const TemplateSpec *
-FrenchVerbDictionary::getTemplate(const string &templateName) const
-{
-    ConjugationSystem::const_iterator it = conjugSys.find(templateName);
-    if (it == conjugSys.end())
-        return NULL;
-    return &it->second;
-}
-
+    if (reading.userLayer)
+    {
+        AutoRWLock lock(userLayerLock, true);
+        for (vector<VerbChunk>::const_iterator c = reading.chunks.begin();
+                                               c != reading.chunks.end(); ++c)
+            addUserChunk(*c);
+        userLayerChanged();
+        return;
+    }
 
-ConjugationSystem::const_iterator
-FrenchVerbDictionary::beginConjugSys() const
-{
-    return conjugSys.begin();
+    for (vector<VerbChunk>::const_iterator c = reading.chunks.begin();
+                                           c != reading.chunks.end(); ++c)
+    {
+        for (vector< pair<string, string> >::const_iterator it = c->knownVerbs.begin();
+                                                             it != c->knownVerbs.end(); ++it)
+            knownVerbs[it->first].insert(it->second);
+        aspirateHVerbs.insert(c->aspirateHVerbs.begin(), c->aspirateHVerbs.end());
+        radicalTuples.insert(radicalTuples.end(), c->radicalTuples.begin(), c->radicalTuples.end());
+        for (vector<string>::const_iterator it = c->utf8Radicals.begin();
+                                            it != c->utf8Radicals.end(); ++it)
+            formFilter.addRadical(*it);
+    }
 }
 
 
-ConjugationSystem::const_iterator
-FrenchVerbDictionary::endConjugSys() const
+// Returns the infinitive of the verb of a radical of the verb trie.
+//
+static string
+getInfinitive(const string &correctVerbRadical, const string &templateName)
 {
-    return conjugSys.end();
+    string::size_type posColon = templateName.find(':');
+    return correctVerbRadical + string(templateName, posColon + 1);
 }
 
 
-const std::set<std::string> &
-FrenchVerbDictionary::getVerbTemplateSet(const char *infinitive) const
+// Adds the verbs of a chunk to the user layer.  A verb that is also
+// in the base layer receives the templates that it has there.
+// The radicals of the templates that a verb already has are not added
+// again, so that they do not give the same results twice.
+// The caller must hold userLayerLock for writing.
+//
+void
+FrenchVerbDictionary::addUserChunk(const VerbChunk &chunk)
+{
+    set< pair<string, string> > newTemplates;  // (infinitive, template name)
+    for (vector< pair<string, string> >::const_iterator it = chunk.knownVerbs.begin();
+                                                         it != chunk.knownVerbs.end(); ++it)
+    {
+        VerbTable::iterator v = userVerbs.find(it->first);
+        if (v == userVerbs.end())
+        {
+            VerbTable::const_iterator b = knownVerbs.find(it->first);
+            v = userVerbs.insert(make_pair(it->first, b != knownVerbs.end()
+                                                      ? b->second : set<string>())).first;
+            if (aspirateHVerbs.find(it->first) != aspirateHVerbs.end())
+                userAspirateHVerbs.insert(it->first);
+        }
+        if (v->second.insert(it->second).second)
+            newTemplates.insert(*it);
+    }
+    userAspirateHVerbs.insert(chunk.aspirateHVerbs.begin(), chunk.aspirateHVerbs.end());
+
+    for (vector<RadicalTuple>::const_iterator t = chunk.radicalTuples.begin();
+                                              t != chunk.radicalTuples.end(); ++t)
+    {
+        const TrieValue &value = t->value;
+        if (newTemplates.find(make_pair(getInfinitive(value.correctVerbRadical,
+                                                      value.templateName),
+                                        value.templateName)) == newTemplates.end())
+            continue;
+        vector<TrieValue> **templateList = userVerbTrie.getUserDataPointer(t->radical);
+        if (*templateList == NULL)
+            *templateList = new vector<TrieValue>();
+        (*templateList)->push_back(value);
+    }
+}
+
+
+// Removes a radical added by addUserChunk() from the trie of the user
+// layer, and the key of the radical if no other template uses it.
+// The caller must hold userLayerLock for writing.
+//
+void
+FrenchVerbDictionary::removeUserRadical(const RadicalTuple &tuple)
+{
+    NullReceiver< vector<TrieValue> > receiver;
+    vector<TrieValue> *templateList = userVerbTrie.get(tuple.radical, receiver);
+    if (templateList == NULL)
+        return;
+
+    for (vector<TrieValue>::iterator it = templateList->begin();
+                                     it != templateList->end(); ++it)
+        if (it->templateName == tuple.value.templateName
+                && it->correctVerbRadical == tuple.value.correctVerbRadical
+                && it->correct == tuple.value.correct)
+        {
+            templateList->erase(it);
+            break;
+        }
+    if (templateList->empty())
+        delete userVerbTrie.remove(tuple.radical);
+}
+
+
+// Tells if a radical of the base layer belongs to a verb
+// removed by removeVerb().
+// The caller must hold userLayerLock.
+//
+bool
+FrenchVerbDictionary::isRemovedVerb(const TrieValue &trieValue) const
+{
+    return removedVerbs.find(getInfinitive(trieValue.correctVerbRadical,
+                                           trieValue.templateName)) != removedVerbs.end();
+}
+
+
+// Makes the lookups see the changes of the user layer.
+// The caller must hold userLayerLock for writing.
+//
+void
+FrenchVerbDictionary::userLayerChanged()
+{
+    // The lookups that do not lock the user layer read the version
+    // before hasUserVerbs: one that sees the new version sees the new
+    // value of hasUserVerbs.
+    __sync_synchronize();
+    hasUserVerbs = !userVerbs.empty();
+    unsigned long version = __sync_add_and_fetch(&userLayerVersion, 1);
+    if (lookupCache != NULL)
+        lookupCache->startGeneration(version);  // older results may be obsolete
+}
+
+
+void
+FrenchVerbDictionary::addVerb(const string &utf8Infinitive,
+                              const string &utf8TName,
+                              bool aspirateH) throw (logic_error)
+{
+    if (!endsLikeTemplate(utf8Infinitive, utf8TName))
+        throw logic_error("infinitive " + utf8Infinitive
+                          + " does not end like template " + utf8TName);
+
+    VerbChunk chunk;
+    addVerb(utf8Infinitive, utf8TName, aspirateH, withoutAccents, chunk);
+
+    AutoRWLock lock(userLayerLock, true);
+    addUserChunk(chunk);
+    userLayerChanged();
+}
+
+
+bool
+FrenchVerbDictionary::removeVerb(const string &utf8Infinitive)
+{
+    AutoRWLock lock(userLayerLock, true);
+
+    VerbTable::iterator v = userVerbs.find(utf8Infinitive);
+    VerbTable::const_iterator b = knownVerbs.find(utf8Infinitive);
+    set<string> templates;  // copied, since the entry is modified below
+    if (v != userVerbs.end())
+        templates = v->second;
+    else if (b != knownVerbs.end())
+        templates = b->second;
+    if (templates.empty())
+        return false;
+
+    // A form without accents has the templates of its accented verbs,
+    // whose radicals it cannot give back.
+    try
+    {
+        for (set<string>::const_iterator t = templates.begin(); t != templates.end(); ++t)
+            if (!endsLikeTemplate(utf8Infinitive, *t))
+                return false;
+    }
+    catch (int e)  // exception throw by utf8towide()
+    {
+        return false;
+    }
+
+    // Recompute the radicals and the forms without accents of each
+    // template, as addVerb() formed them.
+    VerbChunk chunk;
+    for (set<string>::const_iterator t = templates.begin(); t != templates.end(); ++t)
+        addVerb(utf8Infinitive, *t, false, withoutAccents, chunk);
+
+    for (vector<RadicalTuple>::const_iterator t = chunk.radicalTuples.begin();
+                                              t != chunk.radicalTuples.end(); ++t)
+        removeUserRadical(*t);
+
+    // The forms without accents may be shared with other verbs
+    // (e.g., "pecher" for "pécher" and "pêcher"): only the templates
+    // of the removed verb are taken away from them.
+    for (vector< pair<string, string> >::const_iterator it = chunk.knownVerbs.begin();
+                                                         it != chunk.knownVerbs.end(); ++it)
+    {
+        VerbTable::iterator u = userVerbs.find(it->first);
+        if (u == userVerbs.end())
+        {
+            VerbTable::const_iterator k = knownVerbs.find(it->first);
+            u = userVerbs.insert(make_pair(it->first, k != knownVerbs.end()
+                                                      ? k->second : set<string>())).first;
+        }
+        u->second.erase(it->second);
+    }
+
+    // The entry of the verb stays, empty, so that it hides the one of the
+    // base layer.
+    userAspirateHVerbs.erase(utf8Infinitive);
+    if (b != knownVerbs.end())
+        removedVerbs.insert(utf8Infinitive);
+    userLayerChanged();
+    return true;
+}
+
+
+// Indicates if an infinitive ends with the termination of a template,
+// e.g., "aimer" with the "er" of "aim:er".  A template name without
+// a colon is left to addVerb() to reject.
+//
+bool
+FrenchVerbDictionary::endsLikeTemplate(const string &utf8Infinitive,
+                                       const string &utf8TName) const throw(int)
+{
+    wstring wideInfinitive = utf8ToWide(utf8Infinitive);
+    wstring wideTName = utf8ToWide(utf8TName);
+    wstring::size_type posColon = wideTName.find(':');
+    if (posColon == wstring::npos)
+        return true;
+    size_t lenTermination = wideTName.length() - posColon - 1;
+    return wideInfinitive.length() >= lenTermination
+           && wideInfinitive.compare(wideInfinitive.length() - lenTermination,
+                                     lenTermination, wideTName, posColon + 1,
+                                     lenTermination) == 0;
+}
+
+
+void
+FrenchVerbDictionary::addUserVerbs(const string &verbsFilename) throw (logic_error)
+{
+    AutoDoc doc(xmlParseFile(verbsFilename.c_str()));
+    if (!doc)
+        throw logic_error("could not parse " + verbsFilename);
+    readVerbs(doc.get(), withoutAccents, 1, true);
+}
+
+
+// Reads the verbs of chunk 'index' of a VerbReading.
+// Runs as one of the tasks of readVerbs().
+//
+//static
+void
+FrenchVerbDictionary::readVerbChunk(void *context, size_t index)
+{
+    VerbReading &reading = *static_cast<VerbReading *>(context);
+    VerbChunk &chunk = reading.chunks[index];
+    size_t numChunks = reading.chunks.size();
+    size_t begin = reading.numVerbs * index / numChunks;
+    size_t end = reading.numVerbs * (index + 1) / numChunks;
+
+    try
+    {
+        for (size_t k = begin; k < end; ++k)
+        {
+            if (reading.image != NULL)
+            {
+                const DictionaryImage::Verb &verb = reading.image->verbs[k];
+                reading.fvd->addVerb(verb.infinitive, verb.templateName, verb.aspirateH,
+                                     reading.includeWithoutAccents, chunk);
+            }
+            else
+                reading.fvd->readVerbNode(reading.doc, reading.verbNodes[k],
+                                          reading.includeWithoutAccents, chunk);
+        }
+    }
+    catch (const logic_error &e)
+    {
+        chunk.error = e.what();  // the verbs after this one are not read
+    }
+}
+
+
+// Reads one <v> node of a verbs document into 'chunk'.
+//
+void
+FrenchVerbDictionary::readVerbNode(xmlDocPtr doc, xmlNodePtr v,
+                                   bool includeWithoutAccents,
+                                   VerbChunk &chunk)
+                                                throw(logic_error)
+{
+    xmlNodePtr i = v->xmlChildrenNode;
+    if (i == NULL || i->xmlChildrenNode == NULL)
+        throw logic_error("missing <i> node");
+
+    string utf8Infinitive = getUTF8XmlNodeText(doc, i->xmlChildrenNode);
+
+    if (i->next == NULL)
+        throw logic_error("unexpected end after <i> node");
+
+    xmlNodePtr t = i->next->next;
+    if (t == NULL)
+        throw logic_error("missing <t> node");
+
+    #if 0
+    cout << "t=" << t << ", t->xmlChildrenNode=" << t->xmlChildrenNode << "\n";
+    if (t->xmlChildrenNode == NULL)
+        cout << "  t->next=" << t->next << ", " << (t->next ? getUTF8XmlNodeText(doc, t->next->xmlChildrenNode) : 0) << endl;
+    #endif
+
+    // Get template name (e.g., "aim:er") in UTF-8.
+    string utf8TName = getUTF8XmlNodeText(doc, t->xmlChildrenNode);
+
+    // <aspirate-h>: If this verb starts with an aspirate h, remember it:
+    bool aspirateH = (t->next != NULL && t->next->next != NULL);
+
+    addVerb(utf8Infinitive, utf8TName, aspirateH, includeWithoutAccents, chunk);
+}
+
+
+// Adds to 'chunk' a verb read from a verbs document or from a
+// dictionary image.
+// Does not modify the dictionary, so that the chunks can be read
+// in parallel.
+//
+void
+FrenchVerbDictionary::addVerb(const string &utf8Infinitive,
+                              const string &utf8TName,
+                              bool aspirateH,
+                              bool includeWithoutAccents,
+                              VerbChunk &chunk)
+                                                throw(logic_error)
+{
+    wstring wideInfinitive = utf8ToWide(utf8Infinitive);
+    if (wideInfinitive.empty())
+        throw logic_error("empty <i> node");
+    size_t lenInfinitive = wideInfinitive.length();
+    if (trace) cout << "utf8Infinitive='" << utf8Infinitive << "'\n";
+
+    if (utf8TName.empty())
+        throw logic_error("empty <t> node");
+    if (trace) cout << "  utf8TName='" << utf8TName << "'\n";
+
+    // Check that this template name (seen in verbs-*.xml) has been
+    // seen in conjugation-*.xml.
+    //
+    if (!hasTemplate(utf8TName))
+        throw logic_error("unknown template name: " + utf8TName);
+
+    // Find the offset of the colon in the template name.
+    // For example: the offset is 3 in the case of "aim:er".
+    // Find this offset in a wide character string, because
+    // the offset in a UTF-8 string is in bytes, not characters.
+    //
+    wstring wideTName = utf8ToWide(utf8TName);
+    wstring::size_type posColon = wideTName.find(':');
+    if (posColon == wstring::npos)
+        throw logic_error("missing colon in <t> node");
+    assert(wideTName[posColon] == ':');
+
+
+    chunk.knownVerbs.push_back(make_pair(utf8Infinitive, utf8TName));
+
+    if (includeWithoutAccents)
+    {
+        // Also include versions where some of all accents are missing.
+        vector<string> unaccentedVariants;
+        formUTF8UnaccentedVariants(wideInfinitive, 0, unaccentedVariants);
+        for (vector<string>::const_iterator it = unaccentedVariants.begin();
+                                            it != unaccentedVariants.end(); ++it)
+        {
+            if (trace) cout << "  unaccvar: '" << *it << "'\n";
+            chunk.knownVerbs.push_back(make_pair(*it, utf8TName));
+        }
+    }
+
+    if (aspirateH)
+        chunk.aspirateHVerbs.push_back(utf8Infinitive);
+
+    // Insert the verb in the trie.
+    // A list of template names is associated to each verb in this trie.
+
+    size_t lenTermination = wideTName.length() - posColon - 1;
+    assert(lenTermination > 0);
+    assert(lenInfinitive >= lenTermination);
+
+    wstring wideVerbRadical(wideInfinitive, 0, lenInfinitive - lenTermination);
+    string utf8VerbRadical = wideToUTF8(wideVerbRadical);
+
+    insertVerbRadicalInTrie(chunk, utf8VerbRadical, utf8TName, utf8VerbRadical);
+
+    if (includeWithoutAccents)
+    {
+        // Also include versions where some of all accents are missing.
+        vector<string> unaccentedVariants;
+        formUTF8UnaccentedVariants(wideVerbRadical, 0, unaccentedVariants);
+        for (vector<string>::const_iterator it = unaccentedVariants.begin();
+                                            it != unaccentedVariants.end(); ++it)
+        {
+            insertVerbRadicalInTrie(chunk, *it, utf8TName, utf8VerbRadical);  // pass correct verb radical as 3rd argument
+        }
+    }
+}
+
+
+// String parameters expected to be in UTF-8.
+// Adds to the chunk the radical to be stored in 'verbTrie',
+// which contains wide character strings.
+//
+void
+FrenchVerbDictionary::insertVerbRadicalInTrie(
+                                    VerbChunk &chunk,
+                                    const std::string &verbRadical,
+                                    const std::string &tname,
+                                    const std::string &correctVerbRadical) const
+{
+    wstring wideVerbRadical = utf8ToWide(verbRadical);
+    if (trace)
+        cout << "insertVerbRadicalInTrie('"
+              << verbRadical << "' (len=" << wideVerbRadical.length()
+              << "), '" << tname
+              << "', '" << correctVerbRadical
+              << "')\n";
+
+    chunk.radicalTuples.push_back(RadicalTuple(wstring(),
+                                               TrieValue(tname, correctVerbRadical,
+                                                         verbRadical == correctVerbRadical)));
+    chunk.radicalTuples.back().radical.swap(wideVerbRadical);
+    chunk.utf8Radicals.push_back(verbRadical);
+}
+
+
+// Position of a radical tuple with the first characters of its radical,
+// one byte each, so that most comparisons are integer comparisons.
+// A character from U+00FF up is stored as 0xFF and ends the prefix,
+// which then ties with all the radicals that start the same way.
+//
+struct RadicalSortKey
+{
+    unsigned long long prefix;
+    size_t index;
+
+    RadicalSortKey(const wstring &radical, size_t i)
+      : prefix(0),
+        index(i)
+    {
+        bool stopped = false;
+        for (wstring::size_type k = 0; k < 8; ++k)
+        {
+            unsigned long byte = 0;
+            if (!stopped && k < radical.length())
+            {
+                byte = min((unsigned long) radical[k], 0xFFUL);
+                stopped = (byte == 0xFF);
+            }
+            prefix = (prefix << 8) | byte;
+        }
+    }
+};
+
+
+// Orders the sort keys of radical tuples by radical, then by position.
+//
+template <class Tuple>
+class RadicalSortKeyLess
+{
+public:
+    RadicalSortKeyLess(const vector<Tuple> &t) : tuples(t) {}
+    bool operator () (const RadicalSortKey &a, const RadicalSortKey &b) const
+    {
+        if (a.prefix != b.prefix)
+            return a.prefix < b.prefix;
+        int c = tuples[a.index].radical.compare(tuples[b.index].radical);
+        if (c != 0)
+            return c < 0;
+        return a.index < b.index;
+    }
+private:
+    const vector<Tuple> &tuples;
+};
+
+
+// Stores the radicals of 'radicalTuples' in 'verbTrie', which is
+// built in a single pass over the sorted radicals instead of one
+// search from the root per radical.  A radical receives the list of
+// its templates, in the order in which they were read.
+//
+void
+FrenchVerbDictionary::buildVerbTrie(size_t numThreads)
+{
+    // The radicals that are already in the trie, if any, come first.
+    VerbTrie::EntryList entries;
+    verbTrie.getEntries(entries);
+    verbTrie.clear(false);
+    vector<RadicalTuple> oldTuples;
+    for (VerbTrie::EntryList::const_iterator it = entries.begin(); it != entries.end(); ++it)
+    {
+        for (vector<TrieValue>::const_iterator v = it->second->begin(); v != it->second->end(); ++v)
+            oldTuples.push_back(RadicalTuple(it->first, *v));
+        delete it->second;
+    }
+    radicalTuples.insert(radicalTuples.begin(), oldTuples.begin(), oldTuples.end());
+    entries.clear();
+
+    // The positions break the ties, which keeps the reading order
+    // of the templates of a radical.
+    vector<RadicalSortKey> order;
+    order.reserve(radicalTuples.size());
+    for (size_t k = 0; k < radicalTuples.size(); ++k)
+        order.push_back(RadicalSortKey(radicalTuples[k].radical, k));
+    sort(order.begin(), order.end(), RadicalSortKeyLess<RadicalTuple>(radicalTuples));
+
+    // The strings are moved out of the tuples, which are not used afterwards.
+    entries.reserve(radicalTuples.size());
+    for (size_t k = 0; k < order.size(); )
+    {
+        wstring &radical = radicalTuples[order[k].index].radical;
+        size_t end = k + 1;
+        while (end < order.size() && radicalTuples[order[end].index].radical == radical)
+            ++end;
+
+        vector<TrieValue> *templateList = new vector<TrieValue>();
+        templateList->reserve(end - k);
+        for (size_t j = k; j < end; ++j)
+        {
+            TrieValue &value = radicalTuples[order[j].index].value;
+            templateList->push_back(TrieValue(string(), string(), value.correct));
+            templateList->back().templateName.swap(value.templateName);
+            templateList->back().correctVerbRadical.swap(value.correctVerbRadical);
+        }
+        entries.push_back(make_pair(wstring(), templateList));
+        entries.back().first.swap(radical);
+        k = end;
+    }
+
+    vector<RadicalTuple>().swap(radicalTuples);
+    verbTrie.build(entries, numThreads);
+}
+
+
+FrenchVerbDictionary::~FrenchVerbDictionary()
+{
+    delete succinctVerbTrie;
+    delete lookupCache;
+    pthread_rwlock_destroy(&templateLock);
+    pthread_rwlock_destroy(&userLayerLock);
+}
+
+
+const TemplateSpec *
+FrenchVerbDictionary::getTemplate(const string &templateName) const
+{
+    if (lazyImage != NULL)
+    {
+        if (!decodeTemplate(templateName))
+            return NULL;
+        AutoRWLock lock(templateLock, false);
+        return &conjugSys.find(templateName)->second;
+    }
+
+    ConjugationSystem::const_iterator it = conjugSys.find(templateName);
+    if (it == conjugSys.end())
+        return NULL;
+    return &it->second;
+}
+
+
+size_t
+FrenchVerbDictionary::getNumDecodedTemplates() const
+{
+    AutoRWLock lock(templateLock, false);  // for lazyImage
+    return conjugSys.size();
+}
+
+
+ConjugationSystem::const_iterator
+FrenchVerbDictionary::beginConjugSys() const
+{
+    if (lazyImage != NULL)
+        for (size_t k = 0; k < lazyImage->numTemplates; ++k)
+            decodeTemplate(lazyImage->templates[k].name);
+    return conjugSys.begin();
+}
+
+
+ConjugationSystem::const_iterator
+FrenchVerbDictionary::endConjugSys() const
+{
+    return conjugSys.end();
+}
+
+
+std::set<std::string>
+FrenchVerbDictionary::getVerbTemplateSet(const char *infinitive) const
 {
-    static const std::set<std::string> emptySet;
     if (infinitive == NULL)
-        return emptySet;
+        return std::set<std::string>();
+    if (loadShared(hasUserVerbs))
+    {
+        // The set of a user verb is copied while the lock is held:
+        // addUserVerbs() and removeVerb() modify it in place.
+        AutoRWLock lock(userLayerLock, false);
+        VerbTable::const_iterator it = userVerbs.find(infinitive);
+        if (it != userVerbs.end())
+            return it->second;
+    }
     VerbTable::const_iterator it = knownVerbs.find(infinitive);
     if (it == knownVerbs.end())
-        return emptySet;
+        return std::set<std::string>();
     return it->second;
 }
 
 
-const std::set<std::string> &
+std::set<std::string>
 FrenchVerbDictionary::getVerbTemplateSet(const string &infinitive) const
 {
-    return getVerbTemplateSet(infinitive.c_str());
+    return getVerbTemplateSet(infinitive.c_str());
+}
+
+
+VerbTable::const_iterator
+FrenchVerbDictionary::beginKnownVerbs() const
+{
+    return knownVerbs.begin();
+}
+
+
+VerbTable::const_iterator
+FrenchVerbDictionary::endKnownVerbs() const
+{
+    return knownVerbs.end();
+}
+
+
+VerbTable::const_iterator
+FrenchVerbDictionary::beginUserVerbs() const
+{
+    return userVerbs.begin();
+}
+
+
+VerbTable::const_iterator
+FrenchVerbDictionary::endUserVerbs() const
+{
+    return userVerbs.end();
+}
+
+
+const std::vector<ModeTensePersonNumber> *
+FrenchVerbDictionary::getMTPNForInflection(
+                                const std::string &templateName,
+                                const std::string &inflection) const
+{
+    const TemplateInflectionTable *ti = findTemplateInflectionTable(templateName);
+    if (ti == NULL)
+        return NULL;
+    TemplateInflectionTable::const_iterator j = ti->find(inflection);
+    if (j == ti->end())
+        return NULL;
+    return &j->second;
+}
+
+
+/*static*/
+Mode
+FrenchVerbDictionary::convertModeName(const char *modeName)
+{
+    Mode mode = INVALID_MODE;
+    if (modeName == NULL)
+        ;
+    else if (strcmp(modeName, "infinitive") == 0)
+        mode = INFINITIVE_MODE;
+    else if (strcmp(modeName, "indicative") == 0)
+        mode = INDICATIVE_MODE;
+    else if (strcmp(modeName, "conditional") == 0)
+        mode = CONDITIONAL_MODE;
+    else if (strcmp(modeName, "subjunctive") == 0)
+        mode = SUBJUNCTIVE_MODE;
+    else if (strcmp(modeName, "imperative") == 0)
+        mode = IMPERATIVE_MODE;
+    else if (strcmp(modeName, "participle") == 0)
+        mode = PARTICIPLE_MODE;
+    else if (strcmp(modeName, "gerund") == 0)
+        mode = GERUND_MODE;
+    else if (strcmp(modeName, "present-indicative") == 0)
+        mode = PRESENT_INDICATIVE;
+    else if (strcmp(modeName, "present-subjunctive") == 0)
+        mode = PRESENT_SUBJUNCTIVE;
+    else if (strcmp(modeName, "present-imperative") == 0)
+        mode = PRESENT_IMPERATIVE;
+    else if (strcmp(modeName, "present-gerund") == 0)
+        mode = PRESENT_GERUND;
+    else if (strcmp(modeName, "past-imperfect-indicative") == 0)
+        mode = PAST_IMPERFECT_INDICATIVE;
+    else if (strcmp(modeName, "past-perfect-indicative") == 0)
+        mode = PAST_PERFECT_INDICATIVE;
+    else if (strcmp(modeName, "past-perfect-subjunctive") == 0)
+        mode = PAST_PERFECT_SUBJUNCTIVE;
+    else if (strcmp(modeName, "past-perfect-imperative") == 0)
+        mode = PAST_PERFECT_IMPERATIVE;
+    else if (strcmp(modeName, "past-perfect-infinitive") == 0)
+        mode = PAST_PERFECT_INFINITIVE;
+
+    if (mode == INVALID_MODE)
+    {
+        if (trace) cout << "modeName='" << modeName << "'" << endl;
+        assert(!"Invalid mode");
+    }
+
+    return mode;
+}
+
+
+/*static*/
+Tense
+FrenchVerbDictionary::convertTenseName(const char *tenseName)
+{
+    Tense tense = INVALID_TENSE;
+    if (tenseName == NULL)
+        ;
+    else if (strcmp(tenseName, "infinitive-present") == 0)
+        tense = PRESENT_TENSE;
+    else if (strcmp(tenseName, "present") == 0)
+        tense = PRESENT_TENSE;
+    else if (strcmp(tenseName, "imperfect") == 0)
+        tense = IMPERFECT_TENSE;
+    else if (strcmp(tenseName, "future") == 0)
+        tense = FUTURE_TENSE;
+    else if (strcmp(tenseName, "simple-past") == 0)
+        tense = PAST_TENSE;
+    else if (strcmp(tenseName, "imperative-present") == 0)
+        tense = PRESENT_TENSE;
+    else if (strcmp(tenseName, "present-participle") == 0)
+        tense = PRESENT_TENSE;
+    else if (strcmp(tenseName, "past-participle") == 0)
+        tense = PAST_TENSE;
+    else if (strcmp(tenseName, "past") == 0)
+        tense = PAST_TENSE;
+    else if (strcmp(tenseName, "present-gerund") == 0)
+        tense = PRESENT_TENSE;
+    else if (strcmp(tenseName, "active") == 0)
+        tense = ACTIVE_TENSE;
+    else if (strcmp(tenseName, "passive") == 0)
+        tense = PASSIVE_TENSE;
+    else if (strcmp(tenseName, "imp-active") == 0)
+        tense = IMPERATIVE_ACTIVE_TENSE;
+    else if (strcmp(tenseName, "imp-passive") == 0)
+        tense = IMPERATIVE_PASSIVE_TENSE;
+    else if (strcmp(tenseName, "past-perfect") == 0)
+        tense = PAST_PERFECT;
+
+    if (tense == INVALID_TENSE)
+    {
+        if (trace) cout << "tenseName='" << tenseName << "'" << endl;
+        assert(!"Invalid tense");
+    }
+
+    return tense;
+}
+
+
+void
+FrenchVerbDictionary::deconjugate(const string &utf8ConjugatedVerb,
+                                std::vector<InflectionDesc> &results) const
+{
+    vector<InflectionGroup> groups;
+    deconjugate(utf8ConjugatedVerb, groups);
+
+    for (vector<InflectionGroup>::const_iterator g = groups.begin();
+                                                 g != groups.end(); ++g)
+        for (vector<ModeTensePersonNumber>::const_iterator k = g->mtpns.begin();
+                                                 k != g->mtpns.end(); ++k)
+            results.push_back(InflectionDesc(g->infinitive, g->templateName, *k));
+}
+
+
+void
+FrenchVerbDictionary::deconjugate(const string &utf8ConjugatedVerb,
+                                std::vector<InflectionGroup> &results) const
+{
+    deconjugate(utf8ConjugatedVerb, LookupOptions(), results);
+}
+
+
+void
+FrenchVerbDictionary::deconjugate(const string &utf8ConjugatedVerb,
+                                const LookupOptions &options,
+                                std::vector<InflectionGroup> &results) const
+{
+    if (options.lang != NO_LANGUAGE && options.lang != lang)
+        return;
+
+    // The user layer is only locked if it has verbs.  The results are
+    // cached with the version of the user layer that they come from,
+    // read first: the cache refuses them if the layer has changed since.
+    unsigned long version = loadShared(userLayerVersion);
+    bool withUserLayer = loadShared(hasUserVerbs);
+    OptionalReadLock userLock(userLayerLock, withUserLayer);
+    if (userLock.isHeld())
+    {
+        withUserLayer = hasUserVerbs;
+        version = userLayerVersion;
+    }
+
+    bool mayBeBaseVerb = formFilter.mayBeVerb(utf8ConjugatedVerb);
+    if (!mayBeBaseVerb && !withUserLayer)
+        return;
+
+    if (findInLookupCache(utf8ConjugatedVerb, options, results))
+        return;
+
+    vector<InflectionGroup> found;
+    InflectionCollector collector(*this, options, found);
+
+    try
+    {
+        wstring w = utf8ToWide(utf8ConjugatedVerb);
+        if (withUserLayer)
+            collector.searchUserLayer(w);
+        if (mayBeBaseVerb)
+        {
+            if (succinctVerbTrie != NULL)
+                (void) succinctVerbTrie->get(w, collector);
+            else
+                (void) verbTrie.get(w, collector);
+        }
+        collector.finish(w);
+    }
+    catch (int e)  // exception throw by utf8towide()
+    {
+        // Wrong encoding (possibly Latin-1). Act as with unknown verb.
+    }
+
+    if (lookupCache != NULL && options.acceptsAll())
+        lookupCache->insert(utf8ConjugatedVerb, found, version);
+    results.insert(results.end(), found.begin(), found.end());
+}
+
+
+// The cache holds unrestricted results, from which the results
+// of any options can be extracted.  Restricted searches are not
+// stored because their results are incomplete.
+//
+bool
+FrenchVerbDictionary::findInLookupCache(const string &utf8ConjugatedVerb,
+                                        const LookupOptions &options,
+                                        vector<InflectionGroup> &results) const
+{
+    if (lookupCache == NULL)
+        return false;
+
+    if (options.acceptsAll())
+        return lookupCache->find(utf8ConjugatedVerb, results);
+
+    vector<InflectionGroup> cached;
+    if (!lookupCache->find(utf8ConjugatedVerb, cached))
+        return false;
+    filterResults(cached, options, results);
+    return true;
+}
+
+
+//static
+void
+FrenchVerbDictionary::filterResults(const vector<InflectionGroup> &groups,
+                                    const LookupOptions &options,
+                                    vector<InflectionGroup> &results)
+{
+    size_t numResults = 0;
+    for (vector<InflectionGroup>::const_iterator g = groups.begin();
+                                                 g != groups.end(); ++g)
+    {
+        if (!g->correctRadical && !options.acceptMisspellings)
+            continue;
+
+        InflectionGroup *dest = NULL;
+        for (vector<ModeTensePersonNumber>::const_iterator k = g->mtpns.begin();
+                                                 k != g->mtpns.end(); ++k)
+        {
+            if (!options.accepts(*k))
+                continue;
+            if (options.maxResults != 0 && numResults == options.maxResults)
+                return;
+            if (dest == NULL)
+            {
+                results.push_back(InflectionGroup(g->infinitive, g->templateName,
+                                                  g->correctRadical));
+                dest = &results.back();
+            }
+            dest->mtpns.push_back(*k);
+            ++numResults;
+        }
+    }
+}
+
+
+bool
+FrenchVerbDictionary::mayBeConjugatedVerb(const string &utf8Word) const
+{
+    if (formFilter.mayBeVerb(utf8Word))
+        return true;
+    if (!loadShared(hasUserVerbs))
+        return false;
+
+    AutoRWLock lock(userLayerLock, false);
+    try
+    {
+        UserMatchRecorder recorder;
+        (void) userVerbTrie.get(utf8ToWide(utf8Word), recorder);
+        return !recorder.matches.empty();
+    }
+    catch (int e)  // exception throw by utf8towide()
+    {
+        return false;
+    }
+}
+
+
+// Passes each proposed word to a vector.
+//
+class CompletionVector : public FrenchVerbDictionary::CompletionReceiver
+{
+public:
+    CompletionVector(vector<string> &w) : words(w) {}
+
+    virtual bool onCompletion(const string &utf8Word, const string &/*utf8Infinitive*/)
+    {
+        words.push_back(utf8Word);
+        return true;
+    }
+
+private:
+    vector<string> &words;
+};
+
+
+size_t
+FrenchVerbDictionary::complete(const string &utf8Prefix,
+                               const CompletionOptions &options,
+                               CompletionReceiver &receiver) const
+{
+    bool withUserLayer = loadShared(hasUserVerbs);
+    OptionalReadLock userLock(userLayerLock, withUserLayer);
+    if (userLock.isHeld())
+        withUserLayer = hasUserVerbs;
+
+    try
+    {
+        wstring prefix = utf8ToWide(utf8Prefix);
+        if (options.ignoreAccents)
+            for (size_t i = 0; i < prefix.length(); ++i)
+                prefix[i] = removeWideCharAccent(prefix[i]);
+
+        // The verbs of the user layer come first.
+        CompletionCollector collector(*this, options, receiver, prefix);
+        if (withUserLayer && !collector.search(userVerbTrie, false))
+            return collector.getNumProposed();
+        if (succinctVerbTrie != NULL)
+            (void) collector.search(*succinctVerbTrie, withUserLayer);
+        else
+            (void) collector.search(verbTrie, withUserLayer);
+        return collector.getNumProposed();
+    }
+    catch (int e)  // exception throw by utf8towide()
+    {
+        // Wrong encoding (possibly Latin-1). Act as with unknown prefix.
+        return 0;
+    }
+}
+
+
+void
+FrenchVerbDictionary::complete(const string &utf8Prefix,
+                               const CompletionOptions &options,
+                               vector<string> &utf8Words) const
+{
+    CompletionVector receiver(utf8Words);
+    (void) complete(utf8Prefix, options, receiver);
+}
+
+
+// The radicals that are prefixes of the searched prefix are found
+// by get(), the others by getWithPrefix(), which also reports the
+// radical equal to the prefix.
+//
+template <class VerbTrieType>
+bool
+FrenchVerbDictionary::CompletionCollector::search(const VerbTrieType &trie,
+                                                  bool filterRemoved)
+{
+    filterBaseLayer = filterRemoved;
+    enumerating = false;
+    (void) trie.get(prefix, *this);
+    if (!stopped)
+    {
+        enumerating = true;
+        (void) trie.getWithPrefix(prefix, *this);
+    }
+    return !stopped;
+}
+
+
+bool
+FrenchVerbDictionary::CompletionCollector::onFoundPrefixWithUserData(
+                        const wstring &key,
+                        wstring::size_type index,
+                        const vector<TrieValue> *templateList)
+{
+    if (stopped)
+        return false;
+    if (!enumerating && index == prefix.length())
+        return true;  // getWithPrefix() will report it
+
+    // Part of the prefix that the termination must begin with.
+    string utf8Rest;
+    if (index < prefix.length())
+        utf8Rest = fvd.wideToUTF8(wstring(key, index));
+
+    for (vector<TrieValue>::const_iterator i = templateList->begin();
+                                           i != templateList->end(); ++i)
+    {
+        const TrieValue &trieValue = *i;
+        if (!trieValue.correct && !options.ignoreAccents)
+            continue;  // radical reached through missing accents
+        if (filterBaseLayer && fvd.isRemovedVerb(trieValue))
+            continue;  // verb hidden by the user layer
+
+        const string &tname = trieValue.templateName;
+        if (options.infinitivesOnly)
+        {
+            string::size_type posColon = tname.find(':');
+            if (!propose(trieValue, string(tname, posColon + 1), utf8Rest))
+                return false;
+            continue;
+        }
+
+        const TemplateInflectionTable *ti = fvd.findTemplateInflectionTable(tname);
+        if (ti == NULL)
+            continue;
+
+        // The terminations are sorted, so those that begin with
+        // 'utf8Rest' are consecutive, unless accents are ignored.
+        TemplateInflectionTable::const_iterator j =
+                        (options.ignoreAccents ? ti->begin() : ti->lower_bound(utf8Rest));
+        for ( ; j != ti->end(); ++j)
+        {
+            if (!options.ignoreAccents && j->first.compare(0, utf8Rest.length(), utf8Rest) != 0)
+                break;
+
+            // Only the correct spellings are proposed.
+            bool correct = false;
+            for (vector<ModeTensePersonNumber>::const_iterator k = j->second.begin();
+                                                        k != j->second.end() && !correct; ++k)
+                correct = k->correct;
+            if (correct && !propose(trieValue, j->first, utf8Rest))
+                return false;
+        }
+    }
+    return true;
+}
+
+
+// Passes the word made of a radical and a termination to the receiver,
+// if the termination begins with 'utf8Rest' and if the word has not
+// been proposed yet.
+// Returns false when the completion is over.
+//
+bool
+FrenchVerbDictionary::CompletionCollector::propose(const TrieValue &trieValue,
+                                                   const string &termination,
+                                                   const string &utf8Rest)
+{
+    const string &comparedTermination =
+                (options.ignoreAccents && !utf8Rest.empty()
+                        ? fvd.removeUTF8Accents(termination) : termination);
+    if (comparedTermination.compare(0, utf8Rest.length(), utf8Rest) != 0)
+        return true;
+
+    string word = trieValue.correctVerbRadical + termination;
+    if (!proposed.insert(word).second)
+        return true;
+
+    if (!receiver.onCompletion(word, getInfinitive(trieValue.correctVerbRadical,
+                                                   trieValue.templateName))
+            || (options.maxResults != 0 && proposed.size() >= options.maxResults))
+    {
+        stopped = true;
+        return false;
+    }
+    return true;
+}
+
+
+bool
+FrenchVerbDictionary::fuzzyDeconjugate(const string &utf8Word,
+                                       const FuzzyOptions &options,
+                                       vector<FuzzyMatch> &matches) const
+{
+    matches.clear();
+
+    bool withUserLayer = loadShared(hasUserVerbs);
+    OptionalReadLock userLock(userLayerLock, withUserLayer);
+    if (userLock.isHeld())
+        withUserLayer = hasUserVerbs;
+
+    wstring word;
+    try
+    {
+        word = utf8ToWide(utf8Word);
+    }
+    catch (int e)  // exception throw by utf8towide()
+    {
+        // Wrong encoding (possibly Latin-1). Act as with unknown verb.
+        return true;
+    }
+
+    FuzzySearch search(*this, word, options);
+    bool complete = (!withUserLayer || search.search(userVerbTrie, false));
+    if (complete)
+    {
+        if (succinctVerbTrie != NULL)
+            complete = search.search(*succinctVerbTrie, withUserLayer);
+        else
+            complete = search.search(verbTrie, withUserLayer);
+    }
+    search.getMatches(matches);
+    return complete;
+}
+
+
+// Returns the cost of the edits from a known word to a typed one,
+// where the usual typos cost 1 and the other edits cost 2:
+// transposing two letters, typing a doubled letter once, or typing
+// a letter twice, as in "apeller" for "appeler".
+//
+static unsigned
+getTypoCost(const wstring &typed, const wstring &known)
+{
+    const size_t n = typed.length(), w = known.length() + 1;
+    vector<unsigned> d((n + 1) * w);  // d[i * w + j]: first i typed, first j known
+    for (size_t i = 0; i <= n; ++i)
+        for (size_t j = 0; j < w; ++j)
+        {
+            unsigned cost = (i == 0 && j == 0 ? 0 : ~0U);
+            if (i > 0)  // extra letter typed
+            {
+                bool doubled = (i > 1 && typed[i - 1] == typed[i - 2])
+                               || (i < n && typed[i - 1] == typed[i]);
+                cost = min(cost, d[(i - 1) * w + j] + (doubled ? 1 : 2));
+            }
+            if (j > 0)  // letter of the known word not typed
+            {
+                bool doubled = (j > 1 && known[j - 1] == known[j - 2])
+                               || (j + 1 < w && known[j - 1] == known[j]);
+                cost = min(cost, d[i * w + j - 1] + (doubled ? 1 : 2));
+            }
+            if (i > 0 && j > 0)
+                cost = min(cost, d[(i - 1) * w + j - 1] + (typed[i - 1] == known[j - 1] ? 0 : 2));
+            if (i > 1 && j > 1 && typed[i - 1] == known[j - 2] && typed[i - 2] == known[j - 1])
+                cost = min(cost, d[(i - 2) * w + j - 2] + 1);
+            d[i * w + j] = cost;
+        }
+    return d[n * w + w - 1];
+}
+
+
+// Returns the current time in seconds.
+//
+static double
+getTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+
+FrenchVerbDictionary::FuzzySearch::FuzzySearch(const FrenchVerbDictionary &d,
+                                               const wstring &w,
+                                               const FuzzyOptions &o)
+  : fvd(d),
+    word(w),
+    options(o),
+    width(w.length() + 1),
+    rows(),
+    path(),
+    bound(o.maxDistance),
+    numMatchesAt(o.maxDistance + 1, 0),
+    charEnds(),
+    candidates(),
+    matchKeys(),
+    filterBaseLayer(false),
+    numSteps(0),
+    deadline(o.maxMicroseconds != 0 ? getTime() + o.maxMicroseconds / 1e6 : 0),
+    timeUp(false)
+{
+    for (size_t i = 0; i < word.length(); ++i)
+        word[i] = removeWideCharAccent(word[i]);
+
+    // Row of the empty path: i deletions for the first i characters.
+    rows.reserve(width * 32);
+    for (size_t i = 0; i < width; ++i)
+        rows.push_back(unsigned(i));
+}
+
+
+template <class VerbTrieType>
+bool
+FrenchVerbDictionary::FuzzySearch::search(const VerbTrieType &trie,
+                                          bool filterRemoved)
+{
+    filterBaseLayer = filterRemoved;
+    (void) trie.walk(*this);
+    return !timeUp;
+}
+
+
+bool
+FrenchVerbDictionary::FuzzySearch::onEnter(wchar_t c)
+{
+    if (isTimeUp())
+        return false;
+    if (pushChar(c))
+        return true;
+    popChar();
+    return false;
+}
+
+
+void
+FrenchVerbDictionary::FuzzySearch::onLeave()
+{
+    popChar();
 }
 
 
-VerbTable::const_iterator
-FrenchVerbDictionary::beginKnownVerbs() const
+bool
+FrenchVerbDictionary::FuzzySearch::onUserData(const vector<TrieValue> *templateList)
 {
-    return knownVerbs.begin();
+    if (isTimeUp())
+        return false;
+
+    for (vector<TrieValue>::const_iterator i = templateList->begin();
+                                           i != templateList->end(); ++i)
+    {
+        if (!i->correct)
+            continue;  // accents are ignored by the distance itself
+        if (filterBaseLayer && fvd.isRemovedVerb(*i))
+            continue;  // verb hidden by the user layer
+        matchTerminations(*i);
+    }
+    return true;
 }
 
 
-VerbTable::const_iterator
-FrenchVerbDictionary::endKnownVerbs() const
+// Appends the row of the distance table for the character 'c'
+// added to the path.
+// Returns false if no extension of the path is within the distance.
+//
+bool
+FrenchVerbDictionary::FuzzySearch::pushChar(wchar_t c)
 {
-    return knownVerbs.end();
+    c = removeWideCharAccent(c);
+    size_t m = path.length();
+    if (rows.size() < (m + 2) * width)
+        rows.resize((m + 2) * width);  // kept for the next paths this deep
+    const unsigned *prev = &rows[m * width];
+    unsigned *cur = &rows[(m + 1) * width];
+    const unsigned ceiling = options.maxDistance + 1;  // larger values are not needed
+
+    cur[0] = min(prev[0] + 1, ceiling);
+    unsigned smallest = cur[0];
+    for (size_t i = 1; i < width; ++i)
+    {
+        unsigned d = prev[i - 1] + (word[i - 1] != c ? 1 : 0);  // substitution
+        d = min(d, prev[i] + 1);  // insertion
+        d = min(d, cur[i - 1] + 1);  // deletion
+        if (m > 0 && i > 1 && word[i - 1] == path[m - 1] && word[i - 2] == c)
+            d = min(d, rows[(m - 1) * width + i - 2] + 1);  // transposition
+        cur[i] = min(d, ceiling);
+        smallest = min(smallest, cur[i]);
+    }
+
+    path += c;
+    ++numSteps;
+    return smallest <= bound;
 }
 
 
-const std::vector<ModeTensePersonNumber> *
-FrenchVerbDictionary::getMTPNForInflection(
-                                const std::string &templateName,
-                                const std::string &inflection) const
+// Decodes the UTF-8 character at 'pos' and advances 'pos' past it.
+// The string must be valid, as the terminations of the templates are.
+//
+static wchar_t
+nextUTF8Char(const string &s, string::size_type &pos)
 {
-    InflectionTable::const_iterator i = inflectionTable.find(templateName);
-    if (i == inflectionTable.end())
-        return NULL;
-    const TemplateInflectionTable &ti = i->second;
-    TemplateInflectionTable::const_iterator j = ti.find(inflection);
-    if (j == ti.end())
-        return NULL;
-    return &j->second;
+    unsigned long c = (unsigned char) s[pos++];
+    if (c < 0x80)
+        return wchar_t(c);
+    size_t numContBytes = (c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : 1);
+    c &= 0x3F >> numContBytes;
+    for ( ; numContBytes > 0 && pos < s.length(); --numContBytes)
+        c = (c << 6) | ((unsigned char) s[pos++] & 0x3F);
+    return wchar_t(c);
 }
 
 
-/*static*/
-Mode
-FrenchVerbDictionary::convertModeName(const char *modeName)
+// Extends the current path, which is a radical of the given verb, with
+// each termination of its template that has a correct inflection.
+// The terminations are sorted, and consecutive ones share the rows of
+// their common prefix; those that begin with a prefix that is already
+// too far are skipped.  They are decoded here, because converting all
+// of them would cost more than the search.
+//
+void
+FrenchVerbDictionary::FuzzySearch::matchTerminations(const TrieValue &trieValue)
 {
-    Mode mode = INVALID_MODE;
-    if (modeName == NULL)
-        ;
-    else if (strcmp(modeName, "infinitive") == 0)
-        mode = INFINITIVE_MODE;
-    else if (strcmp(modeName, "indicative") == 0)
-        mode = INDICATIVE_MODE;
-    else if (strcmp(modeName, "conditional") == 0)
-        mode = CONDITIONAL_MODE;
-    else if (strcmp(modeName, "subjunctive") == 0)
-        mode = SUBJUNCTIVE_MODE;
-    else if (strcmp(modeName, "imperative") == 0)
-        mode = IMPERATIVE_MODE;
-    else if (strcmp(modeName, "participle") == 0)
-        mode = PARTICIPLE_MODE;
-    else if (strcmp(modeName, "gerund") == 0)
-        mode = GERUND_MODE;
-    else if (strcmp(modeName, "present-indicative") == 0)
-        mode = PRESENT_INDICATIVE;
-    else if (strcmp(modeName, "present-subjunctive") == 0)
-        mode = PRESENT_SUBJUNCTIVE;
-    else if (strcmp(modeName, "present-imperative") == 0)
-        mode = PRESENT_IMPERATIVE;
-    else if (strcmp(modeName, "present-gerund") == 0)
-        mode = PRESENT_GERUND;
-    else if (strcmp(modeName, "past-imperfect-indicative") == 0)
-        mode = PAST_IMPERFECT_INDICATIVE;
-    else if (strcmp(modeName, "past-perfect-indicative") == 0)
-        mode = PAST_PERFECT_INDICATIVE;
-    else if (strcmp(modeName, "past-perfect-subjunctive") == 0)
-        mode = PAST_PERFECT_SUBJUNCTIVE;
-    else if (strcmp(modeName, "past-perfect-imperative") == 0)
-        mode = PAST_PERFECT_IMPERATIVE;
-    else if (strcmp(modeName, "past-perfect-infinitive") == 0)
-        mode = PAST_PERFECT_INFINITIVE;
+    const TemplateInflectionTable *ti = fvd.findTemplateInflectionTable(trieValue.templateName);
+    if (ti == NULL)
+        return;
 
-    if (mode == INVALID_MODE)
+    const size_t radicalLength = path.length();
+    const string *previous = NULL;  // termination whose characters are in 'path'
+    string::size_type deadEnd = 0;  // if not zero, the prefix of 'previous' that is too far
+    charEnds.clear();
+
+    for (TemplateInflectionTable::const_iterator t = ti->begin(); t != ti->end(); ++t)
     {
-        if (trace) cout << "modeName='" << modeName << "'" << endl;
-        assert(!"Invalid mode");
+        bool correct = false;
+        for (vector<ModeTensePersonNumber>::const_iterator k = t->second.begin();
+                                                    k != t->second.end() && !correct; ++k)
+            correct = k->correct;
+        if (!correct)
+            continue;
+
+        const string &termination = t->first;
+        string::size_type common = 0;
+        if (previous != NULL)
+        {
+            string::size_type limit = min(termination.length(), charEnds.empty() ? 0 : charEnds.back());
+            while (common < limit && (*previous)[common] == termination[common])
+                ++common;
+        }
+        if (deadEnd != 0 && common >= deadEnd)
+            continue;
+
+        while (!charEnds.empty() && charEnds.back() > common)
+        {
+            popChar();
+            charEnds.pop_back();
+        }
+        deadEnd = 0;
+        previous = &termination;
+
+        string::size_type pos = (charEnds.empty() ? 0 : charEnds.back());
+        while (pos < termination.length())
+        {
+            bool near = pushChar(nextUTF8Char(termination, pos));
+            charEnds.push_back(pos);
+            if (!near)
+            {
+                deadEnd = pos;
+                break;
+            }
+        }
+        if (deadEnd == 0 && getDistance() <= bound)
+            addMatch(trieValue, termination, t->second, getDistance());
     }
 
-    return mode;
+    path.erase(radicalLength);
 }
 
 
-/*static*/
-Tense
-FrenchVerbDictionary::convertTenseName(const char *tenseName)
+void
+FrenchVerbDictionary::FuzzySearch::addMatch(const TrieValue &trieValue,
+                                            const string &termination,
+                                            const vector<ModeTensePersonNumber> &mtpns,
+                                            unsigned distance)
 {
-    Tense tense = INVALID_TENSE;
-    if (tenseName == NULL)
-        ;
-    else if (strcmp(tenseName, "infinitive-present") == 0)
-        tense = PRESENT_TENSE;
-    else if (strcmp(tenseName, "present") == 0)
-        tense = PRESENT_TENSE;
-    else if (strcmp(tenseName, "imperfect") == 0)
-        tense = IMPERFECT_TENSE;
-    else if (strcmp(tenseName, "future") == 0)
-        tense = FUTURE_TENSE;
-    else if (strcmp(tenseName, "simple-past") == 0)
-        tense = PAST_TENSE;
-    else if (strcmp(tenseName, "imperative-present") == 0)
-        tense = PRESENT_TENSE;
-    else if (strcmp(tenseName, "present-participle") == 0)
-        tense = PRESENT_TENSE;
-    else if (strcmp(tenseName, "past-participle") == 0)
-        tense = PAST_TENSE;
-    else if (strcmp(tenseName, "past") == 0)
-        tense = PAST_TENSE;
-    else if (strcmp(tenseName, "present-gerund") == 0)
-        tense = PRESENT_TENSE;
-    else if (strcmp(tenseName, "active") == 0)
-        tense = ACTIVE_TENSE;
-    else if (strcmp(tenseName, "passive") == 0)
-        tense = PASSIVE_TENSE;
-    else if (strcmp(tenseName, "imp-active") == 0)
-        tense = IMPERATIVE_ACTIVE_TENSE;
-    else if (strcmp(tenseName, "imp-passive") == 0)
-        tense = IMPERATIVE_PASSIVE_TENSE;
-    else if (strcmp(tenseName, "past-perfect") == 0)
-        tense = PAST_PERFECT;
-
-    if (tense == INVALID_TENSE)
+    string w = trieValue.correctVerbRadical + termination;
+    string key = w + '\0' + trieValue.templateName + '\0' + trieValue.correctVerbRadical;
+    if (!matchKeys.insert(key).second)
+        return;  // also in the other layer
+
+    candidates.push_back(Candidate());
+    candidates.back().typoCost = getTypoCost(word, path);
+    FuzzyMatch &match = candidates.back().match;
+    match.word = w;
+    match.distance = distance;
+    match.group = InflectionGroup(getInfinitive(trieValue.correctVerbRadical,
+                                                trieValue.templateName),
+                                  trieValue.templateName, true);
+    for (vector<ModeTensePersonNumber>::const_iterator k = mtpns.begin();
+                                                       k != mtpns.end(); ++k)
+        if (k->correct)
+            match.group.mtpns.push_back(*k);
+
+    // Once there are enough matches within some distance, the
+    // farther words cannot be among the results.
+    ++numMatchesAt[distance];
+    if (options.maxResults != 0)
     {
-        if (trace) cout << "tenseName='" << tenseName << "'" << endl;
-        assert(!"Invalid tense");
+        size_t n = 0;
+        for (unsigned d = 0; d < bound; ++d)
+        {
+            n += numMatchesAt[d];
+            if (n >= options.maxResults)
+            {
+                bound = d;
+                break;
+            }
+        }
     }
+}
 
-    return tense;
+
+bool
+FrenchVerbDictionary::FuzzySearch::isTimeUp()
+{
+    // Checking the clock at every step would cost more than the step.
+    if (!timeUp && deadline != 0 && (numSteps & 0xFF) == 0 && getTime() >= deadline)
+        timeUp = true;
+    return timeUp;
+}
+
+
+//static
+bool
+FrenchVerbDictionary::FuzzySearch::isBetterCandidate(const Candidate &ca,
+                                                     const Candidate &cb)
+{
+    const FuzzyMatch &a = ca.match, &b = cb.match;
+    if (a.distance != b.distance)
+        return a.distance < b.distance;
+    if (ca.typoCost != cb.typoCost)
+        return ca.typoCost < cb.typoCost;
+    if (a.word != b.word)
+        return a.word < b.word;
+    if (a.group.infinitive != b.group.infinitive)
+        return a.group.infinitive < b.group.infinitive;
+    return a.group.templateName < b.group.templateName;
 }
 
 
 void
-FrenchVerbDictionary::deconjugate(const string &utf8ConjugatedVerb,
-                                std::vector<InflectionDesc> &results)
+FrenchVerbDictionary::FuzzySearch::getMatches(vector<FuzzyMatch> &result) const
 {
-    verbTrie.setDestination(&results);
+    vector<Candidate> sorted = candidates;
+    sort(sorted.begin(), sorted.end(), isBetterCandidate);
+    if (options.maxResults != 0 && sorted.size() > options.maxResults)
+        sorted.resize(options.maxResults);
+
+    result.clear();
+    result.reserve(sorted.size());
+    for (vector<Candidate>::const_iterator it = sorted.begin(); it != sorted.end(); ++it)
+        result.push_back(it->match);
+}
 
-    try
+
+void
+FrenchVerbDictionary::setLookupCache(size_t maxEntries, size_t numShards)
+{
+    delete lookupCache;
+    lookupCache = NULL;
+    if (maxEntries > 0)
     {
-        wstring w = utf8ToWide(utf8ConjugatedVerb);
-        (void) verbTrie.get(w);
+        lookupCache = new LookupCache(maxEntries, numShards);
+        lookupCache->startGeneration(loadShared(userLayerVersion));
     }
-    catch (int e)  // exception throw by utf8towide()
+}
+
+
+bool
+FrenchVerbDictionary::useSuccinctTrie()
+{
+    if (succinctVerbTrie != NULL)
+        return true;
+
+    SuccinctVerbTrie::EntryList entries;
+    verbTrie.getEntries(entries);
+    SuccinctVerbTrie *t = new SuccinctVerbTrie(true);
+    if (!t->build(entries))
     {
-        // Wrong encoding (possibly Latin-1). Act as with unknown verb.
+        delete t;
+        return false;
     }
 
-    verbTrie.setDestination(NULL);
+    // The template lists now belong to the succinct trie.
+    verbTrie.clear(false);
+    succinctVerbTrie = t;
+
+    if (trace)
+        cout << "FrenchVerbDictionary::useSuccinctTrie: "
+             << t->getNumNodes() << " nodes take "
+             << t->computeMemoryConsumption() << " bytes\n";
+    return true;
+}
+
+
+size_t
+FrenchVerbDictionary::computeVerbTrieMemoryConsumption() const
+{
+    if (succinctVerbTrie != NULL)
+        return succinctVerbTrie->computeMemoryConsumption();
+    return verbTrie.computeMemoryConsumption();
+}
+
+
+bool
+FrenchVerbDictionary::getLookupCacheStatistics(LookupCache::Statistics &stats) const
+{
+    if (lookupCache == NULL)
+        return false;
+    stats = lookupCache->getStatistics();
+    return true;
 }
 
 
 /*virtual*/
-void
-FrenchVerbDictionary::VerbTrie::onFoundPrefixWithUserData(
+bool
+FrenchVerbDictionary::InflectionCollector::onFoundPrefixWithUserData(
                         const wstring &conjugatedVerb,
                         wstring::size_type index,
-                        const vector<TrieValue> *templateList) const throw()
+                        const vector<TrieValue> *templateList)
 {
     assert(templateList != NULL);
-    if (trace)
-        wcout << "VerbTrie::onFoundPrefixWithUserData: start: conjugatedVerb='"
-              << conjugatedVerb << "', index=" << index
-              << ", templateList: " << templateList->size()
-              << ", results=" << results << endl;
+    return collectUserMatches(conjugatedVerb, index)
+           && collect(conjugatedVerb, index, *templateList, true)
+           && collectUserMatches(conjugatedVerb, index + 1);
+}
 
-    if (results == NULL)
-        return;
 
-    const wstring term(conjugatedVerb, index);
-    const string utf8Term = fvd.wideToUTF8(term);
+void
+FrenchVerbDictionary::InflectionCollector::searchUserLayer(const wstring &conjugatedVerb)
+{
+    UserMatchRecorder recorder;
+    (void) fvd.userVerbTrie.get(conjugatedVerb, recorder);
+    userMatches.swap(recorder.matches);
+    nextUserMatch = 0;
+    filterBaseLayer = !fvd.removedVerbs.empty();
+}
+
+
+void
+FrenchVerbDictionary::InflectionCollector::finish(const wstring &conjugatedVerb)
+{
+    (void) collectUserMatches(conjugatedVerb, wstring::npos);
+}
+
+
+// Collects the radicals of the user layer that are shorter than
+// 'endIndex' and have not been collected yet.
+//
+bool
+FrenchVerbDictionary::InflectionCollector::collectUserMatches(
+                        const wstring &conjugatedVerb,
+                        wstring::size_type endIndex)
+{
+    for ( ; nextUserMatch < userMatches.size()
+                && userMatches[nextUserMatch].first < endIndex; ++nextUserMatch)
+    {
+        const UserMatch &match = userMatches[nextUserMatch];
+        if (!collect(conjugatedVerb, match.first, *match.second, false))
+            return false;
+    }
+    return !stopped;
+}
+
 
+// Adds the groups of the templates of a radical that accept the rest
+// of the searched string.
+//
+bool
+FrenchVerbDictionary::InflectionCollector::collect(
+                        const wstring &conjugatedVerb,
+                        wstring::size_type index,
+                        const vector<TrieValue> &templateList,
+                        bool baseLayer)
+{
+    if (stopped)
+        return false;
     if (trace)
-        cout << "  utf8Term='" << utf8Term << "'\n";
+        wcout << "InflectionCollector::collect: start: conjugatedVerb='"
+              << conjugatedVerb << "', index=" << index
+              << ", templateList: " << templateList.size() << endl;
+
+    string utf8Term;  // converted when a template needs it
+    bool haveUTF8Term = false;
 
     /*
         'templateList' contains the names of conjugated templates that might
         apply to the conjugated verb.  We check each of them to see if there
         is one that accepts the given termination 'term'.
     */
-    for (vector<TrieValue>::const_iterator i = templateList->begin();
-                                           i != templateList->end(); i++)
+    for (vector<TrieValue>::const_iterator i = templateList.begin();
+                                           i != templateList.end(); i++)
     {
         const TrieValue &trieValue = *i;
+        if (!trieValue.correct && !options.acceptMisspellings)
+            continue;  // radical reached through missing accents
+        if (baseLayer && filterBaseLayer && fvd.isRemovedVerb(trieValue))
+            continue;  // verb hidden by the user layer
+
         const string &tname = trieValue.templateName;
+        if (!haveUTF8Term)
+        {
+            utf8Term = fvd.wideToUTF8(wstring(conjugatedVerb, index));
+            haveUTF8Term = true;
+            if (trace)
+                cout << "  utf8Term='" << utf8Term << "'\n";
+        }
+
         const TemplateInflectionTable &ti =
-                                fvd.inflectionTable.find(tname)->second;
+                                *fvd.findTemplateInflectionTable(tname);
         TemplateInflectionTable::const_iterator j = ti.find(utf8Term);
         if (trace)
             cout << "    tname='" << tname << "'\n";
@@ -946,48 +2651,87 @@ FrenchVerbDictionary::VerbTrie::onFoundPrefixWithUserData(
 
         // template 'tname' accepts 'term', so we produce some results.
 
-        string templateTerm(tname, tname.find(':') + 1);
-            // termination of the infinitive form
-        if (trace)
-            cout << "    templateTerm='" << templateTerm << "'\n";
-
         const vector<ModeTensePersonNumber> &v = j->second;
             // list of mode-tense-person combinations that can correspond
             // to the conjugated verb's termination
 
-        for (vector<ModeTensePersonNumber>::const_iterator k = v.begin();
-                                                    k != v.end(); k++)
+        if (trace)
         {
-            const ModeTensePersonNumber &mtpn = *k;
+            const wstring radical(conjugatedVerb, 0, index);
+            cout << "InflectionCollector::collect: radical='"
+                << fvd.wideToUTF8(radical)
+                << "', tname='" << tname
+                << "', correctVerbRadical='" << trieValue.correctVerbRadical
+                << "', " << v.size() << " mtpn(s)\n";
+        }
 
-            string infinitive = trieValue.correctVerbRadical + templateTerm;
-                // The infinitive of the conjugated verb is formed from its
-                // (correct) radical part and from the termination of the template name.
-                // Correct means with the proper accents. This allows the user
-                // to type "etaler" without the acute accent on the first "e"
-                // and obtain the conjugation for the correct verb, which has
-                // that accent.
+        if (options.acceptsAll())
+        {
+            InflectionGroup &group = getGroup(trieValue);
+                // the InflectionGroup object is an analysis of the
+                // conjugated verb
+            group.mtpns.insert(group.mtpns.end(), v.begin(), v.end());
+            continue;
+        }
 
-            if (trace)
+        // Only create a group if at least one case is accepted.
+        InflectionGroup *group = NULL;
+        for (vector<ModeTensePersonNumber>::const_iterator k = v.begin();
+                                                    k != v.end(); k++)
+        {
+            if (!options.accepts(*k))
+                continue;
+            if (options.maxResults != 0 && numResults == options.maxResults)
             {
-                const wstring radical(conjugatedVerb, 0, index);
-                cout << "VerbTrie::onFoundPrefixWithUserData: radical='"
-                    << fvd.wideToUTF8(radical) << "', templateTerm='" << templateTerm
-                    << "', tname='" << tname
-                    << "', correctVerbRadical='" << trieValue.correctVerbRadical
-                    << "', mtpn=("
-                    << mtpn.mode << ", "
-                    << mtpn.tense << ", "
-                    << (unsigned) mtpn.person << ", "
-                    << mtpn.plural << ", "
-                    << mtpn.correct << ")\n";
+                stopped = true;
+                return false;
             }
-
-            results->push_back(InflectionDesc(infinitive, tname, mtpn));
-                // the InflectionDesc object is an analysis of the
-                // conjugated verb
+            if (group == NULL)
+                group = &getGroup(trieValue);
+            group->mtpns.push_back(*k);
+            ++numResults;
         }
     }
+
+    stopped = (options.maxResults != 0 && numResults >= options.maxResults);
+    return !stopped;
+}
+
+
+InflectionGroup &
+FrenchVerbDictionary::InflectionCollector::getGroup(const TrieValue &trieValue)
+{
+    const string &correctVerbRadical = trieValue.correctVerbRadical;
+    const string &tname = trieValue.templateName;
+
+    // The infinitive of the conjugated verb is formed from its
+    // (correct) radical part and from the termination of the template name.
+    // Correct means with the proper accents. This allows the user
+    // to type "etaler" without the acute accent on the first "e"
+    // and obtain the conjugation for the correct verb, which has
+    // that accent.
+    //
+    string::size_type posColon = tname.find(':');
+    size_t lenTermination = tname.length() - posColon - 1;
+    size_t lenInfinitive = correctVerbRadical.length() + lenTermination;
+
+    for (vector<InflectionGroup>::iterator g = results.begin();
+                                           g != results.end(); ++g)
+        if (g->templateName == tname
+                && g->correctRadical == trieValue.correct
+                && g->infinitive.length() == lenInfinitive
+                && g->infinitive.compare(0, correctVerbRadical.length(),
+                                         correctVerbRadical) == 0)
+            return *g;
+
+    results.push_back(InflectionGroup());
+    InflectionGroup &group = results.back();
+    group.infinitive.reserve(lenInfinitive);
+    group.infinitive.append(correctVerbRadical);
+    group.infinitive.append(tname, posColon + 1, string::npos);
+    group.templateName = tname;
+    group.correctRadical = trieValue.correct;
+    return group;
 }
 
 
@@ -1079,37 +2823,52 @@ FrenchVerbDictionary::isWideVowel(wchar_t c)
 wstring
 FrenchVerbDictionary::utf8ToWide(const string &utf8String) const throw(int)
 {
-    size_t inbytesleft = utf8String.length() + 1;  // number of *bytes* in UTF-8 string
-    size_t outbytesleft = inbytesleft * sizeof(wchar_t);  // oversized for safety
-    char *inbuf = strcpy(new char[inbytesleft], utf8String.c_str());
-    char *outbuf = new char[outbytesleft];
+    // Decoded here rather than with iconv(3), because an iconv_t
+    // descriptor cannot be shared by concurrent lookups.
+    //
+    wstring result;
+    result.reserve(utf8String.length());
 
-    ICONV_CONST char *in = inbuf;
-    char *out = outbuf;
-    size_t initNumOutBytes = outbytesleft;
-    if (iconv(utf8ToWideConv, &in, &inbytesleft, &out, &outbytesleft) == (size_t) -1)
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(utf8String.data());
+    const unsigned char *end = p + utf8String.length();
+    while (p < end)
     {
-        int e = errno;
-        delete [] inbuf;
-        delete [] outbuf;
-        throw e;
-    }
+        unsigned long c = *p++;
+        if (c < 0x80)
+        {
+            result += wchar_t(c);
+            continue;
+        }
 
-    // iconv() has substracted the number of bytes produced
-    // from outbytesleft. This allows the computation of the
-    // number of wide characters in the result (excluding the
-    // terminating null character).
-    // See the iconv(3) man page for details.
-    //
-    const wchar_t *resultPtr = reinterpret_cast<wchar_t *>(outbuf);
-    size_t resultLen = (initNumOutBytes - outbytesleft) / sizeof(wchar_t) - 1;
-    assert(resultPtr[resultLen] == 0);
+        size_t numContBytes;
+        unsigned long min;
+        if ((c & 0xE0) == 0xC0)
+            numContBytes = 1, c &= 0x1F, min = 0x80;
+        else if ((c & 0xF0) == 0xE0)
+            numContBytes = 2, c &= 0x0F, min = 0x800;
+        else if ((c & 0xF8) == 0xF0)
+            numContBytes = 3, c &= 0x07, min = 0x10000;
+        else
+            throw EILSEQ;
+
+        if (size_t(end - p) < numContBytes)
+            throw EINVAL;  // incomplete multibyte sequence
+        for ( ; numContBytes > 0; --numContBytes, ++p)
+        {
+            if ((*p & 0xC0) != 0x80)
+                throw EILSEQ;
+            c = (c << 6) | (*p & 0x3F);
+        }
 
-    wstring result(resultPtr, resultLen);
-    assert(result.length() == resultLen);
+        // Reject overlong forms, surrogates and out-of-range code points,
+        // as well as code points that do not fit in a wchar_t.
+        if (c < min || (c >= 0xD800 && c <= 0xDFFF) || c > 0x10FFFF
+                || (sizeof(wchar_t) < 4 && c > 0xFFFF))
+            throw EILSEQ;
+
+        result += wchar_t(c);
+    }
 
-    delete [] inbuf;
-    delete [] outbuf;
     return result;
 }
 
@@ -1117,24 +2876,38 @@ FrenchVerbDictionary::utf8ToWide(const string &utf8String) const throw(int)
 string
 FrenchVerbDictionary::wideToUTF8(const wstring &wideString) const throw(int)
 {
-    size_t inbytesleft = (wideString.length() + 1) * sizeof(wchar_t);
-    size_t outbytesleft = inbytesleft;  // UTF-8 string takes no more room than wstring
-    char *inbuf = reinterpret_cast<char *>(memcpy(new char[inbytesleft], wideString.data(), inbytesleft));
-    char *outbuf = new char[outbytesleft];
+    string result;
+    result.reserve(wideString.length() + wideString.length() / 4);
 
-    ICONV_CONST char *in = inbuf;
-    char *out = outbuf;
-    if (iconv(wideToUTF8Conv, &in, &inbytesleft, &out, &outbytesleft) == (size_t) -1)
+    for (wstring::size_type len = wideString.length(), i = 0; i < len; i++)
     {
-        int e = errno;
-        delete [] inbuf;
-        delete [] outbuf;
-        throw e;
+        unsigned long c = (unsigned long) wideString[i];
+        if (c < 0x80)
+            result += char(c);
+        else if (c < 0x800)
+        {
+            result += char(0xC0 | (c >> 6));
+            result += char(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000)
+        {
+            if (c >= 0xD800 && c <= 0xDFFF)
+                throw EILSEQ;
+            result += char(0xE0 | (c >> 12));
+            result += char(0x80 | ((c >> 6) & 0x3F));
+            result += char(0x80 | (c & 0x3F));
+        }
+        else if (c <= 0x10FFFF)
+        {
+            result += char(0xF0 | (c >> 18));
+            result += char(0x80 | ((c >> 12) & 0x3F));
+            result += char(0x80 | ((c >> 6) & 0x3F));
+            result += char(0x80 | (c & 0x3F));
+        }
+        else
+            throw EILSEQ;
     }
 
-    string result = outbuf;
-    delete [] inbuf;
-    delete [] outbuf;
     return result;
 }
 
@@ -1249,5 +3022,11 @@ FrenchVerbDictionary::generateTense(const string &radical,
 bool FrenchVerbDictionary::isVerbStartingWithAspirateH(
                                 const std::string &infinitive) const throw()
 {
-    return aspirateHVerbs.find(infinitive) != aspirateHVerbs.end();
+    bool inBaseLayer = (aspirateHVerbs.find(infinitive) != aspirateHVerbs.end());
+    if (!loadShared(hasUserVerbs))
+        return inBaseLayer;
+    AutoRWLock lock(userLayerLock, false);
+    if (userVerbs.find(infinitive) != userVerbs.end())
+        return userAspirateHVerbs.find(infinitive) != userAspirateHVerbs.end();
+    return inBaseLayer;
 }
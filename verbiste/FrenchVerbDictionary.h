@@ -25,11 +25,13 @@
 
 #include <verbiste/c-api.h>
 #include <verbiste/misc-types.h>
-#include <verbiste/Trie.h>
+#include <verbiste/BitmapTrie.h>
+#include <verbiste/LoudsTrie.h>
+#include <verbiste/LookupCache.h>
+#include <verbiste/VerbFormFilter.h>
 
 #include <libxml/xmlmemory.h>
 #include <libxml/parser.h>
-#include <iconv.h>
 
 #include <assert.h>
 #include <stdexcept>
@@ -42,8 +44,20 @@
 namespace verbiste {
 
 
+struct DictionaryImage;
+
+
 /** French verbs and conjugation knowledge base.
     The text processing done by this class is case-sensitive.
+
+    The verbs are kept in two layers.  The base layer holds the verbs
+    of the system dictionary; it is built by the constructor and is not
+    modified afterwards.  The user layer holds the verbs of
+    $HOME/.verbiste/verbs-<lang>.xml and those given to addUserVerbs()
+    and addVerb().  It is small and can change while the dictionary is
+    in use, without rebuilding the base layer.  The lookups search both
+    layers.  A verb of the base layer that removeVerb() removes is
+    hidden by the user layer.
 */
 class FrenchVerbDictionary
 {
@@ -51,6 +65,160 @@ public:
 
     enum Language { NO_LANGUAGE, FRENCH, ITALIAN, GREEK };
 
+    /** Restrictions that deconjugate() applies while it searches.
+        Cases that are rejected by these options are not expanded,
+        so restrictive options make the search cheaper.
+        The default options accept everything.
+    */
+    struct LookupOptions
+    {
+        /** Set of accepted modes: bit (1 << m) is set for each accepted Mode m. */
+        unsigned long modeMask;
+
+        /** Set of accepted tenses: bit (1 << t) is set for each accepted Tense t. */
+        unsigned long tenseMask;
+
+        /** If false, only correct spellings are accepted:
+            the cases found through missing accents, either in the
+            radical (see InflectionGroup::correctRadical) or in the
+            termination (see ModeTensePersonNumber::correct),
+            are rejected.
+        */
+        bool acceptMisspellings;
+
+        /** Maximum number of mode-tense-person combinations to return
+            (zero means no limit).
+        */
+        size_t maxResults;
+
+        /** Language of the expected results.  If it is neither
+            NO_LANGUAGE nor the language of the dictionary,
+            nothing is returned.
+        */
+        Language lang;
+
+        LookupOptions()
+          : modeMask(~0UL),
+            tenseMask(~0UL),
+            acceptMisspellings(true),
+            maxResults(0),
+            lang(NO_LANGUAGE)
+        {
+        }
+
+        /** Returns the bit that represents 'm' in modeMask. */
+        static unsigned long getModeBit(Mode m) { return 1UL << int(m); }
+
+        /** Returns the bit that represents 't' in tenseMask. */
+        static unsigned long getTenseBit(Tense t) { return 1UL << int(t); }
+
+        /** Indicates if these options accept every case. */
+        bool acceptsAll() const
+        {
+            return modeMask == ~0UL && tenseMask == ~0UL
+                   && acceptMisspellings && maxResults == 0
+                   && lang == NO_LANGUAGE;
+        }
+
+        /** Indicates if these options accept the given case. */
+        bool accepts(const ModeTensePersonNumber &mtpn) const
+        {
+            return (modeMask & getModeBit(mtpn.mode)) != 0
+                   && (tenseMask & getTenseBit(mtpn.tense)) != 0
+                   && (acceptMisspellings || mtpn.correct);
+        }
+    };
+
+    /** Restrictions on the words proposed by complete().
+    */
+    struct CompletionOptions
+    {
+        /** Maximum number of words to propose (zero means no limit). */
+        size_t maxResults;
+
+        /** If true, only infinitives are proposed; otherwise, all of
+            the inflected forms, infinitives included.
+        */
+        bool infinitivesOnly;
+
+        /** If true, the prefix also matches the words that have accents
+            where it has none (e.g., "etio" proposes "étions").
+            The dictionary must have been constructed with
+            includeWithoutAccents set to true.
+        */
+        bool ignoreAccents;
+
+        CompletionOptions()
+          : maxResults(10),
+            infinitivesOnly(false),
+            ignoreAccents(false)
+        {
+        }
+    };
+
+    /** Receiver of the words proposed by complete(), as they are found.
+    */
+    class CompletionReceiver
+    {
+    public:
+        virtual ~CompletionReceiver() {}
+
+        /** Called for each proposed word.
+            @param  utf8Word        correctly spelled word, in UTF-8
+                                    (e.g., "étions")
+            @param  utf8Infinitive  infinitive of its verb, in UTF-8
+                                    (e.g., "être")
+            @returns                false to stop the completion
+        */
+        virtual bool onCompletion(const std::string &utf8Word,
+                                  const std::string &utf8Infinitive) = 0;
+    };
+
+    /** Limits of fuzzyDeconjugate().
+    */
+    struct FuzzyOptions
+    {
+        /** Maximum edit distance between the searched word and a result
+            (1 or 2 in practice; the work grows quickly with it).
+        */
+        unsigned maxDistance;
+
+        /** Maximum number of results (zero means no limit).
+            Once enough results are found at some distance, the
+            farther words are no longer searched.
+        */
+        size_t maxResults;
+
+        /** Time after which the search stops and returns what it has
+            found, in microseconds (zero means no limit).
+        */
+        unsigned long maxMicroseconds;
+
+        FuzzyOptions()
+          : maxDistance(2),
+            maxResults(10),
+            maxMicroseconds(0)
+        {
+        }
+    };
+
+    /** Known conjugated verb that is close to the word searched by
+        fuzzyDeconjugate().
+    */
+    struct FuzzyMatch
+    {
+        /** Correctly spelled conjugated verb, in UTF-8 (e.g., "mangeons"). */
+        std::string word;
+
+        /** Edit distance between the searched word and 'word'. */
+        unsigned distance;
+
+        /** Verb, template, and correct inflections of 'word'. */
+        InflectionGroup group;
+
+        FuzzyMatch() : word(), distance(0), group() {}
+    };
+
     /** Returns the language identifier recognized in the given string.
         @param  twoLetterCode           string containing a language code
         @returns                        a member of the 'Language' enum,
@@ -75,6 +243,15 @@ public:
     static void getXMLFilenames(std::string &conjFN, std::string &verbsFN,
                                 Language l);
 
+    /** Indicates if the conjugation templates and verbs of a language
+        have been compiled into the library at build time.
+        @param  l               language identifier
+        @returns                true if the constructor that takes a
+                                language loads the dictionary without
+                                reading the XML files of getXMLFilenames()
+    */
+    static bool hasEmbeddedDictionary(Language l);
+
     /** Load a conjugation database.
         @param    conjugationFilename   filename of the XML document that
                                         defines all the conjugation templates
@@ -84,39 +261,85 @@ public:
         @param    includeWithoutAccents fill knowledge base with variants of
                                         verbs where some or all accents are missing
         @param    lang                  language of the dictionary
+        @param    numLoadingThreads     maximum number of threads used to
+                                        load the documents (0 means one per
+                                        processor); the contents of the
+                                        dictionary do not depend on it
         @throws   logic_error           for invalid arguments,
                                         unparseable or unexpected XML documents
     */
     FrenchVerbDictionary(const std::string &conjugationFilename,
                         const std::string &verbsFilename,
                         bool includeWithoutAccents,
-                        Language lang)
+                        Language lang,
+                        size_t numLoadingThreads = 0)
                                         throw (std::logic_error);
 
     /** Load the French conjugation database.
-        Uses the default (hard-coded) location for the French dictionary's
-        data filenames.
+        Uses the tables compiled into the library if there are some,
+        and otherwise the default (hard-coded) location for the French
+        dictionary's data filenames.
         @param    includeWithoutAccents include in the knowledge base variants
                                         verbs where some or all accents are missing
+        @param    numLoadingThreads     maximum number of threads used to
+                                        load the documents (0 means one per
+                                        processor)
         @throws   logic_error           for invalid filename arguments,
                                         unparseable or unexpected XML documents
                                         (if verbs or template names are
                                         mentioned, they are in Latin-1)
     */
-    FrenchVerbDictionary(bool includeWithoutAccents) throw (std::logic_error);
+    FrenchVerbDictionary(bool includeWithoutAccents,
+                         size_t numLoadingThreads = 0) throw (std::logic_error);
+
+    /** Load the conjugation database of a language.
+        Uses the tables compiled into the library if there are some
+        (see hasEmbeddedDictionary()), which avoids reading and parsing
+        the XML files, and otherwise the XML files at the default
+        location (see getXMLFilenames()).
+        In both cases, the verbs of $HOME/.verbiste/verbs-<lang>.xml,
+        if that file exists, are added to those of the database.
+        @param    lang                  language of the dictionary
+        @param    includeWithoutAccents include in the knowledge base variants
+                                        verbs where some or all accents are missing
+        @param    numLoadingThreads     maximum number of threads used to
+                                        load the documents (0 means one per
+                                        processor)
+        @param    lazyTemplates         with compiled tables, decode each
+                                        conjugation template the first time
+                                        it is needed instead of all of them
+                                        while loading
+        @throws   logic_error           for an invalid language,
+                                        unparseable or unexpected XML documents
+    */
+    FrenchVerbDictionary(Language lang,
+                         bool includeWithoutAccents,
+                         size_t numLoadingThreads = 0,
+                         bool lazyTemplates = true) throw (std::logic_error);
 
     /** Frees the memory used by this dictionary.
     */
     ~FrenchVerbDictionary();
 
     /** Returns a conjugation template specification from its name.
+        Decodes the template if it is decoded on demand and has not
+        been needed yet.  May be called concurrently by several threads.
         @param    templateName  name of the desired template (e.g. "aim:er")
         @returns                a pointer to the TemplateSpec object if found,
-                                or NULL otherwise
+                                or NULL otherwise; it remains valid for
+                                the lifetime of the dictionary
     */
     const TemplateSpec *getTemplate(const std::string &templateName) const;
 
-    /** Returns an iterator for the list of conjugation templates. */
+    /** Returns the number of conjugation templates that have been decoded.
+        Equal to the number of templates unless they are decoded on demand.
+    */
+    size_t getNumDecodedTemplates() const;
+
+    /** Returns an iterator for the list of conjugation templates.
+        Decodes all of the templates if they are decoded on demand.
+        Must not be called while other threads use the dictionary.
+    */
     ConjugationSystem::const_iterator beginConjugSys() const;
 
     /** Returns an iterator for the end of the list of conjugation templates. */
@@ -128,9 +351,12 @@ public:
         @returns                a set of template names of the form radical:termination
                                 in Latin-1 (e.g., "aim:er"),
                                 or an empty set if the verb is unknown
-                                or if 'infinitive' is NULL
+                                or if 'infinitive' is NULL; the set is
+                                a copy, so that addUserVerbs() and
+                                removeVerb() may change the templates
+                                of the verb while the caller uses it
     */
-    const std::set<std::string> &getVerbTemplateSet(const char *infinitive) const;
+    std::set<std::string> getVerbTemplateSet(const char *infinitive) const;
 
     /** Returns the template used by a verb.
         @param    infinitive    infinitive form of the verb in Latin-1
@@ -138,16 +364,78 @@ public:
         @returns                a set of template names of the form radical:termination
                                 in Latin-1 (e.g., "aim:er"),
                                 or an empty set if the verb is unknown
-                                or NULL if the verb is unknown
     */
-    const std::set<std::string> &getVerbTemplateSet(const std::string &infinitive) const;
+    std::set<std::string> getVerbTemplateSet(const std::string &infinitive) const;
 
-    /** Returns an iterator for the list of known verbs. */
+    /** Returns an iterator for the list of known verbs of the base layer. */
     VerbTable::const_iterator beginKnownVerbs() const;
 
-    /** Returns an iterator for the end of the list of known verbs. */
+    /** Returns an iterator for the end of the list of known verbs of the base layer. */
     VerbTable::const_iterator endKnownVerbs() const;
 
+    /** Returns an iterator for the list of verbs of the user layer.
+        A verb that is also in the base layer is listed with all its templates.
+        A verb that has been removed is listed with an empty set.
+        Must not be used while the user layer is being modified.
+    */
+    VerbTable::const_iterator beginUserVerbs() const;
+
+    /** Returns an iterator for the end of the list of verbs of the user layer. */
+    VerbTable::const_iterator endUserVerbs() const;
+
+    /** Adds the verbs of a verbs document to the user layer.
+        Takes time in proportion to the size of the document,
+        not to the size of the dictionary.
+        May be called while other threads use the dictionary: their
+        lookups see either none or all of the verbs of the document.
+        Clears the lookup cache.
+        @param    verbsFilename filename of an XML document in the format
+                                of the verbs document of the language
+        @throws   logic_error   for an unparseable or unexpected document,
+                                or a verb whose template is unknown;
+                                no verb of the document is then added
+    */
+    void addUserVerbs(const std::string &verbsFilename) throw (std::logic_error);
+
+    /** Adds a verb to the user layer, as if it were read from a verbs
+        document given to addUserVerbs().  A verb that is already known
+        receives the template in addition to its other templates.
+        The forms without accents are added if the dictionary was
+        constructed with includeWithoutAccents.
+        Takes time in proportion to the length of the verb and to the
+        number of its forms without accents, and the time of clearing
+        the lookup cache.
+        May be called while other threads use the dictionary.
+        @param    utf8Infinitive infinitive of the verb in UTF-8
+                                (e.g., "bloguer")
+        @param    utf8TName     name of a conjugation template in UTF-8
+                                (e.g., "aim:er")
+        @param    aspirateH     true if the verb starts with an aspirate h
+        @throws   logic_error   for an unknown template, or an infinitive
+                                that does not end with the termination
+                                of the template; nothing is then added
+    */
+    void addVerb(const std::string &utf8Infinitive,
+                 const std::string &utf8TName,
+                 bool aspirateH) throw (std::logic_error);
+
+    /** Removes a verb, with all of its templates and its forms without
+        accents, from the base and user layers.  The radicals that no
+        other verb uses are removed from the trie of the user layer,
+        and its emptied nodes are destroyed.  A verb of the base layer
+        is hidden by the user layer, since the base layer is not modified.
+        Takes time in proportion to the length of the verb and to the
+        number of its templates and of its forms without accents,
+        and the time of clearing the lookup cache.
+        May be called while other threads use the dictionary.
+        @param    utf8Infinitive infinitive of the verb in UTF-8
+        @returns                false if the verb was not known, or if
+                                it does not end with the termination of
+                                each of its templates, as a form without
+                                accents (e.g., "pecher") may not
+    */
+    bool removeVerb(const std::string &utf8Infinitive);
+
 
     /** Describes an inflection according to a given conjugation template.
         If the given inflection is known to the given conjugation template,
@@ -187,6 +475,7 @@ public:
     static Tense convertTenseName(const char *tenseName);
 
     /** Analyzes a conjugated verb and finds all known possible cases.
+        This method may be called concurrently by several threads.
         @param   utf8ConjugatedVerb     conjugated French verb in UTF-8
                                         (e.g., "aimerions")
         @param   results        vector in which to store the inflection
@@ -196,7 +485,138 @@ public:
                                 if the given conjugated verb is unknown
     */
     void deconjugate(const std::string &utf8ConjugatedVerb,
-                            std::vector<InflectionDesc> &results);
+                            std::vector<InflectionDesc> &results) const;
+
+    /** Analyzes a conjugated verb and finds all known possible cases,
+        grouped by verb and conjugation template.
+        Each group names its verb and template once, whereas the
+        other deconjugate() method repeats them for each case.
+        This method may be called concurrently by several threads.
+        @param   utf8ConjugatedVerb     conjugated French verb in UTF-8
+                                        (e.g., "aimerions")
+        @param   results        vector in which to store the groups
+                                (this vector is not emptied before
+                                elements are stored in it);
+                                no elements are stored in this vector
+                                if the given conjugated verb is unknown
+    */
+    void deconjugate(const std::string &utf8ConjugatedVerb,
+                            std::vector<InflectionGroup> &results) const;
+
+    /** Analyzes a conjugated verb and finds the known possible cases
+        that are accepted by the given options, grouped by verb and
+        conjugation template.
+        This method may be called concurrently by several threads.
+        @param   utf8ConjugatedVerb     conjugated French verb in UTF-8
+                                        (e.g., "aimerions")
+        @param   options        restrictions on the returned cases
+        @param   results        vector in which to store the groups
+                                (this vector is not emptied before
+                                elements are stored in it);
+                                no group is empty
+    */
+    void deconjugate(const std::string &utf8ConjugatedVerb,
+                            const LookupOptions &options,
+                            std::vector<InflectionGroup> &results) const;
+
+    /** Quickly tests if a word may be a conjugated verb.
+        deconjugate() makes this test before searching, so a word that
+        is rejected here costs a single pass over its bytes.
+        This method may be called concurrently by several threads.
+        @param   utf8Word       word in UTF-8
+        @returns                false if deconjugate() certainly finds
+                                nothing for 'utf8Word'; true if it may
+                                find something
+    */
+    bool mayBeConjugatedVerb(const std::string &utf8Word) const;
+
+    /** Proposes the known verbs, or their inflected forms, that begin
+        with a prefix, e.g., for an input method.
+        The words are found by radical, in increasing order of the
+        radicals, and the forms of a radical in increasing order of
+        their terminations; the verbs of the user layer come first.
+        Each word is proposed once.  The receiver gets each word as soon
+        as it is found, and the work done is bounded by the maximum
+        number of results, not by the number of words that begin with
+        the prefix.
+        This method may be called concurrently by several threads.
+        @param   utf8Prefix     beginning of the words, in lower-case UTF-8
+        @param   options        restrictions on the proposed words
+        @param   receiver       object that receives the words
+        @returns                the number of proposed words
+    */
+    size_t complete(const std::string &utf8Prefix,
+                    const CompletionOptions &options,
+                    CompletionReceiver &receiver) const;
+
+    /** Proposes the words that begin with a prefix, like the other
+        complete() method.
+        @param   utf8Prefix     beginning of the words, in lower-case UTF-8
+        @param   options        restrictions on the proposed words
+        @param   utf8Words      vector to which the words are appended,
+                                in UTF-8, in the order in which they
+                                are found
+    */
+    void complete(const std::string &utf8Prefix,
+                  const CompletionOptions &options,
+                  std::vector<std::string> &utf8Words) const;
+
+    /** Finds the conjugated verbs that are within a small edit distance
+        of a misspelled word (e.g., "mangons" or "apeller").
+        An insertion, a deletion, a substitution or a transposition of
+        two adjacent letters counts as one edit; letters that only
+        differ by their accents count as equal, as in deconjugate().
+        The trie of the radicals and the terminations of each template
+        are walked together with the rows of the distance table, and
+        the branches that cannot come within the distance are abandoned.
+        The results are sorted by distance; at the same distance, the
+        usual typos (transposed letters, and doubled letters typed once
+        or single letters typed twice) come before the other edits.
+        This method may be called concurrently by several threads.
+        @param   utf8Word       word in lower-case UTF-8
+        @param   options        maximum distance, results and time
+        @param   matches        emptied, then receives the results
+        @returns                false if the time limit stopped the search
+                                before it was complete
+    */
+    bool fuzzyDeconjugate(const std::string &utf8Word,
+                          const FuzzyOptions &options,
+                          std::vector<FuzzyMatch> &matches) const;
+
+    /** Puts a cache of deconjugation results in front of deconjugate().
+        Replaces the current cache, if any.
+        Must not be called while other threads are calling deconjugate().
+        @param  maxEntries      maximum number of cached lookups;
+                                zero disables the cache
+        @param  numShards       number of independently locked parts
+                                of the cache; more shards mean less
+                                contention between threads
+    */
+    void setLookupCache(size_t maxEntries, size_t numShards = 16);
+
+    /** Obtains the counters of the lookup cache.
+        @param  stats           receives the counters
+        @returns                false if no cache has been set with
+                                setLookupCache()
+    */
+    bool getLookupCacheStatistics(LookupCache::Statistics &stats) const;
+
+    /** Replaces the verb trie with a read-only succinct encoding
+        (see LoudsTrie<T>) that takes a fraction of its memory.
+        The lookups give the same results.  The dictionary must not
+        be modified afterwards.
+        Must not be called while other threads are calling deconjugate().
+        @returns                false if the radicals use too many
+                                distinct characters to be encoded,
+                                in which case the verb trie is kept
+    */
+    bool useSuccinctTrie();
+
+    /** Computes and returns the number of memory bytes consumed by
+        the verb trie in use, excluding the template lists.
+        @returns                number of bytes
+    */
+    size_t computeVerbTrieMemoryConsumption() const;
 
     /** Returns the English name (in ASCII) of the given mode.
     */
@@ -220,14 +640,20 @@ public:
     static bool isWideVowel(wchar_t c);
 
     /** Converts a UTF-8 string to a wide character string.
+        This method may be called concurrently by several threads.
         @param      utf8String  UTF-8 string to be converted
         @returns                Unicode string
+        @throws     int         EILSEQ if 'utf8String' is not valid UTF-8,
+                                EINVAL if it ends with an incomplete sequence
     */
     std::wstring utf8ToWide(const std::string &utf8String) const throw(int);
 
     /** Converts a wide character string to a UTF-8 string.
+        This method may be called concurrently by several threads.
         @param      wideString  Unicode string to be converted
         @returns                UTF-8 string
+        @throws     int         EILSEQ if 'wideString' contains an
+                                invalid code point
     */
     std::string wideToUTF8(const std::wstring &wideString) const throw(int);
 
@@ -235,7 +661,7 @@ public:
         @param   utf8String     UTF-8 string with accented characters
         @returns                a UTF-8 string with the accents removed
     */
-    std::string removeUTF8Accents(const std::string &utf8String);
+    std::string removeUTF8Accents(const std::string &utf8String) const;
 
     /** Returns all unaccented variants of a wide character string.
         If N letters are accented in 'utf8String', then 2^N variants
@@ -252,7 +678,7 @@ public:
     */
     void formUTF8UnaccentedVariants(const std::wstring &wideString,
                                         size_t index,
-                                        std::vector<std::string> &utf8Variants);
+                                        std::vector<std::string> &utf8Variants) const;
 
     /** Returns all unaccented variants of a UTF-8 string.
         If N letters are accented in 'utf8String', then 2^N variants
@@ -269,7 +695,7 @@ public:
     */
     void formUTF8UnaccentedVariants(const std::string &utf8String,
                                         size_t index,
-                                        std::vector<std::string> &utf8Variants);
+                                        std::vector<std::string> &utf8Variants) const;
 
 
     /** Returns the content of an XML node in UTF-8.
@@ -364,107 +790,447 @@ private:
     class TrieValue
     {
     public:
-        TrieValue(const std::string &t, const std::string &r)
-        :   templateName(t), correctVerbRadical(r) {}
+        TrieValue(const std::string &t, const std::string &r, bool c)
+        :   templateName(t), correctVerbRadical(r), correct(c) {}
 
         std::string templateName;
         std::string correctVerbRadical;
+        bool correct;  // false if this entry is reached through missing accents
+    };
+
+    /** Verb radical read from a verbs file, with the template
+        that applies to it.  The radicals are stored in the verb trie
+        all at once by buildVerbTrie().
+    */
+    struct RadicalTuple
+    {
+        RadicalTuple(const std::wstring &r, const TrieValue &v)
+        :   radical(r), value(v) {}
+
+        std::wstring radical;
+        TrieValue value;
+    };
+
+    /** XML document parsed by one of the loading tasks of init().
+    */
+    struct DocumentLoad
+    {
+        DocumentLoad(const std::string &f)
+        :   filename(f), doc(NULL), error() {}
+
+        std::string filename;
+        xmlDocPtr doc;  // NULL if not parsed or already read
+        std::string error;  // why the document could not be read, if it could not
+    };
+
+    /** Documents loaded by init(): conjugations first, unless they
+        come from a dictionary image, then verbs.
+    */
+    struct LoadContext
+    {
+        FrenchVerbDictionary *fvd;
+        bool includeWithoutAccents;
+        bool hasConjugationDocument;
+        std::vector<DocumentLoad> documents;
+    };
+
+    /** What readVerbs() reads from a range of consecutive verbs.
+        The chunks are read in parallel, then added to the dictionary
+        in document order.
+    */
+    struct VerbChunk
+    {
+        std::vector< std::pair<std::string, std::string> > knownVerbs;  // (infinitive, template name)
+        std::vector<std::string> aspirateHVerbs;
+        std::vector<RadicalTuple> radicalTuples;
+        std::vector<std::string> utf8Radicals;  // radicals of 'radicalTuples', in UTF-8
+        std::string error;  // message of the error that stopped the reading, if any
+    };
+
+    /** Verbs read by readVerbs(), from a document or from
+        the table of a dictionary image.
+    */
+    struct VerbReading
+    {
+        FrenchVerbDictionary *fvd;
+        xmlDocPtr doc;  // NULL if the verbs come from 'image'
+        const DictionaryImage *image;
+        bool includeWithoutAccents;
+        bool userLayer;  // true if the verbs go to the user layer
+        std::vector<xmlNodePtr> verbNodes;  // <v> nodes of the document
+        size_t numVerbs;
+        std::vector<VerbChunk> chunks;  // chunk k reads a k-th of the verbs
     };
 
     /** Trie that contains all known verb radicals.
         The associated information is a list of template names
         that can apply to the radical.
         The verb radicals and the template names are stored in Latin-1.
+        The bitmap nodes of BitmapTrie take less memory than the rows
+        of Trie, because the languages use few distinct characters.
+    */
+    typedef BitmapTrie< std::vector<TrieValue> > VerbTrie;
+
+    /** Read-only encoding of the verb trie, used after useSuccinctTrie().
+    */
+    typedef LoudsTrie< std::vector<TrieValue> > SuccinctVerbTrie;
+
+    /** Radical of the user layer found in a searched string,
+        with the length of the radical.
+    */
+    typedef std::pair<std::wstring::size_type, const std::vector<TrieValue> *> UserMatch;
+
+    /** Receiver that records the radicals found by a search of
+        the trie of the user layer.
     */
-    class VerbTrie : public Trie< std::vector<TrieValue> >
+    class UserMatchRecorder : public TrieReceiver< std::vector<TrieValue> >
     {
     public:
-        const FrenchVerbDictionary &fvd;
-        std::vector<InflectionDesc> *results;
+        UserMatchRecorder() : matches() {}
 
-        /** Constructs a trie that keeps a reference to the dictionary.
+        virtual bool onFoundPrefixWithUserData(
+                        const std::wstring &/*conjugatedVerb*/,
+                        std::wstring::size_type index,
+                        const std::vector<TrieValue> *templateList)
+        {
+            matches.push_back(UserMatch(index, templateList));
+            return true;
+        }
+
+        std::vector<UserMatch> matches;  // in increasing order of length
+    };
+
+    /** Receiver of the verb radicals found by a search of the verb trie.
+        One is created by each call to deconjugate(), which keeps
+        concurrent calls independent of each other.
+        The radicals of the user layer, if it is searched, are merged
+        with those of the base layer by length, the base layer first,
+        as if both layers were in the same trie.
+    */
+    class InflectionCollector : public TrieReceiver< std::vector<TrieValue> >
+    {
+    public:
+        /** Constructs a collector that stores its results in 'r'.
             @param        d        reference to the verb dictionary
+            @param        o        restrictions on the stored cases
+            @param        r        destination vector designated as the
+                                   repository for results
         */
-        VerbTrie(const FrenchVerbDictionary &d)
-          : Trie< std::vector<TrieValue> >(true),
-            fvd(d),
-            results(NULL)
+        InflectionCollector(const FrenchVerbDictionary &d,
+                            const LookupOptions &o,
+                            std::vector<InflectionGroup> &r)
+          : fvd(d),
+            options(o),
+            results(r),
+            numResults(0),
+            userMatches(),
+            nextUserMatch(0),
+            stopped(false),
+            filterBaseLayer(false)
         {
         }
 
+        /** Searches the user layer for the radicals of a string
+            that is about to be searched in the base layer.
+            The caller must hold the lock of the user layer.
+            @param        conjugatedVerb    the string to be searched
+        */
+        void searchUserLayer(const std::wstring &conjugatedVerb);
+
+        /** Stores the results of the radicals of the user layer that
+            are longer than all of those of the base layer.
+            Must be called after the base layer has been searched.
+            @param        conjugatedVerb    the searched string
+        */
+        void finish(const std::wstring &conjugatedVerb);
+
         /** Callback invoked by the Trie<>::get() method.
-            Inherited from Trie<>.
+            Inherited from TrieReceiver<>.
             This callback will be called for each prefix of the searched
             string that corresponds to the radical of a known verb.
-            Stores data in the vector<InflectionDesc> designated by
-            the last call to setDestination().
+            Adds to the vector<InflectionGroup> given to the constructor
+            one group per template that accepts the rest of the string.
             @param        conjugatedVerb    the searched string
             @param        index             length of the prefix
             @param        templateList      list of conjugation templates that
                                             might apply to the conjugated verb
+            @returns                        false when the maximum number
+                                            of results has been reached
         */
-        virtual void onFoundPrefixWithUserData(
+        virtual bool onFoundPrefixWithUserData(
                         const std::wstring &conjugatedVerb,
                         std::wstring::size_type index,
-                        const std::vector<TrieValue> *templateList) const
-                                                                throw();
-
-        /** Sets the destination vector in which callback() stores results.
-            When the Trie<>::get() method is called on this object,
-            it may invoke the callback() virtual method.
-            callback() will store any results in the vector designated here.
-            After calling get(), iterate through the vector to obtain
-            the possible inflections of the conjugated verb.
-            @param        d        destination vector designated as the
-                                   repository for results (may be NULL)
-        */
-        void setDestination(std::vector<InflectionDesc> *d)
+                        const std::vector<TrieValue> *templateList);
+
+    private:
+        bool collect(const std::wstring &conjugatedVerb,
+                     std::wstring::size_type index,
+                     const std::vector<TrieValue> &templateList,
+                     bool baseLayer);
+        bool collectUserMatches(const std::wstring &conjugatedVerb,
+                                std::wstring::size_type endIndex);
+        InflectionGroup &getGroup(const TrieValue &trieValue);
+
+        const FrenchVerbDictionary &fvd;
+        const LookupOptions &options;
+        std::vector<InflectionGroup> &results;
+        size_t numResults;  // number of MTPNs stored in 'results'
+        std::vector<UserMatch> userMatches;
+        size_t nextUserMatch;  // index in 'userMatches' of the next radical to collect
+        bool stopped;  // true when the maximum number of results has been reached
+        bool filterBaseLayer;  // true if some verbs of the base layer are removed
+
+        // Forbidden operations:
+        InflectionCollector(const InflectionCollector &);
+        InflectionCollector &operator = (const InflectionCollector &);
+    };
+
+    friend class InflectionCollector;
+
+    /** Receiver of the radicals that may begin the words proposed
+        by complete().  It is given the radicals that are prefixes of
+        the searched prefix, then those that begin with it.
+    */
+    class CompletionCollector : public TrieReceiver< std::vector<TrieValue> >
+    {
+    public:
+        CompletionCollector(const FrenchVerbDictionary &d,
+                            const CompletionOptions &o,
+                            CompletionReceiver &r,
+                            const std::wstring &p)
+          : fvd(d),
+            options(o),
+            receiver(r),
+            prefix(p),
+            proposed(),
+            enumerating(false),
+            stopped(false),
+            filterBaseLayer(false)
         {
-            results = d;
         }
 
+        /** Searches the trie of a layer for the radicals.
+            The caller must hold the lock of the user layer, if it
+            searches that layer or if verbs of the base layer are removed.
+            @param  filterRemoved   true to skip the verbs removed from
+                                    the base layer; the caller passes
+                                    the value of hasUserVerbs it has read
+            @returns                false if the completion is over
+        */
+        template <class VerbTrieType>
+        bool search(const VerbTrieType &trie, bool filterRemoved);
+
+        /** Returns the number of proposed words. */
+        size_t getNumProposed() const { return proposed.size(); }
+
+        /** Proposes the words of a radical whose terminations
+            complete the prefix.
+            Inherited from TrieReceiver<>.
+            @returns                        false when the maximum number
+                                            of words has been reached
+        */
+        virtual bool onFoundPrefixWithUserData(
+                        const std::wstring &key,
+                        std::wstring::size_type index,
+                        const std::vector<TrieValue> *templateList);
+
+    private:
+        bool propose(const TrieValue &trieValue, const std::string &termination,
+                     const std::string &utf8Rest);
+
+        const FrenchVerbDictionary &fvd;
+        const CompletionOptions &options;
+        CompletionReceiver &receiver;
+        std::wstring prefix;  // without accents if options.ignoreAccents is true
+        std::set<std::string> proposed;  // words passed to 'receiver'
+        bool enumerating;  // false while the radicals shorter than 'prefix' are searched
+        bool stopped;  // true when the receiver or the limit has stopped the completion
+        bool filterBaseLayer;  // true if some verbs of the searched layer are removed
+
+        // Forbidden operations:
+        CompletionCollector(const CompletionCollector &);
+        CompletionCollector &operator = (const CompletionCollector &);
+    };
+
+    friend class CompletionCollector;
+
+    /** Walker of the trie of a layer for fuzzyDeconjugate().
+        It keeps one row of the (restricted Damerau-Levenshtein)
+        distance table per character of the current path, which acts
+        as a Levenshtein automaton: a subtree is skipped as soon as
+        the smallest value of the last row exceeds the distance.
+    */
+    class FuzzySearch : public TrieWalker< std::vector<TrieValue> >
+    {
+    public:
+        FuzzySearch(const FrenchVerbDictionary &d,
+                    const std::wstring &w,
+                    const FuzzyOptions &o);
+
+        /** Walks the trie of a layer.
+            The caller must hold the lock of the user layer, if it
+            searches that layer or if verbs of the base layer are removed.
+            @param  filterRemoved   true to skip the verbs removed from
+                                    the base layer; the caller passes
+                                    the value of hasUserVerbs it has read
+            @returns                false if the time limit has been reached
+        */
+        template <class VerbTrieType>
+        bool search(const VerbTrieType &trie, bool filterRemoved);
+
+        /** Sorts the results and keeps the best ones. */
+        void getMatches(std::vector<FuzzyMatch> &matches) const;
+
+        /** Inherited from TrieWalker<>. */
+        virtual bool onEnter(wchar_t c);
+        virtual void onLeave();
+        virtual bool onUserData(const std::vector<TrieValue> *templateList);
+
     private:
+        /** Match and its typo cost (see getTypoCost()), which ranks
+            the matches at the same distance.
+        */
+        struct Candidate
+        {
+            FuzzyMatch match;
+            unsigned typoCost;
+        };
+
+        static bool isBetterCandidate(const Candidate &a, const Candidate &b);
+        bool pushChar(wchar_t c);
+        void popChar() { path.erase(path.length() - 1); }
+        unsigned getDistance() const { return rows[path.length() * width + width - 1]; }
+        void matchTerminations(const TrieValue &trieValue);
+        void addMatch(const TrieValue &trieValue, const std::string &termination,
+                      const std::vector<ModeTensePersonNumber> &mtpns,
+                      unsigned distance);
+        bool isTimeUp();
+
+        const FrenchVerbDictionary &fvd;
+        std::wstring word;  // without accents
+        const FuzzyOptions &options;
+        size_t width;  // length of a row of the distance table
+        std::vector<unsigned> rows;  // row i is for the first i characters of 'path'
+        std::wstring path;  // without accents
+        unsigned bound;  // distance beyond which nothing is searched anymore
+        std::vector<size_t> numMatchesAt;  // number of matches at each distance
+        std::vector<std::string::size_type> charEnds;  // ends of the characters of the termination in 'path'
+        std::vector<Candidate> candidates;
+        std::set<std::string> matchKeys;  // word, template name and radical of each match
+        bool filterBaseLayer;  // true if some verbs of the searched layer are removed
+        unsigned long numSteps;
+        double deadline;  // in seconds since the Epoch, or 0
+        bool timeUp;
+
         // Forbidden operations:
-        VerbTrie(const VerbTrie &);
-        VerbTrie &operator = (const VerbTrie &);
+        FuzzySearch(const FuzzySearch &);
+        FuzzySearch &operator = (const FuzzySearch &);
     };
 
-    friend class VerbTrie;
+    friend class FuzzySearch;
 
 private:
 
-    ConjugationSystem conjugSys;
+    // With lazyImage, conjugSys and inflectionTable only contain the
+    // templates decoded so far, and are protected by templateLock.
+    mutable ConjugationSystem conjugSys;
     VerbTable knownVerbs;
     std::set<std::string> aspirateHVerbs;
-    InflectionTable inflectionTable;
-    iconv_t wideToUTF8Conv;
-    iconv_t utf8ToWideConv;
+    mutable InflectionTable inflectionTable;
+    const DictionaryImage *lazyImage;  // image of the templates decoded on demand, or NULL
+    std::vector<size_t> lazyTemplateOrder;  // indices of lazyImage->templates, by name
+    mutable pthread_rwlock_t templateLock;
+    bool withoutAccents;  // includeWithoutAccents argument of the constructor
     char latin1TolowerTable[256];
     VerbTrie verbTrie;
+    std::vector<RadicalTuple> radicalTuples;  // radicals not yet in verbTrie
+    SuccinctVerbTrie *succinctVerbTrie;  // replaces verbTrie if not NULL
+    VerbFormFilter formFilter;  // rejects words that cannot be in verbTrie
     Language lang;
+    LookupCache *lookupCache;  // NULL unless setLookupCache() was called
+
+    // User layer, protected by userLayerLock.  The lookups only take
+    // the lock when hasUserVerbs is true; without it, they read both
+    // flags below with loadShared(), userLayerVersion first.
+    // An entry of userVerbs replaces the one of knownVerbs.
+    VerbTable userVerbs;
+    std::set<std::string> userAspirateHVerbs;
+    VerbTrie userVerbTrie;
+    std::set<std::string> removedVerbs;  // verbs of the base layer removed by removeVerb()
+    mutable pthread_rwlock_t userLayerLock;
+    volatile bool hasUserVerbs;
+    volatile unsigned long userLayerVersion;  // incremented by each change of the user layer
 
 private:
 
     void init(const std::string &conjugationFilename,
                         const std::string &verbsFilename,
-                        bool includeWithoutAccents)
-                                        throw (std::logic_error);
-    void loadConjugationDatabase(const char *conjugationFilename,
-                                bool includeWithoutAccents)
-                                        throw (std::logic_error);
-    void loadVerbDatabase(const char *verbsFilename,
-                        bool includeWithoutAccents)
+                        const DictionaryImage *image,
+                        bool lazyTemplates,
+                        bool includeWithoutAccents,
+                        size_t numLoadingThreads)
                                         throw (std::logic_error);
+    static const DictionaryImage *findDictionaryImage(Language l);
+    static void loadDocument(void *context, size_t index);
     void readConjugation(xmlDocPtr doc,
                         bool includeWithoutAccents) throw(std::logic_error);
+    void readConjugation(const DictionaryImage &image,
+                        bool includeWithoutAccents) throw(std::logic_error);
+    void readImageTemplate(size_t index, const DictionaryImage &image,
+                           bool includeWithoutAccents) const;
+    void indexImageTemplates(const DictionaryImage &image);
+    std::pair<std::vector<size_t>::const_iterator, std::vector<size_t>::const_iterator>
+        findImageTemplates(const std::string &templateName) const;
+    bool hasTemplate(const std::string &templateName) const;
+    bool decodeTemplate(const std::string &templateName) const;
+    const TemplateInflectionTable *findTemplateInflectionTable(
+                                const std::string &templateName) const;
+    void addTemplateInflection(TemplateInflectionTable &ti,
+                               PersonSpec &thePersonSpec,
+                               const char *modeName,
+                               const char *tenseName,
+                               int personCounter,
+                               const std::string &variant,
+                               bool includeWithoutAccents) const;
     static void generateOtherPastParticiple(const char *mascSing,
                                         std::vector<std::string> &dest);
     void readVerbs(xmlDocPtr doc,
-                   bool includeWithoutAccents)
+                   bool includeWithoutAccents,
+                   size_t numThreads,
+                   bool userLayer = false)
+                                throw(std::logic_error);
+    void readVerbs(const DictionaryImage &image,
+                   bool includeWithoutAccents,
+                   size_t numThreads)
+                                throw(std::logic_error);
+    void readVerbChunks(VerbReading &reading, size_t numThreads)
                                 throw(std::logic_error);
-    void insertVerbRadicalInTrie(const std::string &verbRadical,
+    void addUserChunk(const VerbChunk &chunk);
+    void removeUserRadical(const RadicalTuple &tuple);
+    bool isRemovedVerb(const TrieValue &trieValue) const;
+    void userLayerChanged();
+    bool endsLikeTemplate(const std::string &utf8Infinitive,
+                          const std::string &utf8TName) const throw(int);
+    static void readVerbChunk(void *context, size_t index);
+    void readVerbNode(xmlDocPtr doc, xmlNodePtr v,
+                      bool includeWithoutAccents,
+                      VerbChunk &chunk) throw(std::logic_error);
+    void addVerb(const std::string &utf8Infinitive,
+                 const std::string &utf8TName,
+                 bool aspirateH,
+                 bool includeWithoutAccents,
+                 VerbChunk &chunk) throw(std::logic_error);
+    bool findInLookupCache(const std::string &utf8ConjugatedVerb,
+                           const LookupOptions &options,
+                           std::vector<InflectionGroup> &results) const;
+    static void filterResults(const std::vector<InflectionGroup> &groups,
+                              const LookupOptions &options,
+                              std::vector<InflectionGroup> &results);
+    void insertVerbRadicalInTrie(VerbChunk &chunk,
+                                    const std::string &verbRadical,
                                     const std::string &tname,
-                                    const std::string &correctVerbRadical);
+                                    const std::string &correctVerbRadical) const;
+    void buildVerbTrie(size_t numThreads);
 
     // Forbidden operations:
     FrenchVerbDictionary(const FrenchVerbDictionary &x);
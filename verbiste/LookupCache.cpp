@@ -0,0 +1,222 @@
+/*  $Id$
+    LookupCache.cpp - Concurrent cache of deconjugation results
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+#include "LookupCache.h"
+#include "AutoLock.h"
+
+#include <assert.h>
+
+using namespace std;
+using namespace verbiste;
+
+
+LookupCache::Shard::Shard()
+  : index(),
+    entries(),
+    capacity(1),
+    hand(0),
+    bytes(0),
+    hits(0),
+    misses(0),
+    insertions(0),
+    evictions(0)
+{
+    pthread_rwlock_init(&lock, NULL);
+}
+
+
+LookupCache::Shard::~Shard()
+{
+    pthread_rwlock_destroy(&lock);
+}
+
+
+LookupCache::LookupCache(size_t maxEntries, size_t _numShards)
+  : shards(NULL),
+    numShards(_numShards == 0 ? 1 : _numShards),
+    generation(0)
+{
+    shards = new Shard[numShards];
+    size_t perShard = maxEntries / numShards;
+    for (size_t i = 0; i < numShards; ++i)
+    {
+        shards[i].capacity = (perShard == 0 ? 1 : perShard);
+        shards[i].entries.reserve(shards[i].capacity);
+    }
+}
+
+
+LookupCache::~LookupCache()
+{
+    delete [] shards;
+}
+
+
+LookupCache::Shard &
+LookupCache::getShard(const string &key) const
+{
+    // FNV-1a hash of the UTF-8 bytes.
+    unsigned long h = 2166136261UL;
+    for (string::size_type i = 0; i < key.length(); ++i)
+    {
+        h ^= (unsigned char) key[i];
+        h *= 16777619UL;
+    }
+    return shards[h % numShards];
+}
+
+
+//static
+size_t
+LookupCache::computeEntryBytes(const string &key,
+                                const vector<InflectionGroup> &results)
+{
+    size_t sum = sizeof(Entry) + key.capacity()
+                 + sizeof(EntryIndex::value_type) + key.capacity()
+                 + results.capacity() * sizeof(InflectionGroup);
+    for (vector<InflectionGroup>::const_iterator it = results.begin();
+                                                 it != results.end(); ++it)
+        sum += it->infinitive.capacity() + it->templateName.capacity()
+               + it->mtpns.capacity() * sizeof(ModeTensePersonNumber);
+    return sum;
+}
+
+
+bool
+LookupCache::find(const string &key, vector<InflectionGroup> &results)
+{
+    Shard &shard = getShard(key);
+    AutoRWLock autoLock(shard.lock, false);
+
+    EntryIndex::const_iterator it = shard.index.find(key);
+    if (it == shard.index.end())
+    {
+        __sync_fetch_and_add(&shard.misses, 1);
+        return false;
+    }
+
+    Entry &entry = shard.entries[it->second];
+    // Concurrent hits hold the read lock only: the flag is set
+    // atomically, and only if the clock hand has cleared it.
+    if (!entry.referenced)
+        (void) __sync_lock_test_and_set(&entry.referenced, 1);
+    results.insert(results.end(), entry.results.begin(), entry.results.end());
+    __sync_fetch_and_add(&shard.hits, 1);
+    return true;
+}
+
+
+void
+LookupCache::insert(const string &key, const vector<InflectionGroup> &results,
+                    unsigned long resultGeneration)
+{
+    Shard &shard = getShard(key);
+    AutoRWLock autoLock(shard.lock, true);
+
+    // startGeneration() changes 'generation' before it locks this shard:
+    // either the results are refused, or they are inserted before the
+    // shard is cleared.
+    if (resultGeneration != generation)
+        return;
+    if (shard.index.find(key) != shard.index.end())
+        return;  // inserted by another thread since our miss
+
+    size_t slot;
+    if (shard.entries.size() < shard.capacity)
+    {
+        slot = shard.entries.size();
+        shard.entries.push_back(Entry());
+    }
+    else
+    {
+        // Advance the clock hand, giving a second chance to each
+        // entry that has been hit since the hand last passed over it.
+        for (;;)
+        {
+            Entry &e = shard.entries[shard.hand];
+            if (!e.referenced)
+                break;
+            e.referenced = 0;
+            shard.hand = (shard.hand + 1) % shard.entries.size();
+        }
+        slot = shard.hand;
+        shard.hand = (shard.hand + 1) % shard.entries.size();
+
+        Entry &victim = shard.entries[slot];
+        shard.index.erase(victim.key);
+        assert(shard.bytes >= victim.bytes);
+        shard.bytes -= victim.bytes;
+        shard.evictions++;
+    }
+
+    Entry &entry = shard.entries[slot];
+    entry.key = key;
+    entry.results = results;
+    entry.bytes = computeEntryBytes(entry.key, entry.results);
+    entry.referenced = 0;
+    shard.index[key] = slot;
+    shard.bytes += entry.bytes;
+    shard.insertions++;
+}
+
+
+void
+LookupCache::clear()
+{
+    for (size_t i = 0; i < numShards; ++i)
+    {
+        Shard &shard = shards[i];
+        AutoRWLock autoLock(shard.lock, true);
+        shard.index.clear();
+        shard.entries.clear();
+        shard.hand = 0;
+        shard.bytes = 0;
+    }
+}
+
+
+void
+LookupCache::startGeneration(unsigned long newGeneration)
+{
+    generation = newGeneration;
+    __sync_synchronize();
+    clear();
+}
+
+
+LookupCache::Statistics
+LookupCache::getStatistics() const
+{
+    Statistics stats;
+    for (size_t i = 0; i < numShards; ++i)
+    {
+        const Shard &shard = shards[i];
+        AutoRWLock autoLock(shard.lock, false);
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        stats.insertions += shard.insertions;
+        stats.evictions += shard.evictions;
+        stats.entries += shard.entries.size();
+        stats.bytes += shard.bytes;
+    }
+    return stats;
+}
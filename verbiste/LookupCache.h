@@ -0,0 +1,176 @@
+/*  $Id$
+    LookupCache.h - Concurrent cache of deconjugation results
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+#ifndef _H_LookupCache
+#define _H_LookupCache
+
+#include <verbiste/misc-types.h>
+
+#include <pthread.h>
+#include <vector>
+#include <map>
+#include <string>
+
+
+namespace verbiste {
+
+
+/** Sharded, thread-safe cache of deconjugation results.
+    The keys are the UTF-8 strings passed to
+    FrenchVerbDictionary::deconjugate().
+    Each shard is protected by its own read-write lock.  A cache hit only
+    takes the read lock of one shard, so concurrent hits do not block each
+    other.  Eviction uses the CLOCK (second chance) approximation of LRU,
+    which allows a hit to mark its entry as recently used without taking
+    the write lock.
+*/
+class LookupCache
+{
+public:
+
+    /** Counters that describe the activity of the cache. */
+    struct Statistics
+    {
+        unsigned long hits;
+        unsigned long misses;
+        unsigned long insertions;
+        unsigned long evictions;
+        size_t entries;     // number of results currently cached
+        size_t bytes;       // estimated memory used by the cached results
+
+        Statistics()
+          : hits(0), misses(0), insertions(0), evictions(0), entries(0), bytes(0)
+        {
+        }
+
+        /** Returns the ratio of hits to lookups (0 if no lookups). */
+        double getHitRate() const
+        {
+            unsigned long lookups = hits + misses;
+            return lookups == 0 ? 0.0 : double(hits) / lookups;
+        }
+    };
+
+    /** Creates an empty cache.
+        @param  maxEntries      maximum number of cached lookups
+                                (at least one per shard is kept)
+        @param  numShards       number of independently locked shards
+                                (at least 1)
+    */
+    LookupCache(size_t maxEntries, size_t numShards);
+
+    /** Frees the cached results.
+    */
+    ~LookupCache();
+
+    /** Searches the cache.
+        @param  key         UTF-8 string that was deconjugated
+        @param  results     vector to which the cached results are
+                            appended if the key is found
+        @returns            true if the key was found
+    */
+    bool find(const std::string &key, std::vector<InflectionGroup> &results);
+
+    /** Stores the results of a lookup.
+        If the shard of the key is full, the least recently used entry
+        of that shard is evicted.
+        If the key is already present, nothing is done.
+        If 'generation' is not the one given to the last call to
+        startGeneration() (0 before the first one), nothing is done
+        either: the results may have been made obsolete by the change
+        that started the current generation.
+        @param  key         UTF-8 string that was deconjugated
+        @param  results     results of the deconjugation
+        @param  generation  generation of the data that gave the results
+    */
+    void insert(const std::string &key, const std::vector<InflectionGroup> &results,
+                unsigned long generation = 0);
+
+    /** Removes all entries.  The counters are not reset.
+    */
+    void clear();
+
+    /** Removes all entries, and only stores the results of the given
+        generation from then on.  Lookups that use the changed data
+        need not be excluded while this is called: the results that
+        they computed from older data are refused by insert().
+        @param  generation  new generation, e.g., a version number
+    */
+    void startGeneration(unsigned long generation);
+
+    /** Returns a snapshot of the counters of all shards.
+    */
+    Statistics getStatistics() const;
+
+private:
+
+    struct Entry
+    {
+        std::string key;
+        std::vector<InflectionGroup> results;
+        size_t bytes;
+        volatile int referenced;  // set on a hit, cleared by the clock hand
+    };
+
+    typedef std::map<std::string, size_t> EntryIndex;  // key -> slot
+
+    class Shard
+    {
+    public:
+        Shard();
+        ~Shard();
+
+        mutable pthread_rwlock_t lock;
+        EntryIndex index;
+        std::vector<Entry> entries;
+        size_t capacity;
+        size_t hand;  // next slot examined by the clock
+        size_t bytes;
+        volatile unsigned long hits;
+        volatile unsigned long misses;
+        unsigned long insertions;
+        unsigned long evictions;
+
+    private:
+        // Forbidden operations:
+        Shard(const Shard &);
+        Shard &operator = (const Shard &);
+    };
+
+    Shard &getShard(const std::string &key) const;
+    static size_t computeEntryBytes(const std::string &key,
+                                const std::vector<InflectionGroup> &results);
+
+    Shard *shards;
+    size_t numShards;
+    volatile unsigned long generation;  // changed before the shards are cleared
+
+    // Forbidden operations:
+    LookupCache(const LookupCache &);
+    LookupCache &operator = (const LookupCache &);
+};
+
+
+}  // namespace verbiste
+
+
+#endif  /* _H_LookupCache */
@@ -0,0 +1,290 @@
+/*  $Id$
+    LoudsTrie.cpp - Read-only succinct trie (level-order unary degree sequence)
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+#include "LoudsTrie.h"
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+
+
+namespace verbiste {
+
+
+template <class T>
+LoudsTrie<T>::LoudsTrie(bool _userDataFromNew)
+  : louds(),
+    labels(),
+    hasUserData(),
+    values(),
+    alphabet(),
+    userDataFromNew(_userDataFromNew)
+{
+    clear();
+}
+
+
+template <class T>
+LoudsTrie<T>::~LoudsTrie()
+{
+    clear();
+}
+
+
+template <class T>
+void
+LoudsTrie<T>::clear()
+{
+    if (userDataFromNew)
+        for (typename std::vector<T *>::iterator it = values.begin(); it != values.end(); ++it)
+            delete *it;
+
+    louds = BitVector();
+    louds.push_back(true);  // the root is the only child of a virtual super-root
+    louds.push_back(false);
+    louds.push_back(false);  // the root has no children
+    louds.build();
+    labels.clear();
+    hasUserData = BitVector();
+    hasUserData.push_back(false);
+    hasUserData.build();
+    values.clear();
+    alphabet.clear();
+    memset(codeTable, noCode, sizeof(codeTable));
+}
+
+
+template <class T>
+bool
+LoudsTrie<T>::build(const EntryList &sortedEntries)
+{
+    clear();
+
+    // The alphabet is sorted, so that the children of a node,
+    // which are listed by increasing character, are also listed
+    // by increasing code.
+    for (typename EntryList::const_iterator it = sortedEntries.begin();
+                                            it != sortedEntries.end(); ++it)
+        alphabet.insert(alphabet.end(), it->first.begin(), it->first.end());
+    std::sort(alphabet.begin(), alphabet.end());
+    alphabet.erase(std::unique(alphabet.begin(), alphabet.end()), alphabet.end());
+    if (alphabet.size() >= size_t(noCode))
+    {
+        alphabet.clear();
+        return false;
+    }
+    for (size_t code = 0; code < alphabet.size(); ++code)
+        if ((unsigned long) alphabet[code] < (unsigned long) codeTableSize)
+            codeTable[alphabet[code]] = (unsigned char) code;
+
+    // Each node is the range of entries whose keys start with the
+    // node's string.  The nodes are emitted in breadth-first order.
+    louds = BitVector();
+    hasUserData = BitVector();
+    louds.push_back(true);
+    louds.push_back(false);
+    std::deque<BuildRange> queue;
+    BuildRange root = { 0, sortedEntries.size(), 0 };
+    queue.push_back(root);
+    while (!queue.empty())
+    {
+        BuildRange r = queue.front();
+        queue.pop_front();
+
+        // The key equal to the node's string, if any, comes first.
+        bool ends = (r.begin < r.end && sortedEntries[r.begin].first.length() == r.depth);
+        hasUserData.push_back(ends);
+        if (ends)
+        {
+            assert(sortedEntries[r.begin].second != NULL);
+            values.push_back(sortedEntries[r.begin].second);
+            ++r.begin;
+        }
+
+        // One child per distinct character at position 'depth'.
+        for (size_t i = r.begin; i < r.end; )
+        {
+            wchar_t c = sortedEntries[i].first[r.depth];
+            size_t j = i + 1;
+            while (j < r.end && sortedEntries[j].first[r.depth] == c)
+                ++j;
+
+            louds.push_back(true);
+            labels.push_back((unsigned char) getCode(c));
+            BuildRange child = { i, j, r.depth + 1 };
+            queue.push_back(child);
+            i = j;
+        }
+        louds.push_back(false);
+    }
+
+    louds.build();
+    hasUserData.build();
+    std::vector<unsigned char>(labels).swap(labels);  // trim the capacities
+    std::vector<T *>(values).swap(values);
+    std::vector<wchar_t>(alphabet).swap(alphabet);
+    return true;
+}
+
+
+template <class T>
+unsigned
+LoudsTrie<T>::getCode(wchar_t unichar) const
+{
+    if ((unsigned long) unichar < (unsigned long) codeTableSize)
+        return codeTable[unichar];
+
+    typename std::vector<wchar_t>::const_iterator it =
+                    std::lower_bound(alphabet.begin(), alphabet.end(), unichar);
+    if (it == alphabet.end() || *it != unichar)
+        return noCode;
+    return unsigned(it - alphabet.begin());
+}
+
+
+template <class T>
+size_t
+LoudsTrie<T>::findChild(size_t node, wchar_t unichar) const
+{
+    unsigned code = getCode(unichar);
+    if (code == unsigned(noCode))
+        return noNode;
+
+    size_t begin = louds.select0(node + 1) + 1;  // bit of the first child
+    size_t end = louds.nextZero(begin);
+    if (begin == end)
+        return noNode;
+
+    // The child described by the bit at 'begin' is node begin - node - 1,
+    // whose label is at index begin - node - 2.
+    const unsigned char *first = &labels[0] + (begin - node - 2);
+    const unsigned char *last = first + (end - begin);
+    const unsigned char *it = std::lower_bound(first, last, (unsigned char) code);
+    if (it == last || *it != code)
+        return noNode;
+    return (it - &labels[0]) + 1;
+}
+
+
+template <class T>
+T *
+LoudsTrie<T>::get(const std::wstring &key, TrieReceiver<T> &receiver) const
+{
+    size_t node = 0;
+    for (std::wstring::size_type index = 0; ; ++index)
+    {
+        T *userData = getUserData(node);
+        if (userData != NULL && !receiver.onFoundPrefixWithUserData(key, index, userData))
+            return NULL;  // search stopped by the receiver
+
+        if (index == key.length())
+            return userData;
+
+        node = findChild(node, key[index]);
+        if (node == noNode)
+            return NULL;
+    }
+}
+
+
+template <class T>
+bool
+LoudsTrie<T>::getWithPrefix(const std::wstring &prefix, TrieReceiver<T> &receiver) const
+{
+    size_t node = 0;
+    for (std::wstring::size_type index = 0; index < prefix.length(); ++index)
+    {
+        node = findChild(node, prefix[index]);
+        if (node == noNode)
+            return true;
+    }
+
+    std::wstring key = prefix;
+    return enumerateNode(node, key, receiver);
+}
+
+
+// Passes the keys of the subtree of 'node' to the receiver, 'key' being
+// the key of the node.  The children of a node are consecutive and
+// ordered by code, hence by character.
+//
+template <class T>
+bool
+LoudsTrie<T>::enumerateNode(size_t node, std::wstring &key,
+                            TrieReceiver<T> &receiver) const
+{
+    T *userData = getUserData(node);
+    if (userData != NULL && !receiver.onFoundPrefixWithUserData(key, key.length(), userData))
+        return false;
+
+    size_t begin = louds.select0(node + 1) + 1;  // bit of the first child
+    size_t end = louds.nextZero(begin);
+    for (size_t bit = begin; bit < end; ++bit)
+    {
+        size_t child = bit - node - 1;
+        key += alphabet[labels[child - 1]];
+        if (!enumerateNode(child, key, receiver))
+            return false;
+        key.erase(key.length() - 1);
+    }
+    return true;
+}
+
+
+template <class T>
+bool
+LoudsTrie<T>::walkNode(size_t node, TrieWalker<T> &walker) const
+{
+    T *userData = getUserData(node);
+    if (userData != NULL && !walker.onUserData(userData))
+        return false;
+
+    size_t begin = louds.select0(node + 1) + 1;  // bit of the first child
+    size_t end = louds.nextZero(begin);
+    for (size_t bit = begin; bit < end; ++bit)
+    {
+        size_t child = bit - node - 1;
+        if (!walker.onEnter(alphabet[labels[child - 1]]))
+            continue;
+        if (!walkNode(child, walker))
+            return false;
+        walker.onLeave();
+    }
+    return true;
+}
+
+
+template <class T>
+size_t
+LoudsTrie<T>::computeMemoryConsumption() const
+{
+    return sizeof(*this)
+           + louds.computeMemoryConsumption() - sizeof(louds)
+           + labels.capacity()
+           + hasUserData.computeMemoryConsumption() - sizeof(hasUserData)
+           + values.capacity() * sizeof(T *)
+           + alphabet.capacity() * sizeof(wchar_t);
+}
+
+
+}  // namespace verbiste
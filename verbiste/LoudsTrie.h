@@ -0,0 +1,167 @@
+/*  $Id$
+    LoudsTrie.h - Read-only succinct trie (level-order unary degree sequence)
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+#ifndef _H_LoudsTrie
+#define _H_LoudsTrie
+
+#include <verbiste/Trie.h>
+#include <verbiste/BitVector.h>
+
+#include <string>
+#include <vector>
+#include <utility>
+
+
+namespace verbiste {
+
+
+/** Read-only trie encoded in a few bits per node.
+    The nodes are numbered in breadth-first order, the root being 0.
+    The shape of the tree is a LOUDS bit vector: "10", then for each node,
+    one 1 bit per child followed by a 0 bit.  The children of node i are
+    described by the bits that follow the (i + 1)-th 0 bit, and the
+    child described by the bit at position p is node p - i - 1.
+    The character of the edge that leads to each node is stored in one
+    byte, as a code in the sorted alphabet of the keys, so the children
+    of a node can be found by a binary search of consecutive bytes.
+    A second bit vector tells which nodes have user data; its rank
+    gives the index of that data.
+    In all, a node takes about 12 bits, plus a pointer for each node
+    that has user data.
+    @param        T     type of the user data attached to the stored strings
+*/
+template <class T>
+class LoudsTrie
+{
+public:
+
+    /** List of keys and of their user data.
+    */
+    typedef std::vector< std::pair<std::wstring, T *> > EntryList;
+
+    /** Constructs an empty trie.
+        @param        userDataFromNew   determines if the destructor
+                                        must assume that all "user data"
+                                        pointers come from new and must
+                                        thus be destroyed with delete
+    */
+    LoudsTrie(bool userDataFromNew);
+
+    /** Destroys the trie and, if requested, the user data.
+    */
+    ~LoudsTrie();
+
+    /** Encodes the given entries, replacing the current contents.
+        @param  sortedEntries   entries sorted by key, without duplicate keys;
+                                the user data pointers must not be null
+        @returns                false if the keys use more than 255 distinct
+                                characters, in which case the trie is empty
+    */
+    bool build(const EntryList &sortedEntries);
+
+    /** Searches the trie with the given (wide character) key.
+        Invokes receiver.onFoundPrefixWithUserData() for each find.
+        The search stops as soon as the receiver returns false.
+        May be called concurrently by several threads.
+        @param  key         wide character string to search for
+        @param  receiver    object that receives the found prefixes
+        @returns            the user data associated with 'key', or NULL if
+                            nothing was found or if the receiver
+                            stopped the search
+    */
+    T *get(const std::wstring &key, TrieReceiver<T> &receiver) const;
+
+    /** Enumerates the keys that begin with the given prefix, in
+        increasing order of their characters.
+        See Trie<T>::getWithPrefix().
+        @param  prefix      wide character string that begins the keys
+        @param  receiver    object that receives the keys
+        @returns            false if the receiver stopped the enumeration
+    */
+    bool getWithPrefix(const std::wstring &prefix, TrieReceiver<T> &receiver) const;
+
+    /** Walks through the nodes of the trie under the guidance of the walker.
+        See Trie<T>::walk().
+        @param  walker      object that accepts or skips the subtrees
+        @returns            false if the walker stopped the walk
+    */
+    bool walk(TrieWalker<T> &walker) const { return walkNode(0, walker); }
+
+    /** Returns the number of nodes, including the root.
+    */
+    size_t getNumNodes() const { return labels.size() + 1; }
+
+    /** Computes and returns the number of memory bytes consumed by
+        this object, excluding the size of the user data instances.
+        @returns                        number of bytes
+    */
+    size_t computeMemoryConsumption() const;
+
+private:
+
+    enum
+    {
+        codeTableSize = 0x400,  // covers Latin and Greek
+        noCode = 0xFF,
+        noNode = 0  // the root is never a child
+    };
+
+    struct BuildRange  // entries [begin, end) share their first 'depth' characters
+    {
+        size_t begin, end, depth;
+    };
+
+    unsigned getCode(wchar_t unichar) const;
+    size_t findChild(size_t node, wchar_t unichar) const;
+    bool enumerateNode(size_t node, std::wstring &key,
+                       TrieReceiver<T> &receiver) const;
+    bool walkNode(size_t node, TrieWalker<T> &walker) const;
+    T *getUserData(size_t node) const
+    {
+        return hasUserData.get(node) ? values[hasUserData.rank1(node)] : NULL;
+    }
+    void clear();
+
+
+    BitVector louds;
+    std::vector<unsigned char> labels;  // labels[k - 1] is the code of the edge to node k
+    BitVector hasUserData;  // bit k is set if node k has user data
+    std::vector<T *> values;  // user data of the nodes that have some
+    std::vector<wchar_t> alphabet;  // character of each code, in increasing order
+    unsigned char codeTable[codeTableSize];  // code of each character, or noCode
+    bool userDataFromNew;
+
+
+    // Forbidden operations:
+    LoudsTrie(const LoudsTrie &);
+    LoudsTrie &operator = (const LoudsTrie &);
+
+};
+
+
+}  // namespace verbiste
+
+
+#include "LoudsTrie.cpp"
+
+
+#endif  /* _H_LoudsTrie */
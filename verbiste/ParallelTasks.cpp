@@ -0,0 +1,113 @@
+/*  $Id$
+    ParallelTasks.cpp - Runs independent tasks on worker threads
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+#include "ParallelTasks.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+using namespace verbiste;
+
+
+// State shared by the threads of one call to runParallelTasks().
+//
+struct TaskQueue
+{
+    ParallelTask task;
+    void *context;
+    size_t numTasks;
+    size_t nextTask;  // index of the next task to run, protected by 'mutex'
+    pthread_mutex_t mutex;
+};
+
+
+static void *
+runQueuedTasks(void *arg)
+{
+    TaskQueue &queue = *static_cast<TaskQueue *>(arg);
+    for (;;)
+    {
+        pthread_mutex_lock(&queue.mutex);
+        size_t index = queue.nextTask;
+        if (index < queue.numTasks)
+            ++queue.nextTask;
+        pthread_mutex_unlock(&queue.mutex);
+
+        if (index >= queue.numTasks)
+            return NULL;
+        queue.task(queue.context, index);
+    }
+}
+
+
+namespace verbiste {
+
+
+void
+runParallelTasks(size_t numTasks, size_t numThreads,
+                 ParallelTask task, void *context)
+{
+    if (numThreads > numTasks)
+        numThreads = numTasks;
+    if (numThreads <= 1)
+    {
+        for (size_t i = 0; i < numTasks; ++i)
+            task(context, i);
+        return;
+    }
+
+    TaskQueue queue;
+    queue.task = task;
+    queue.context = context;
+    queue.numTasks = numTasks;
+    queue.nextTask = 0;
+    pthread_mutex_init(&queue.mutex, NULL);
+
+    vector<pthread_t> threads;
+    threads.reserve(numThreads - 1);
+    for (size_t i = 1; i < numThreads; ++i)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, runQueuedTasks, &queue) != 0)
+            break;  // the threads already created take the remaining tasks
+        threads.push_back(thread);
+    }
+
+    runQueuedTasks(&queue);
+
+    for (vector<pthread_t>::iterator it = threads.begin(); it != threads.end(); ++it)
+        pthread_join(*it, NULL);
+    pthread_mutex_destroy(&queue.mutex);
+}
+
+
+size_t
+getNumProcessors()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n >= 1 ? size_t(n) : 1;
+}
+
+
+}  // namespace verbiste
@@ -0,0 +1,65 @@
+/*  $Id$
+    ParallelTasks.h - Runs independent tasks on worker threads
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+#ifndef _H_ParallelTasks
+#define _H_ParallelTasks
+
+#include <stddef.h>
+
+
+namespace verbiste {
+
+
+/** Function that runs one task.
+    @param  context     pointer passed to runParallelTasks()
+    @param  index       index of the task, from 0 to the number of tasks - 1
+*/
+typedef void (*ParallelTask)(void *context, size_t index);
+
+
+/** Runs a number of independent tasks on up to 'numThreads' threads,
+    the calling thread being one of them, and returns when they are done.
+    Each thread takes the next task that no thread has taken yet, so the
+    order in which the tasks run is unspecified: a task must only write
+    to data that belongs to its index.
+    The tasks must not throw exceptions; a task that can fail must
+    record its error in the context.
+    If a thread cannot be created, its tasks are run by the others.
+    @param  numTasks    number of tasks
+    @param  numThreads  maximum number of threads; 0 or 1 runs the
+                        tasks in order on the calling thread
+    @param  task        function called once for each task index
+    @param  context     pointer passed to each call of 'task'
+*/
+void runParallelTasks(size_t numTasks, size_t numThreads,
+                      ParallelTask task, void *context);
+
+
+/** Returns the number of processors that are online (at least 1).
+*/
+size_t getNumProcessors();
+
+
+}  // namespace verbiste
+
+
+#endif  /* _H_ParallelTasks */
@@ -0,0 +1,523 @@
+/*  $Id$
+    ReloadableDictionary.cpp - Dictionary that is reloaded when its files change
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+#include "ReloadableDictionary.h"
+#include "AutoLock.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+using namespace std;
+using namespace verbiste;
+
+
+// Time during which the watched files must not change before they
+// are reloaded, in milliseconds.
+static const long settleDelay = 200;
+
+// Interval at which the watched files are checked when inotify(7)
+// is not available, in milliseconds.
+static const long pollInterval = 1000;
+
+
+// What the watcher knows of a file: a change in any field
+// means that the file has been written, replaced, created or removed.
+// The modification time has the resolution of the file system, so that
+// a rewrite of the same size within the same second is seen where the
+// file system records nanoseconds.
+//
+struct FileState
+{
+    bool exists;
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    time_t modificationTime;
+    long modificationNanoseconds;
+
+    FileState(const string &filename)
+      : exists(false), device(0), inode(0), size(0), modificationTime(0),
+        modificationNanoseconds(0)
+    {
+        struct stat statbuf;
+        if (stat(filename.c_str(), &statbuf) != 0)
+            return;
+        exists = true;
+        device = statbuf.st_dev;
+        inode = statbuf.st_ino;
+        size = statbuf.st_size;
+        modificationTime = statbuf.st_mtime;
+        #ifdef __linux__
+        modificationNanoseconds = statbuf.st_mtim.tv_nsec;
+        #endif
+    }
+
+    bool operator == (const FileState &s) const
+    {
+        return exists == s.exists && device == s.device && inode == s.inode
+               && size == s.size && modificationTime == s.modificationTime
+               && modificationNanoseconds == s.modificationNanoseconds;
+    }
+};
+
+
+static void
+getFileStates(const vector<string> &filenames, vector<FileState> &states)
+{
+    states.clear();
+    for (vector<string>::const_iterator it = filenames.begin(); it != filenames.end(); ++it)
+        states.push_back(FileState(*it));
+}
+
+
+// Returns the current time in milliseconds.
+//
+static long long
+getMilliseconds()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (long long) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+
+static string
+getDirectory(const string &filename)
+{
+    string::size_type slash = filename.rfind('/');
+    if (slash == string::npos)
+        return ".";
+    if (slash == 0)
+        return "/";
+    return string(filename, 0, slash);
+}
+
+
+static string
+getBaseName(const string &filename)
+{
+    string::size_type slash = filename.rfind('/');
+    if (slash == string::npos)
+        return filename;
+    return string(filename, slash + 1);
+}
+
+
+#ifdef __linux__
+
+// Indicates if inotify(7) events concern one of the watched files,
+// whose directories are watched as 'directories' (indexed by watch
+// descriptor).  A lost event may have concerned any of them.
+// The stat(2) fields do not tell every rewrite apart, e.g., one of the
+// same size in the same second on a file system without nanoseconds.
+//
+static bool
+isAboutWatchedFile(const char *events, ssize_t length,
+                   const map<int, string> &directories,
+                   const vector<string> &watchedFiles)
+{
+    ssize_t offset = 0;
+    while (offset + ssize_t(sizeof(struct inotify_event)) <= length)
+    {
+        const struct inotify_event *event =
+                    reinterpret_cast<const struct inotify_event *>(events + offset);
+        offset += sizeof(struct inotify_event) + event->len;
+        if (event->mask & IN_Q_OVERFLOW)
+            return true;
+        if (event->len == 0)
+            continue;
+        map<int, string>::const_iterator dir = directories.find(event->wd);
+        if (dir == directories.end())
+            continue;
+        for (vector<string>::const_iterator it = watchedFiles.begin();
+                                            it != watchedFiles.end(); ++it)
+            if (getDirectory(*it) == dir->second && getBaseName(*it) == event->name)
+                return true;
+    }
+    return false;
+}
+
+#endif
+
+
+ReloadableDictionary::ReadGuard::ReadGuard(const ReloadableDictionary &d)
+{
+    // The counter is incremented before 'current' is read, so that
+    // waitForReaders() sees this guard if it may designate an old version.
+    counter = &d.readerCounters[d.epoch & 1][getReaderSlot()].count;
+    __sync_fetch_and_add(counter, 1);
+    const Version *v = d.current;
+    fvd = v->fvd;
+    version = v->number;
+}
+
+
+ReloadableDictionary::ReadGuard::~ReadGuard()
+{
+    __sync_fetch_and_sub(counter, 1);
+}
+
+
+ReloadableDictionary::ReloadableDictionary(FrenchVerbDictionary::Language _lang,
+                                           bool _includeWithoutAccents)
+                                                throw (logic_error)
+  : lang(_lang),
+    includeWithoutAccents(_includeWithoutAccents),
+    fromFiles(false),
+    conjugationFilename(),
+    verbsFilename(),
+    watchedFiles()
+{
+    FrenchVerbDictionary::getXMLFilenames(conjugationFilename, verbsFilename, lang);
+    init(load());
+}
+
+
+ReloadableDictionary::ReloadableDictionary(const string &_conjugationFilename,
+                                           const string &_verbsFilename,
+                                           bool _includeWithoutAccents,
+                                           FrenchVerbDictionary::Language _lang)
+                                                throw (logic_error)
+  : lang(_lang),
+    includeWithoutAccents(_includeWithoutAccents),
+    fromFiles(true),
+    conjugationFilename(_conjugationFilename),
+    verbsFilename(_verbsFilename),
+    watchedFiles()
+{
+    init(load());
+}
+
+
+void
+ReloadableDictionary::init(FrenchVerbDictionary *first)
+{
+    if (fromFiles || !FrenchVerbDictionary::hasEmbeddedDictionary(lang))
+    {
+        watchedFiles.push_back(conjugationFilename);
+        watchedFiles.push_back(verbsFilename);
+    }
+    const char *home = getenv("HOME");
+    if (home != NULL)
+        watchedFiles.push_back(string(home) + "/.verbiste/verbs-"
+                               + FrenchVerbDictionary::getLanguageCode(lang) + ".xml");
+
+    current = new Version(first, 1);
+    epoch = 0;
+    memset(readerCounters, 0, sizeof(readerCounters));
+    pthread_mutex_init(&reloadMutex, NULL);
+    pthread_mutex_init(&errorMutex, NULL);
+    pthread_mutex_init(&watcherMutex, NULL);
+    pthread_cond_init(&watcherReadyCond, NULL);
+    watching = false;
+    watcherReady = false;
+    stopPipe[0] = stopPipe[1] = -1;
+}
+
+
+ReloadableDictionary::~ReloadableDictionary()
+{
+    stopWatching();
+    delete current->fvd;
+    delete current;
+    pthread_cond_destroy(&watcherReadyCond);
+    pthread_mutex_destroy(&watcherMutex);
+    pthread_mutex_destroy(&errorMutex);
+    pthread_mutex_destroy(&reloadMutex);
+}
+
+
+FrenchVerbDictionary *
+ReloadableDictionary::load() const throw (logic_error)
+{
+    if (fromFiles)
+        return new FrenchVerbDictionary(conjugationFilename, verbsFilename,
+                                        includeWithoutAccents, lang);
+    return new FrenchVerbDictionary(lang, includeWithoutAccents);
+}
+
+
+bool
+ReloadableDictionary::reload()
+{
+    AutoMutex lock(reloadMutex);
+    FrenchVerbDictionary *fvd;
+    try
+    {
+        fvd = load();
+    }
+    catch (const logic_error &e)
+    {
+        AutoMutex errorLock(errorMutex);
+        lastReloadError = e.what();
+        return false;
+    }
+    publish(fvd);
+    return true;
+}
+
+
+// Makes 'fvd' the current version and destroys the previous one
+// once no guard designates it.
+//
+void
+ReloadableDictionary::publish(FrenchVerbDictionary *fvd)
+{
+    Version *old = current;
+    Version *v = new Version(fvd, old->number + 1);
+    __sync_synchronize();  // the new version is complete before it is visible
+    current = v;
+    waitForReaders();
+    delete old->fvd;
+    delete old;
+}
+
+
+// Waits until the guards that existed when this function was called
+// have been destroyed.  The guards created afterwards designate the
+// version that is current at the time of the call, or a newer one.
+//
+void
+ReloadableDictionary::waitForReaders()
+{
+    // The epoch is advanced twice, because a guard may read the epoch
+    // just before the first advance and increment its counter only
+    // after the wait that follows it.  Such a guard has read 'current'
+    // after the store done by publish(), and the second wait sees it.
+    for (int phase = 0; phase < 2; ++phase)
+    {
+        __sync_synchronize();
+        unsigned long parity = epoch & 1;
+        epoch = epoch + 1;
+        __sync_synchronize();
+
+        for (;;)
+        {
+            long numGuards = 0;
+            for (size_t i = 0; i < NUM_READER_SLOTS; ++i)
+                numGuards += readerCounters[parity][i].count;
+            if (numGuards == 0)
+                break;
+            sched_yield();
+        }
+        __sync_synchronize();
+    }
+}
+
+
+// Returns the index of the reader counter of the calling thread.
+// The threads are spread over the slots by a hash of their identifier,
+// so that concurrent guards seldom write to the same cache line.
+//
+//static
+size_t
+ReloadableDictionary::getReaderSlot()
+{
+    pthread_t self = pthread_self();
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&self);
+    unsigned long h = 2166136261UL;  // FNV-1a
+    for (size_t i = 0; i < sizeof(self); ++i)
+    {
+        h ^= bytes[i];
+        h *= 16777619UL;
+    }
+    return h % NUM_READER_SLOTS;
+}
+
+
+unsigned long
+ReloadableDictionary::getVersion() const
+{
+    ReadGuard guard(*this);
+    return guard.getVersion();
+}
+
+
+string
+ReloadableDictionary::getLastReloadError() const
+{
+    AutoMutex lock(errorMutex);
+    return lastReloadError;
+}
+
+
+bool
+ReloadableDictionary::startWatching()
+{
+    if (watching)
+        return true;
+    if (pipe(stopPipe) != 0)
+        return false;
+    watcherReady = false;
+    if (pthread_create(&watcherThread, NULL, runWatcher, this) != 0)
+    {
+        close(stopPipe[0]);
+        close(stopPipe[1]);
+        stopPipe[0] = stopPipe[1] = -1;
+        return false;
+    }
+    watching = true;
+
+    // Until the thread has recorded the states of the files, a change
+    // would be taken for their initial state.
+    AutoMutex lock(watcherMutex);
+    while (!watcherReady)
+        pthread_cond_wait(&watcherReadyCond, &watcherMutex);
+    return true;
+}
+
+
+void
+ReloadableDictionary::stopWatching()
+{
+    if (!watching)
+        return;
+    char c = 0;
+    while (write(stopPipe[1], &c, 1) < 0 && errno == EINTR)
+        ;
+    pthread_join(watcherThread, NULL);
+    close(stopPipe[0]);
+    close(stopPipe[1]);
+    stopPipe[0] = stopPipe[1] = -1;
+    watching = false;
+}
+
+
+//static
+void *
+ReloadableDictionary::runWatcher(void *arg)
+{
+    static_cast<ReloadableDictionary *>(arg)->watch();
+    return NULL;
+}
+
+
+// Body of the watcher thread.  inotify(7) only tells that something
+// happened in the directory of a watched file; the states of the files
+// tell if one of them has changed.  The states are also checked
+// periodically when inotify is not available, or when a directory
+// cannot be watched (e.g., no $HOME/.verbiste directory yet).
+//
+void
+ReloadableDictionary::watch()
+{
+    int notifyFD = -1;
+    bool mustPoll = true;
+    #ifdef __linux__
+    map<int, string> watchedDirectories;  // indexed by watch descriptor
+    notifyFD = inotify_init();
+    if (notifyFD >= 0)
+    {
+        set<string> directories;
+        for (vector<string>::const_iterator it = watchedFiles.begin();
+                                            it != watchedFiles.end(); ++it)
+            directories.insert(getDirectory(*it));
+
+        const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM
+                              | IN_CREATE | IN_DELETE | IN_ATTRIB;
+        mustPoll = false;
+        for (set<string>::const_iterator it = directories.begin();
+                                         it != directories.end(); ++it)
+        {
+            int wd = inotify_add_watch(notifyFD, it->c_str(), mask);
+            if (wd < 0)
+                mustPoll = true;
+            else
+                watchedDirectories[wd] = *it;
+        }
+    }
+    #endif
+
+    vector<FileState> states;
+    getFileStates(watchedFiles, states);
+    {
+        AutoMutex lock(watcherMutex);
+        watcherReady = true;
+        pthread_cond_signal(&watcherReadyCond);
+    }
+    bool changed = false;  // true if a change has not been reloaded yet
+    long long changeTime = 0;
+
+    for (;;)
+    {
+        int timeout;
+        if (changed)
+            timeout = int(max(changeTime + settleDelay - getMilliseconds(), 0LL));
+        else
+            timeout = (mustPoll ? int(pollInterval) : -1);
+
+        struct pollfd fds[2];
+        fds[0].fd = stopPipe[0];
+        fds[0].events = POLLIN;
+        fds[1].fd = notifyFD;
+        fds[1].events = POLLIN;
+        int n = poll(fds, notifyFD >= 0 ? 2 : 1, timeout);
+        if (n < 0 && errno != EINTR)
+            break;
+        if (n > 0 && fds[0].revents != 0)
+            break;  // stopWatching() has been called
+
+        bool notified = false;  // true if an event names a watched file
+        #ifdef __linux__
+        if (notifyFD >= 0 && n > 0 && fds[1].revents != 0)
+        {
+            char events[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+            ssize_t length = read(notifyFD, events, sizeof(events));
+            if (length < 0 && errno != EINTR)
+                break;
+            notified = isAboutWatchedFile(events, length, watchedDirectories, watchedFiles);
+        }
+        #endif
+
+        vector<FileState> newStates;
+        getFileStates(watchedFiles, newStates);
+        if (notified || newStates != states)
+        {
+            states.swap(newStates);
+            changed = true;
+            changeTime = getMilliseconds();
+        }
+        else if (changed && getMilliseconds() >= changeTime + settleDelay)
+        {
+            changed = false;
+            (void) reload();  // a failure keeps the current version
+        }
+    }
+
+    if (notifyFD >= 0)
+        close(notifyFD);
+}
@@ -0,0 +1,212 @@
+/*  $Id$
+    ReloadableDictionary.h - Dictionary that is reloaded when its files change
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+#ifndef _H_ReloadableDictionary
+#define _H_ReloadableDictionary
+
+#include <verbiste/FrenchVerbDictionary.h>
+
+#include <pthread.h>
+#include <stdexcept>
+#include <vector>
+#include <string>
+
+
+namespace verbiste {
+
+
+/** FrenchVerbDictionary that can be replaced by a new version, built
+    from its files again, while other threads are using it.
+    The files can be watched by a background thread, which reloads the
+    dictionary when one of them changes (with inotify(7) on Linux, and
+    by checking the modification times elsewhere).
+
+    Readers access the current version through a ReadGuard, which never
+    blocks: a new version is published with a single pointer store, and
+    the old one is destroyed once all of the guards that may designate
+    it have been destroyed (read-copy-update).  Each guard costs two
+    atomic increments of a counter that is shared by few threads.
+*/
+class ReloadableDictionary
+{
+public:
+
+    /** Access to the current version of the dictionary.
+        The version designated by a guard stays valid, and unchanged,
+        until the guard is destroyed, even if a reload publishes a newer
+        version in the meantime.  A guard must be destroyed by the
+        thread that created it, and should not be kept longer than
+        a lookup, because it delays the destruction of old versions.
+    */
+    class ReadGuard
+    {
+    public:
+        /** Designates the current version of 'd'.  Does not block. */
+        ReadGuard(const ReloadableDictionary &d);
+
+        /** Releases the version. */
+        ~ReadGuard();
+
+        const FrenchVerbDictionary &operator * () const { return *fvd; }
+        const FrenchVerbDictionary *operator -> () const { return fvd; }
+
+        /** Returns the number of the designated version (see getVersion()). */
+        unsigned long getVersion() const { return version; }
+
+    private:
+        volatile long *counter;  // counter incremented by the constructor
+        const FrenchVerbDictionary *fvd;
+        unsigned long version;
+
+        // Forbidden operations:
+        ReadGuard(const ReadGuard &);
+        ReadGuard &operator = (const ReadGuard &);
+    };
+
+    /** Loads the conjugation database of a language, as the
+        FrenchVerbDictionary constructor that takes a language does.
+        If the dictionary of the language is compiled into the library,
+        only $HOME/.verbiste/verbs-<lang>.xml is watched, since the other
+        files are not read.
+        @param    lang                  language of the dictionary
+        @param    includeWithoutAccents see FrenchVerbDictionary
+        @throws   logic_error           if the first version cannot be loaded
+    */
+    ReloadableDictionary(FrenchVerbDictionary::Language lang,
+                         bool includeWithoutAccents) throw (std::logic_error);
+
+    /** Loads a conjugation database from the given files, as the
+        FrenchVerbDictionary constructor that takes filenames does.
+        These files, and $HOME/.verbiste/verbs-<lang>.xml, are watched.
+        @throws   logic_error           if the first version cannot be loaded
+    */
+    ReloadableDictionary(const std::string &conjugationFilename,
+                         const std::string &verbsFilename,
+                         bool includeWithoutAccents,
+                         FrenchVerbDictionary::Language lang) throw (std::logic_error);
+
+    /** Stops watching the files and destroys the current version.
+        No ReadGuard may exist anymore.
+    */
+    ~ReloadableDictionary();
+
+    /** Builds a new version from the files and publishes it.
+        Returns once the previous version has been destroyed, which
+        waits for the guards that designate it.  Reloads are serialized.
+        May be called by any thread except one that holds a ReadGuard.
+        @returns                false if the new version could not be
+                                loaded (see getLastReloadError()), in which
+                                case the current version is kept
+    */
+    bool reload();
+
+    /** Starts a thread that reloads the dictionary when one of the
+        watched files is written, replaced, created or removed.
+        A burst of changes (e.g., an editor that saves in several steps)
+        gives one reload, after the files have been quiet for a moment.
+        Returns once the thread watches the files, so that a change
+        made after this call is not missed.
+        @returns                false if the thread could not be started
+    */
+    bool startWatching();
+
+    /** Stops the thread started by startWatching(), if any.
+        A reload in progress is completed first.
+        startWatching() and stopWatching() must not be called
+        concurrently.
+    */
+    void stopWatching();
+
+    /** Returns the number of the current version: 1 for the version
+        loaded by the constructor, then one more for each published reload.
+    */
+    unsigned long getVersion() const;
+
+    /** Returns the message of the error of the last reload that failed,
+        or an empty string if no reload has failed.
+    */
+    std::string getLastReloadError() const;
+
+    /** Returns the names of the watched files. */
+    const std::vector<std::string> &getWatchedFiles() const { return watchedFiles; }
+
+private:
+
+    /** Version of the dictionary, with its number. */
+    struct Version
+    {
+        Version(FrenchVerbDictionary *f, unsigned long n) : fvd(f), number(n) {}
+
+        FrenchVerbDictionary *fvd;
+        unsigned long number;
+    };
+
+    /** Count of the guards created by some of the threads during
+        one parity of the epoch, alone in its cache line.
+    */
+    struct ReaderCounter
+    {
+        volatile long count;
+        char padding[64 - sizeof(long)];
+    };
+
+    enum { NUM_READER_SLOTS = 16 };
+
+    void init(FrenchVerbDictionary *first);
+    FrenchVerbDictionary *load() const throw (std::logic_error);
+    void publish(FrenchVerbDictionary *fvd);
+    void waitForReaders();
+    static size_t getReaderSlot();
+    static void *runWatcher(void *arg);
+    void watch();
+
+    FrenchVerbDictionary::Language lang;
+    bool includeWithoutAccents;
+    bool fromFiles;  // true if built by the constructor that takes filenames
+    std::string conjugationFilename;
+    std::string verbsFilename;
+    std::vector<std::string> watchedFiles;
+
+    Version * volatile current;
+    volatile unsigned long epoch;  // its parity selects the counters of the new guards
+    mutable ReaderCounter readerCounters[2][NUM_READER_SLOTS];
+
+    pthread_mutex_t reloadMutex;  // serializes reload()
+    mutable pthread_mutex_t errorMutex;  // protects lastReloadError
+    std::string lastReloadError;
+    bool watching;  // true if watcherThread runs
+    pthread_t watcherThread;
+    pthread_mutex_t watcherMutex;  // protects watcherReady
+    pthread_cond_t watcherReadyCond;  // signaled when watcherReady becomes true
+    bool watcherReady;  // true once watcherThread has recorded the file states
+    int stopPipe[2];  // written by stopWatching() to wake up watcherThread
+
+    // Forbidden operations:
+    ReloadableDictionary(const ReloadableDictionary &);
+    ReloadableDictionary &operator = (const ReloadableDictionary &);
+};
+
+
+}  // namespace verbiste
+
+
+#endif  /* _H_ReloadableDictionary */
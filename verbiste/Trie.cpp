@@ -25,6 +25,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <list>
+#include <algorithm>
 #include <iostream>
 
 
@@ -159,7 +160,7 @@ Trie<T>::add(const std::wstring &key, T *userData)
         return old;
     }
 
-    Descriptor *d = getDesc(firstRow, key, 0, true, false);
+    Descriptor *d = getDesc(firstRow, key, 0, true, NULL);
     assert(d != NULL);
     T *old = d->userData;
     d->userData = userData;
@@ -177,11 +178,128 @@ Trie<T>::get(const std::wstring &key) const
     if (key.empty())
         return lambda;
 
-    Descriptor *d = const_cast<Trie<T> *>(this)->getDesc(firstRow, key, 0, false, true);
+    VirtualReceiver receiver(*this);
+    Descriptor *d = const_cast<Trie<T> *>(this)->getDesc(firstRow, key, 0, false, &receiver);
     return (d != NULL ? d->userData : NULL);
 }
 
 
+template <class T>
+T *
+Trie<T>::get(const std::wstring &key, TrieReceiver<T> &receiver) const
+{
+    if (lambda != NULL && !receiver.onFoundPrefixWithUserData(key, 0, lambda))
+        return NULL;
+
+    if (key.empty())
+        return lambda;
+
+    Descriptor *d = const_cast<Trie<T> *>(this)->getDesc(firstRow, key, 0, false, &receiver);
+    return (d != NULL ? d->userData : NULL);
+}
+
+
+template <class T>
+bool
+Trie<T>::getWithPrefix(const std::wstring &prefix, TrieReceiver<T> &receiver) const
+{
+    std::wstring key = prefix;
+    if (prefix.empty())
+    {
+        if (lambda != NULL && !receiver.onFoundPrefixWithUserData(key, 0, lambda))
+            return false;
+        return enumerateRow(firstRow, key, receiver);
+    }
+
+    const Row *row = firstRow;
+    const Descriptor *d = NULL;
+    for (std::wstring::size_type index = 0; index < prefix.length(); ++index)
+    {
+        if (row == NULL)
+            return true;
+        d = row->find(prefix[index]);
+        if (d == NULL)
+            return true;
+        row = d->inferiorRow;
+    }
+
+    if (d->userData != NULL
+            && !receiver.onFoundPrefixWithUserData(key, key.length(), d->userData))
+        return false;
+    return enumerateRow(row, key, receiver);
+}
+
+
+// Passes the keys of the subtree of 'row' to the receiver, 'key' being
+// the key of the row.  The elements of a row are in the order of their
+// insertion, so they are sorted first.
+//
+template <class T>
+bool
+Trie<T>::enumerateRow(const Row *row, std::wstring &key,
+                      TrieReceiver<T> &receiver) const
+{
+    if (row == NULL)
+        return true;
+
+    const std::vector<CharDesc> &elements = row->getElements();
+    std::vector<const CharDesc *> sorted;
+    sorted.reserve(elements.size());
+    for (typename std::vector<CharDesc>::const_iterator it = elements.begin();
+                                                        it != elements.end(); ++it)
+        sorted.push_back(&*it);
+    std::sort(sorted.begin(), sorted.end(), isCharLess);
+
+    for (typename std::vector<const CharDesc *>::const_iterator it = sorted.begin();
+                                                                it != sorted.end(); ++it)
+    {
+        key += (*it)->unichar;
+        const Descriptor &d = (*it)->desc;
+        if (d.userData != NULL
+                && !receiver.onFoundPrefixWithUserData(key, key.length(), d.userData))
+            return false;
+        if (!enumerateRow(d.inferiorRow, key, receiver))
+            return false;
+        key.erase(key.length() - 1);
+    }
+    return true;
+}
+
+
+template <class T>
+bool
+Trie<T>::walk(TrieWalker<T> &walker) const
+{
+    if (lambda != NULL && !walker.onUserData(lambda))
+        return false;
+    return walkRow(firstRow, walker);
+}
+
+
+template <class T>
+bool
+Trie<T>::walkRow(const Row *row, TrieWalker<T> &walker) const
+{
+    if (row == NULL)
+        return true;
+
+    const std::vector<CharDesc> &elements = row->getElements();
+    for (typename std::vector<CharDesc>::const_iterator it = elements.begin();
+                                                        it != elements.end(); ++it)
+    {
+        if (!walker.onEnter(it->unichar))
+            continue;
+        const Descriptor &d = it->desc;
+        if (d.userData != NULL && !walker.onUserData(d.userData))
+            return false;
+        if (!walkRow(d.inferiorRow, walker))
+            return false;
+        walker.onLeave();
+    }
+    return true;
+}
+
+
 template <class T>
 T *
 Trie<T>::getWithDefault(const std::wstring &key, T *deFault)
@@ -193,7 +311,7 @@ Trie<T>::getWithDefault(const std::wstring &key, T *deFault)
         return lambda;
     }
 
-    Descriptor *d = getDesc(firstRow, key, 0, true, false);
+    Descriptor *d = getDesc(firstRow, key, 0, true, NULL);
     assert(d != NULL);
     if (d->userData == NULL)
         d->userData = deFault;
@@ -211,7 +329,7 @@ Trie<T>::getUserDataPointer(const std::wstring &key)
     // Get descriptor associated with 'key' (and create a new entry
     // if the key is not known).
     //
-    Descriptor *d = getDesc(firstRow, key, 0, true, false);
+    Descriptor *d = getDesc(firstRow, key, 0, true, NULL);
     assert(d != NULL);
     return &d->userData;
 }
@@ -223,7 +341,7 @@ Trie<T>::getDesc(Row *row,
                 const std::wstring &key,
                 std::wstring::size_type index,
                 bool create,
-                bool callFoundPrefixCallback)
+                TrieReceiver<T> *receiver)
 {
     assert(row != NULL);
     assert(index < key.length());
@@ -239,7 +357,7 @@ Trie<T>::getDesc(Row *row,
                    << ", key='" << key << "' (len=" << key.length()
                    << "), index=" << index
                    << ", create=" << create
-                   << ", call=" << callFoundPrefixCallback
+                   << ", receiver=" << receiver
                    << "): unichar=" << unichar << ", pd=" << pd << "\n";
 
     if (pd == NULL)  // if expected character not found
@@ -259,7 +377,7 @@ Trie<T>::getDesc(Row *row,
         assert(row->find(unichar)->inferiorRow == newDesc.inferiorRow);
 
         return getDesc(newDesc.inferiorRow,
-                        key, index + 1, create, callFoundPrefixCallback);
+                        key, index + 1, create, receiver);
     }
 
     if (trieTrace)
@@ -267,8 +385,9 @@ Trie<T>::getDesc(Row *row,
                    << ", inferiorRow=" << pd->inferiorRow
                    << "\n";
 
-    if (callFoundPrefixCallback && pd->userData != NULL)
-        onFoundPrefixWithUserData(key, index + 1, pd->userData);  // virtual call
+    if (receiver != NULL && pd->userData != NULL
+            && !receiver->onFoundPrefixWithUserData(key, index + 1, pd->userData))  // virtual call
+        return NULL;  // search stopped by the receiver
 
     if (index + 1 == key.length())  // if reached end of key
     {
@@ -286,7 +405,7 @@ Trie<T>::getDesc(Row *row,
     }
 
     return getDesc(pd->inferiorRow,
-                        key, index + 1, create, callFoundPrefixCallback);
+                        key, index + 1, create, receiver);
 }
 
 
@@ -30,6 +30,67 @@
 namespace verbiste {
 
 
+/** Receiver of the prefixes found by Trie<T>::get(key, receiver).
+    Unlike the virtual Trie<T>::onFoundPrefixWithUserData(), a receiver
+    is supplied with each search, so concurrent searches on the same trie
+    can each use their own receiver.
+    @param        T     type of the user data attached to the stored strings
+*/
+template <class T>
+class TrieReceiver
+{
+public:
+
+    virtual ~TrieReceiver() {}
+
+    /** Callback invoked by the Trie<>::get(key, receiver) method for
+        each prefix of the searched string for which the trie has
+        some user data.
+        @param  key         the searched string
+        @param  index       length of the prefix
+        @param  userData    user data that is associated with the prefix
+        @returns            true to continue the search with longer
+                            prefixes, or false to stop it
+    */
+    virtual bool onFoundPrefixWithUserData(const std::wstring &key,
+                                        std::wstring::size_type index,
+                                        const T *userData) = 0;
+};
+
+
+/** Object that guides a walk through the nodes of a trie, e.g., for an
+    approximate search, which abandons the subtrees whose keys are all
+    too far from the searched string.
+    @param        T     type of the user data attached to the stored strings
+*/
+template <class T>
+class TrieWalker
+{
+public:
+
+    virtual ~TrieWalker() {}
+
+    /** Called when the walk goes from the current node to its child
+        reached by the character 'c'.
+        @returns            true to walk the subtree of the child,
+                            or false to skip it
+    */
+    virtual bool onEnter(wchar_t c) = 0;
+
+    /** Called when the walk goes back from a child that onEnter() accepted. */
+    virtual void onLeave() = 0;
+
+    /** Called for the current node if it has user data, i.e., for the
+        root before anything else, and for another node after the call
+        to onEnter() that accepted it.
+        @param  userData    user data that is associated with the node
+        @returns            true to continue the walk, or false to stop it
+                            without any further call
+    */
+    virtual bool onUserData(const T *userData) = 0;
+};
+
+
 /** Tree structure for (wide character) string storage.
     @param        T     type of the user data attached to the stored strings;
                         pointers to objects of type T will be stored in the
@@ -74,6 +135,52 @@ public:
     T *get(const std::wstring &key) const;
 
 
+    /** Searches the trie with the given (wide character) key.
+        Invokes receiver.onFoundPrefixWithUserData() for each find,
+        instead of the virtual function onFoundPrefixWithUserData().
+        The search stops as soon as the receiver returns false.
+        This method does not modify the trie and may be called
+        concurrently by several threads, as long as no thread
+        modifies the trie at the same time.
+        @param  key         wide character string to search for
+        @param  receiver    object that receives the found prefixes
+        @returns            a pointer to the user data pointer
+                            associated with 'key', or NULL if
+                            nothing was found or if the receiver
+                            stopped the search
+    */
+    T *get(const std::wstring &key, TrieReceiver<T> &receiver) const;
+
+
+    /** Enumerates the keys that begin with the given prefix, the
+        prefix itself included, in increasing order of their characters.
+        Invokes receiver.onFoundPrefixWithUserData(k, k.length(), userData)
+        for each such key k that has user data.
+        The enumeration stops as soon as the receiver returns false.
+        Since every leaf has user data, receiving the first n keys visits
+        at most n times the length of the longest key in nodes, however
+        large the subtree of the prefix is.
+        Like get(key, receiver), this method may be called concurrently
+        by several threads.
+        @param  prefix      wide character string that begins the keys
+        @param  receiver    object that receives the keys
+        @returns            false if the receiver stopped the enumeration
+    */
+    bool getWithPrefix(const std::wstring &prefix, TrieReceiver<T> &receiver) const;
+
+
+    /** Walks through the nodes of the trie, under the guidance of the
+        walker, in an unspecified order of the children of each node.
+        The walk takes time in proportion to the number of nodes that
+        the walker accepts.
+        Like get(key, receiver), this method may be called concurrently
+        by several threads.
+        @param  walker      object that accepts or skips the subtrees
+        @returns            false if the walker stopped the walk
+    */
+    bool walk(TrieWalker<T> &walker) const;
+
+
     T *getWithDefault(const std::wstring &key, T *deFault = NULL);
 
 
@@ -111,6 +218,23 @@ private:
 
     class Row;
 
+    /** Receiver that forwards to the virtual onFoundPrefixWithUserData().
+    */
+    class VirtualReceiver : public TrieReceiver<T>
+    {
+    public:
+        VirtualReceiver(const Trie<T> &t) : trie(t) {}
+        virtual bool onFoundPrefixWithUserData(const std::wstring &key,
+                                        std::wstring::size_type index,
+                                        const T *userData)
+        {
+            trie.onFoundPrefixWithUserData(key, index, userData);
+            return true;
+        }
+    private:
+        const Trie<T> &trie;
+    };
+
     class Descriptor
     {
     public:
@@ -187,6 +311,10 @@ private:
             Returns NULL if no such element exists.
         */
         Descriptor *find(wchar_t unichar);
+        const Descriptor *find(wchar_t unichar) const
+        {
+            return const_cast<Row *>(this)->find(unichar);
+        }
 
         /** Finds or creates an element of this row whose char. field is 'unichar'.
             If no such element exists, one is created using the
@@ -200,16 +328,27 @@ private:
         */
         size_t computeMemoryConsumption() const;
 
+        /** Returns the elements of this row, in the order of their insertion.
+        */
+        const std::vector<CharDesc> &getElements() const { return elements; }
+
     private:
         std::vector<CharDesc> elements;  // average size should be about 1.4
     };
 
-
     Descriptor *getDesc(Row *row,
                         const std::wstring &key,
                         std::wstring::size_type index,
                         bool create,
-                        bool callFoundPrefixCallback);
+                        TrieReceiver<T> *receiver);
+
+    bool enumerateRow(const Row *row, std::wstring &key,
+                      TrieReceiver<T> &receiver) const;
+    bool walkRow(const Row *row, TrieWalker<T> &walker) const;
+    static bool isCharLess(const CharDesc *a, const CharDesc *b)
+    {
+        return a->unichar < b->unichar;
+    }
 
 
     T *lambda;  // user data associated with the empty string key
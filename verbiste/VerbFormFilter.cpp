@@ -0,0 +1,227 @@
+/*  $Id$
+    VerbFormFilter.cpp - Fast rejection of words that cannot be verbs
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+#include "VerbFormFilter.h"
+
+using namespace std;
+using namespace verbiste;
+
+
+static const unsigned long long fnvOffsetBasis = 14695981039346656037ULL;
+static const unsigned long long fnvPrime = 1099511628211ULL;
+static const size_t numProbes = 6;
+
+
+// FNV-1a step over one byte.
+//
+inline
+unsigned long long
+hashByte(unsigned long long h, unsigned char c)
+{
+    return (h ^ c) * fnvPrime;
+}
+
+
+// Hash of a radical: its bytes in order.
+//
+static
+unsigned long long
+hashRadical(const string &s)
+{
+    unsigned long long h = fnvOffsetBasis;
+    for (string::size_type i = 0; i < s.length(); ++i)
+        h = hashByte(h, (unsigned char) s[i]);
+    return h;
+}
+
+
+// Hash of a termination: its bytes in reverse order, so that the
+// hashes of all the suffixes of a word are obtained in one pass
+// from its end.
+//
+static
+unsigned long long
+hashTermination(const string &s)
+{
+    unsigned long long h = fnvOffsetBasis;
+    for (string::size_type i = s.length(); i-- > 0; )
+        h = hashByte(h, (unsigned char) s[i]);
+    return h;
+}
+
+
+// The filters are "blocked": the probes of a key all fall in the same
+// 64-bit word, so that a test touches a single word of memory.
+// The word is chosen by the low bits of the hash, and each probe uses
+// its own six of the 36 high bits.
+//
+inline
+unsigned long long
+getProbeMask(unsigned long long hash)
+{
+    unsigned long long probeMask = 0;
+    for (size_t i = 0; i < numProbes; ++i)
+        probeMask |= 1ULL << ((hash >> (64 - 6 * (i + 1))) & 63);
+    return probeMask;
+}
+
+
+void
+VerbFormFilter::BloomFilter::add(unsigned long long hash)
+{
+    if (words.empty())
+    {
+        pending.push_back(hash);
+        return;
+    }
+
+    words[hash & mask] |= getProbeMask(hash);
+}
+
+
+bool
+VerbFormFilter::BloomFilter::mayContain(unsigned long long hash) const
+{
+    unsigned long long probeMask = getProbeMask(hash);
+    return (words[hash & mask] & probeMask) == probeMask;
+}
+
+
+void
+VerbFormFilter::BloomFilter::build(size_t bitsPerKey)
+{
+    size_t numWords = 1;
+    while (numWords * 64 < pending.size() * bitsPerKey)
+        numWords *= 2;
+
+    words.assign(numWords, 0);
+    mask = numWords - 1;
+
+    vector<unsigned long long> hashes;
+    hashes.swap(pending);
+    for (vector<unsigned long long>::const_iterator it = hashes.begin();
+                                                    it != hashes.end(); ++it)
+        add(*it);
+}
+
+
+size_t
+VerbFormFilter::BloomFilter::computeMemoryConsumption() const
+{
+    return sizeof(*this)
+           + words.capacity() * sizeof(unsigned long long)
+           + pending.capacity() * sizeof(unsigned long long);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+
+VerbFormFilter::VerbFormFilter()
+  : radicals(),
+    terminations(),
+    maxTerminationLength(0),
+    built(false)
+{
+}
+
+
+void
+VerbFormFilter::addRadical(const string &utf8Radical)
+{
+    radicals.add(hashRadical(utf8Radical));
+}
+
+
+void
+VerbFormFilter::addTermination(const string &utf8Termination)
+{
+    terminations.add(hashTermination(utf8Termination));
+    if (utf8Termination.length() > maxTerminationLength)
+        maxTerminationLength = utf8Termination.length();
+}
+
+
+void
+VerbFormFilter::build(size_t bitsPerKey)
+{
+    radicals.build(bitsPerKey);
+    terminations.build(bitsPerKey);
+    built = true;
+}
+
+
+bool
+VerbFormFilter::mayBeVerb(const string &utf8Word) const
+{
+    if (!built)
+        return true;
+
+    const unsigned char *word = reinterpret_cast<const unsigned char *>(utf8Word.data());
+    size_t len = utf8Word.length();
+
+    // Only the boundaries that leave at most maxTerminationLength bytes
+    // after them are examined.
+    size_t start = (len > maxTerminationLength ? len - maxTerminationLength : 0);
+
+    // suffixHashes[i - start] is the hash of the termination that
+    // starts at byte i.
+    unsigned long long localHashes[64];
+    vector<unsigned long long> heapHashes;
+    unsigned long long *suffixHashes = localHashes;
+    if (len - start >= sizeof(localHashes) / sizeof(localHashes[0]))
+    {
+        heapHashes.resize(len - start + 1);
+        suffixHashes = &heapHashes[0];
+    }
+
+    unsigned long long h = fnvOffsetBasis;
+    suffixHashes[len - start] = h;
+    for (size_t i = len; i-- > start; )
+        suffixHashes[i - start] = h = hashByte(h, word[i]);
+
+    h = fnvOffsetBasis;  // hash of the radical that ends at byte i
+    for (size_t i = 0; i < start; ++i)
+        h = hashByte(h, word[i]);
+    for (size_t i = start; ; ++i)
+    {
+        bool charBoundary = (i == len || (word[i] & 0xC0) != 0x80);
+        if (charBoundary
+                && terminations.mayContain(suffixHashes[i - start])
+                && radicals.mayContain(h))
+            return true;
+        if (i == len)
+            break;
+        h = hashByte(h, word[i]);
+    }
+
+    return false;
+}
+
+
+size_t
+VerbFormFilter::computeMemoryConsumption() const
+{
+    return sizeof(*this)
+           + radicals.computeMemoryConsumption() - sizeof(radicals)
+           + terminations.computeMemoryConsumption() - sizeof(terminations);
+}
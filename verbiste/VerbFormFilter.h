@@ -0,0 +1,119 @@
+/*  $Id$
+    VerbFormFilter.h - Fast rejection of words that cannot be verbs
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+#ifndef _H_VerbFormFilter
+#define _H_VerbFormFilter
+
+#include <vector>
+#include <string>
+
+
+namespace verbiste {
+
+
+/** Two-level probabilistic filter over conjugated verbs.
+    A conjugated verb is a known radical followed by a termination
+    of one of the templates.  This filter keeps one Bloom filter of the
+    radicals and one of the terminations, both hashed on their UTF-8 bytes.
+    A word is accepted if, at one of its character boundaries, the part
+    before the boundary may be a radical and the part after it may be
+    a termination.  Only the boundaries that are followed by at most
+    as many bytes as the longest termination are examined.
+    A rejected word is certainly not a conjugated verb; an accepted word
+    may or may not be one.  The test is a single pass over the bytes
+    of the word, without conversion to wide characters.
+*/
+class VerbFormFilter
+{
+public:
+
+    /** Creates a filter that accepts everything until build() is called.
+    */
+    VerbFormFilter();
+
+    /** Registers a verb radical.
+        Before build(), the radical is only recorded; after build(),
+        it is added to the filter immediately.
+        @param  utf8Radical     radical in UTF-8 (may be empty)
+    */
+    void addRadical(const std::string &utf8Radical);
+
+    /** Registers a termination.
+        Before build(), the termination is only recorded; after build(),
+        it is added to the filter immediately.
+        @param  utf8Termination termination in UTF-8 (may be empty)
+    */
+    void addTermination(const std::string &utf8Termination);
+
+    /** Sizes the Bloom filters for the recorded radicals and terminations
+        and fills them.
+        @param  bitsPerKey      number of filter bits per recorded key;
+                                more bits mean fewer false positives
+    */
+    void build(size_t bitsPerKey = 12);
+
+    /** Indicates if the filter has been built.
+    */
+    bool isBuilt() const { return built; }
+
+    /** Tests if a word may be a conjugated verb.
+        This method may be called concurrently by several threads.
+        @param  utf8Word        word in UTF-8
+        @returns                false if the word certainly is not a
+                                known conjugated verb; true otherwise,
+                                or if build() has not been called
+    */
+    bool mayBeVerb(const std::string &utf8Word) const;
+
+    /** Computes and returns the number of memory bytes consumed by
+        this object.
+        @returns                        number of bytes
+    */
+    size_t computeMemoryConsumption() const;
+
+private:
+
+    class BloomFilter
+    {
+    public:
+        BloomFilter() : words(), mask(0), pending() {}
+        void add(unsigned long long hash);
+        bool mayContain(unsigned long long hash) const;
+        void build(size_t bitsPerKey);
+        size_t computeMemoryConsumption() const;
+
+        std::vector<unsigned long long> words;
+        unsigned long long mask;  // number of words minus one (a power of 2)
+        std::vector<unsigned long long> pending;  // hashes recorded before build()
+    };
+
+    BloomFilter radicals;
+    BloomFilter terminations;
+    size_t maxTerminationLength;  // in bytes
+    bool built;
+};
+
+
+}  // namespace verbiste
+
+
+#endif  /* _H_VerbFormFilter */
@@ -0,0 +1,806 @@
+/*  $Id$
+    benchlookup.cpp - Measures the speed of the dictionary lookups
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+/*  Usage: benchlookup [TEXTFILE]
+    The words of TEXTFILE (UTF-8) are looked up in the French dictionary.
+    Without a file, the words are the forms generated from every third
+    known verb, followed by as many non-verbs obtained by altering
+    one letter of those forms.
+*/
+
+#ifndef VERBSFRXML
+#error VERBSFRXML expected to be a macro designating the verbs-fr.xml file
+#endif
+#ifndef CONJUGATIONFRXML
+#error CONJUGATIONFRXML expected to be a macro designating the conjugation-fr.xml file
+#endif
+
+#include <verbiste/FrenchVerbDictionary.h>
+#include <verbiste/Trie.h>
+#include <verbiste/BitmapTrie.h>
+#include <verbiste/LoudsTrie.h>
+
+#include <iostream>
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace verbiste;
+
+
+static const string testName = "benchlookup";
+static volatile size_t sink;  // keeps the measured calls from being optimized out
+
+
+static double
+getTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+
+// Splits the file at the ASCII bytes that are not letters or apostrophes.
+//
+static void
+readWords(const char *filename, vector<string> &words)
+{
+    ifstream file(filename);
+    string word;
+    char c;
+    while (file.get(c))
+    {
+        unsigned char u = (unsigned char) c;
+        if (u >= 0x80 || isalpha(u) || u == '\'')
+            word += char(u < 0x80 ? tolower(u) : u);
+        else if (!word.empty())
+        {
+            words.push_back(word);
+            word.clear();
+        }
+    }
+    if (!word.empty())
+        words.push_back(word);
+}
+
+
+static void
+generateWords(const FrenchVerbDictionary &fvd, vector<string> &words)
+{
+    static const struct { Mode m; Tense t; } tenses[] =
+    {
+        { INDICATIVE_MODE, PRESENT_TENSE },
+        { INDICATIVE_MODE, IMPERFECT_TENSE },
+        { INDICATIVE_MODE, FUTURE_TENSE },
+        { INDICATIVE_MODE, PAST_TENSE },
+        { CONDITIONAL_MODE, PRESENT_TENSE },
+        { SUBJUNCTIVE_MODE, PRESENT_TENSE },
+        { PARTICIPLE_MODE, PAST_TENSE },
+        { INVALID_MODE, INVALID_TENSE }
+    };
+
+    size_t counter = 0;
+    for (VerbTable::const_iterator it = fvd.beginKnownVerbs();
+                                   it != fvd.endKnownVerbs(); ++it)
+    {
+        if (counter++ % 3 != 0)
+            continue;
+        const string &tname = *it->second.begin();
+        const TemplateSpec *templ = fvd.getTemplate(tname);
+        if (templ == NULL)
+            continue;
+        string radical = FrenchVerbDictionary::getRadical(it->first, tname);
+        for (size_t i = 0; tenses[i].m != INVALID_MODE; ++i)
+        {
+            vector< vector<string> > persons;
+            fvd.generateTense(radical, *templ, tenses[i].m, tenses[i].t,
+                              persons, false, false, false);
+            for (size_t p = 0; p < persons.size(); ++p)
+                words.insert(words.end(), persons[p].begin(), persons[p].end());
+        }
+    }
+
+    // Alter one ASCII letter of each form to obtain mostly non-verbs.
+    size_t numForms = words.size();
+    srand(42);
+    for (size_t i = 0; i < numForms; ++i)
+    {
+        string w = words[i];
+        size_t pos = rand() % w.length();
+        if ((unsigned char) w[pos] < 0x80)
+            w[pos] = char('a' + rand() % 26);
+        words.push_back(w);
+    }
+}
+
+
+static void
+benchPrefilter(const FrenchVerbDictionary &fvd, const vector<string> &words)
+{
+    size_t numVerbs = 0, numNonVerbs = 0, numFalsePositives = 0;
+    vector<bool> isVerb(words.size());
+    for (size_t i = 0; i < words.size(); ++i)
+    {
+        vector<InflectionGroup> groups;
+        fvd.deconjugate(words[i], groups);
+        isVerb[i] = !groups.empty();
+        if (isVerb[i])
+            ++numVerbs;
+        else
+        {
+            ++numNonVerbs;
+            if (fvd.mayBeConjugatedVerb(words[i]))
+                ++numFalsePositives;
+        }
+    }
+
+    cout << "prefilter: " << numVerbs << " verbs, " << numNonVerbs
+         << " non-verbs, false positive rate "
+         << (numNonVerbs == 0 ? 0.0 : 100.0 * numFalsePositives / numNonVerbs)
+         << "%\n";
+
+    const size_t numRounds = 5;
+    double t0 = getTime();
+    for (size_t r = 0; r < numRounds; ++r)
+        for (size_t i = 0; i < words.size(); ++i)
+            sink += fvd.mayBeConjugatedVerb(words[i]);
+    double t1 = getTime();
+    for (size_t r = 0; r < numRounds; ++r)
+        for (size_t i = 0; i < words.size(); ++i)
+            if (!isVerb[i])
+            {
+                vector<InflectionGroup> groups;
+                fvd.deconjugate(words[i], groups);
+                sink += groups.size();
+            }
+    double t2 = getTime();
+    for (size_t r = 0; r < numRounds; ++r)
+        for (size_t i = 0; i < words.size(); ++i)
+        {
+            vector<InflectionGroup> groups;
+            fvd.deconjugate(words[i], groups);
+            sink += groups.size();
+        }
+    double t3 = getTime();
+
+    double n = double(numRounds) * words.size();
+    cout << "prefilter: " << (t1 - t0) * 1e9 / n << " ns per filter test, "
+         << (t2 - t1) * 1e9 / (numRounds * (numNonVerbs == 0 ? 1 : numNonVerbs))
+         << " ns per non-verb lookup, "
+         << (t3 - t2) * 1e9 / n << " ns per lookup\n";
+}
+
+
+// Counts the prefixes found in a trie.
+//
+class CountingReceiver : public TrieReceiver<int>
+{
+public:
+    CountingReceiver() : count(0) {}
+    virtual bool onFoundPrefixWithUserData(const wstring &, wstring::size_type, const int *)
+    {
+        ++count;
+        return true;
+    }
+    size_t count;
+};
+
+
+// Measures the cost of each level of the trie: the time taken by get()
+// on the prefixes of length L of the keys, minus the time taken on
+// their prefixes of length L - 1.  Every level is timed on the keys
+// of at least maxLevel characters, so that a difference does not count
+// a change of population.  Each time is the best of several rounds.
+//
+template <class TrieType>
+static void
+benchTrieLevels(const TrieType &trie, const vector<wstring> &keys)
+{
+    const size_t maxLevel = 12;
+    const size_t numRounds = 10;
+    vector<const wstring *> longKeys;
+    for (size_t i = 0; i < keys.size(); ++i)
+        if (keys[i].length() >= maxLevel)
+            longKeys.push_back(&keys[i]);
+    if (longKeys.empty())
+        return;
+
+    vector< vector<wstring> > prefixes(maxLevel + 1, vector<wstring>(longKeys.size()));
+    for (size_t level = 0; level <= maxLevel; ++level)
+        for (size_t i = 0; i < longKeys.size(); ++i)
+            prefixes[level][i].assign(*longKeys[i], 0, level);
+
+    // The levels take turns in each round, so that a slowdown of the
+    // machine affects all of them alike.
+    vector<double> elapsed(maxLevel + 1, 1e9);
+    for (size_t r = 0; r < numRounds; ++r)
+        for (size_t level = 0; level <= maxLevel; ++level)
+        {
+            double t0 = getTime();
+            for (size_t i = 0; i < longKeys.size(); ++i)
+            {
+                CountingReceiver receiver;
+                (void) trie.get(prefixes[level][i], receiver);
+                sink += receiver.count;
+            }
+            elapsed[level] = min(elapsed[level], getTime() - t0);
+        }
+
+    cout << "trie levels (ns, " << longKeys.size() << " keys):";
+    for (size_t level = 1; level <= maxLevel; ++level)
+        cout << " " << level << ":"
+             << (elapsed[level] - elapsed[level - 1]) * 1e9 / longKeys.size();
+    cout << "\n";
+}
+
+
+static int dummyUserData;
+
+
+// Measures the trie walk alone, on a trie that contains all the words.
+//
+template <class TrieType>
+static void
+benchTrieSearch(const char *trieName, const TrieType &trie, const vector<wstring> &keys)
+{
+    cout << trieName << " of all words: " << trie.computeMemoryConsumption() << " bytes\n";
+
+    benchTrieLevels(trie, keys);
+
+    const size_t numRounds = 5;
+    double t0 = getTime();
+    for (size_t r = 0; r < numRounds; ++r)
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            CountingReceiver receiver;
+            (void) trie.get(keys[i], receiver);
+            sink += receiver.count;
+        }
+    double t1 = getTime();
+    cout << "trie walk: " << (t1 - t0) * 1e9 / (double(numRounds) * keys.size())
+         << " ns per get()\n";
+}
+
+
+template <class TrieType>
+static void
+benchTrieWalk(const char *trieName, const vector<wstring> &keys)
+{
+    TrieType trie(false);
+    for (size_t i = 0; i < keys.size(); ++i)
+        trie.add(keys[i], &dummyUserData);
+    benchTrieSearch(trieName, trie, keys);
+}
+
+
+// Same as benchTrieWalk(), with the succinct encoding of a trie.
+//
+static void
+benchSuccinctWalk(const vector<wstring> &keys)
+{
+    LoudsTrie<int>::EntryList entries;
+    {
+        BitmapTrie<int> trie(false);
+        for (size_t i = 0; i < keys.size(); ++i)
+            trie.add(keys[i], &dummyUserData);
+        trie.getEntries(entries);
+    }
+
+    LoudsTrie<int> trie(false);
+    double t0 = getTime();
+    if (!trie.build(entries))
+    {
+        cout << "LoudsTrie: too many distinct characters\n";
+        return;
+    }
+    double t1 = getTime();
+    cout << "LoudsTrie: " << trie.getNumNodes() << " nodes encoded in "
+         << (t1 - t0) * 1000 << " ms\n";
+    benchTrieSearch("LoudsTrie", trie, keys);
+}
+
+
+// Looks up all the words, one deconjugate() call per word, and
+// returns the average time per lookup in nanoseconds.
+//
+static double
+benchSingleLookups(const FrenchVerbDictionary &fvd, const vector<string> &words,
+                   vector< vector<InflectionGroup> > &results)
+{
+    FrenchVerbDictionary::LookupOptions options;
+    const size_t numRounds = 5;
+    double t0 = getTime();
+    for (size_t r = 0; r < numRounds; ++r)
+    {
+        results.assign(words.size(), vector<InflectionGroup>());
+        for (size_t i = 0; i < words.size(); ++i)
+            fvd.deconjugate(words[i], options, results[i]);
+    }
+    double t1 = getTime();
+    return (t1 - t0) * 1e9 / (double(numRounds) * words.size());
+}
+
+
+// Compares the speed of the lookups with the verb trie and with its
+// succinct encoding, which replaces it for the rest of the program.
+//
+static void
+benchSuccinctVerbTrie(FrenchVerbDictionary &fvd, const vector<string> &words)
+{
+    vector< vector<InflectionGroup> > before, after;
+    size_t bytesBefore = fvd.computeVerbTrieMemoryConsumption();
+    double nsBefore = benchSingleLookups(fvd, words, before);
+
+    double t0 = getTime();
+    if (!fvd.useSuccinctTrie())
+    {
+        cout << "verb trie: cannot be encoded\n";
+        return;
+    }
+    double t1 = getTime();
+
+    size_t bytesAfter = fvd.computeVerbTrieMemoryConsumption();
+    double nsAfter = benchSingleLookups(fvd, words, after);
+
+    cout << "verb trie: " << bytesBefore << " bytes, "
+         << nsBefore << " ns per lookup; succinct: " << bytesAfter << " bytes, "
+         << nsAfter << " ns per lookup, encoded in " << (t1 - t0) * 1000 << " ms\n";
+}
+
+
+// Loads the dictionary 'numLoads' times, from the XML files with
+// 'numThreads' threads or, if 'numThreads' is 0, from the image compiled
+// into the library, and returns the best loading time in seconds.
+//
+static double
+timeLoading(size_t numThreads, int numLoads)
+{
+    double best = 1e9;
+    for (int i = 0; i < numLoads; ++i)
+    {
+        double t0 = getTime();
+        FrenchVerbDictionary *other;
+        if (numThreads == 0)
+            other = new FrenchVerbDictionary(FrenchVerbDictionary::FRENCH, true, 1);
+        else
+            other = new FrenchVerbDictionary(CONJUGATIONFRXML, VERBSFRXML, true,
+                                             FrenchVerbDictionary::FRENCH, numThreads);
+        double t1 = getTime();
+        best = min(best, t1 - t0);
+        delete other;
+    }
+    return best;
+}
+
+
+// Prints the loading times from the XML files with 1, 2, 4 and 8
+// threads, and from the compiled image if there is one.
+//
+static void
+benchLoading()
+{
+    const int numLoads = 5;
+    for (size_t numThreads = 1; numThreads <= 8; numThreads *= 2)
+        cout << "load with " << numThreads << " threads: "
+             << timeLoading(numThreads, numLoads) * 1000 << " ms\n";
+    if (FrenchVerbDictionary::hasEmbeddedDictionary(FrenchVerbDictionary::FRENCH))
+        cout << "load from the compiled image: "
+             << timeLoading(0, numLoads) * 1000 << " ms\n";
+}
+
+
+// Loads the French dictionary without user verbs, then measures the
+// time taken by addUserVerbs() to add a one-verb document, and the
+// lookup time before and after, when the user layer is searched too.
+//
+static void
+benchUserVerbs(const vector<string> &words)
+{
+    char filename[] = "/tmp/benchlookup-XXXXXX";
+    int fd = mkstemp(filename);
+    if (fd < 0)
+        return;
+    static const char document[] =
+        "<?xml version=\"1.0\"?>\n"
+        "<verbs-fr>\n"
+        "<v><i>bloguer</i>\t<t>aim:er</t></v>\n"
+        "</verbs-fr>\n";
+    bool written = (write(fd, document, sizeof(document) - 1) == ssize_t(sizeof(document) - 1));
+    close(fd);
+    if (!written)
+    {
+        unlink(filename);
+        return;
+    }
+
+    FrenchVerbDictionary fvd(CONJUGATIONFRXML, VERBSFRXML, true,
+                             FrenchVerbDictionary::FRENCH);
+    vector< vector<InflectionGroup> > before, after;
+    double nsBefore = benchSingleLookups(fvd, words, before);
+
+    double t0 = getTime();
+    fvd.addUserVerbs(filename);
+    double t1 = getTime();
+    unlink(filename);
+
+    double nsAfter = benchSingleLookups(fvd, words, after);
+
+    cout << "user layer: one verb added in " << (t1 - t0) * 1e6 << " us; lookups: "
+         << nsBefore << " ns without, " << nsAfter << " ns with the user layer\n";
+}
+
+
+// Prints the number of verbs that addVerb() and removeVerb() handle
+// per second, with neologisms whose radical has an accent, so that
+// their forms without accents are added and removed too.
+//
+static void
+benchMutations()
+{
+    FrenchVerbDictionary fvd(CONJUGATIONFRXML, VERBSFRXML, true,
+                             FrenchVerbDictionary::FRENCH);
+
+    vector<string> neologisms;
+    for (char a = 'a'; a <= 'z'; ++a)
+        for (char b = 'a'; b <= 'z'; ++b)
+            for (char c = 'a'; c <= 'z'; c += 5)
+                neologisms.push_back(string("bl\303\251") + a + b + c + "er");  // "blé..er"
+
+    double t0 = getTime();
+    for (size_t i = 0; i < neologisms.size(); ++i)
+        fvd.addVerb(neologisms[i], "aim:er", false);
+    double t1 = getTime();
+    for (size_t i = 0; i < neologisms.size(); ++i)
+        sink += fvd.removeVerb(neologisms[i]);
+    double t2 = getTime();
+
+    double n = double(neologisms.size());
+    cout << "mutations: " << n / (t1 - t0) << " addVerb/s, "
+         << n / (t2 - t1) << " removeVerb/s\n";
+}
+
+
+// Returns the resident set size of the process in bytes, or 0.
+//
+static size_t
+getResidentBytes()
+{
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f == NULL)
+        return 0;
+    unsigned long size = 0, resident = 0;
+    if (fscanf(f, "%lu %lu", &size, &resident) != 2)
+        resident = 0;
+    fclose(f);
+    return size_t(resident) * size_t(sysconf(_SC_PAGESIZE));
+}
+
+
+// Prints the time from the start of the loading to the end of the
+// first lookup, and the memory added by the dictionary once all the
+// words have been looked up, with the templates of the compiled image
+// decoded on demand or while loading.  Each mode runs in a child
+// process so that it starts from the same resident memory.
+//
+static void
+benchTemplateDecoding(const vector<string> &words)
+{
+    if (!FrenchVerbDictionary::hasEmbeddedDictionary(FrenchVerbDictionary::FRENCH))
+        return;
+
+    for (int lazy = 1; lazy >= 0; --lazy)
+    {
+        cout << flush;
+        pid_t pid = fork();
+        if (pid < 0)
+            return;
+        if (pid > 0)
+        {
+            waitpid(pid, NULL, 0);
+            continue;
+        }
+
+        malloc_trim(0);  // returns the memory freed by the parent
+        size_t rss0 = getResidentBytes();
+        double t0 = getTime();
+        FrenchVerbDictionary fvd(FrenchVerbDictionary::FRENCH, true, 1, lazy != 0);
+        vector<InflectionGroup> results;
+        fvd.deconjugate(words[0], results);
+        double t1 = getTime();
+        size_t numFirst = fvd.getNumDecodedTemplates();
+        for (size_t w = 0; w < words.size(); ++w)
+        {
+            results.clear();
+            fvd.deconjugate(words[w], results);
+        }
+        size_t rss1 = getResidentBytes();
+
+        cout << (lazy ? "lazy" : "eager") << " templates: first lookup after "
+             << (t1 - t0) * 1000 << " ms (" << numFirst << " templates decoded), "
+             << (rss1 - rss0) / 1024 << " KiB resident after all lookups ("
+             << fvd.getNumDecodedTemplates() << " templates decoded)\n";
+        cout << flush;
+        _exit(EXIT_SUCCESS);
+    }
+}
+
+
+// Types one word out of ten, one character at a time, and looks up
+// each prefix with deconjugate(), as the search-as-you-type field does.
+//
+static void
+benchTyping(const FrenchVerbDictionary &fvd, const vector<string> &words)
+{
+    vector<string> prefixes;
+    for (size_t i = 0; i < words.size(); i += 10)
+        for (size_t len = 1; len <= words[i].length(); ++len)
+            if (len == words[i].length() || (words[i][len] & 0xC0) != 0x80)
+                prefixes.push_back(string(words[i], 0, len));  // whole UTF-8 characters
+
+    FrenchVerbDictionary::LookupOptions options;
+    const size_t numRounds = 5;
+    double t0 = getTime();
+    for (size_t r = 0; r < numRounds; ++r)
+        for (size_t i = 0; i < prefixes.size(); ++i)
+        {
+            vector<InflectionGroup> groups;
+            fvd.deconjugate(prefixes[i], options, groups);
+            sink += groups.size();
+        }
+    double t1 = getTime();
+
+    double n = double(numRounds) * prefixes.size();
+    cout << "typing: " << prefixes.size() << " prefixes, "
+         << (t1 - t0) * 1e9 / n << " ns per lookup\n";
+}
+
+
+// Times complete() on the prefixes of the words, with the given limit
+// on the number of proposed words.  Short prefixes have large subtrees,
+// so the time per prefix shows if the limit bounds the work.
+//
+static void
+benchCompletion(const FrenchVerbDictionary &fvd, const vector<string> &words,
+                size_t prefixLength, size_t maxResults)
+{
+    vector<string> prefixes;
+    for (size_t i = 0; i < words.size(); i += 100)
+        if (words[i].length() >= prefixLength)
+            prefixes.push_back(string(words[i], 0, prefixLength));
+
+    FrenchVerbDictionary::CompletionOptions options;
+    options.maxResults = maxResults;
+    size_t numProposed = 0;
+    double t0 = getTime();
+    for (size_t i = 0; i < prefixes.size(); ++i)
+    {
+        vector<string> completions;
+        fvd.complete(prefixes[i], options, completions);
+        numProposed += completions.size();
+    }
+    double t1 = getTime();
+    sink += numProposed;
+
+    cout << "completion: prefixes of " << prefixLength << " bytes, limit " << maxResults
+         << ": " << (t1 - t0) * 1e6 / prefixes.size() << " us per prefix, "
+         << double(numProposed) / prefixes.size() << " words proposed\n";
+}
+
+
+// Makes a typo in a word: deletes, doubles, transposes or replaces
+// one of its letters.
+//
+static wstring
+makeTypo(const wstring &word)
+{
+    wstring w = word;
+    size_t pos = rand() % w.length();
+    switch (rand() % 4)
+    {
+        case 0: w.erase(pos, 1); break;
+        case 1: w.insert(pos, 1, w[pos]); break;
+        case 2: if (pos + 1 < w.length()) swap(w[pos], w[pos + 1]); break;
+        default: w[pos] = wchar_t('a' + rand() % 26); break;
+    }
+    return w;
+}
+
+
+// Looks up synthetic typos of known forms with fuzzyDeconjugate(),
+// and tells how often the intended form is found, and how often
+// it comes first.  For one typo, also times the brute-force approach:
+// deconjugate() on every word at one edit from the typo.
+//
+static void
+benchFuzzy(const FrenchVerbDictionary &fvd, const vector<string> &words, unsigned numTypos)
+{
+    vector<wstring> forms;
+    set<wchar_t> letters;
+    for (size_t i = 0; i < words.size() && forms.size() < 1000; i += 97)
+    {
+        vector<InflectionDesc> results;
+        fvd.deconjugate(words[i], results);
+        if (results.empty())
+            continue;
+        forms.push_back(fvd.utf8ToWide(words[i]));
+        letters.insert(forms.back().begin(), forms.back().end());
+    }
+
+    srand(42);
+    vector<string> typos(forms.size());
+    for (size_t i = 0; i < forms.size(); ++i)
+    {
+        wstring typo = forms[i];
+        for (unsigned n = 0; n < numTypos && typo.length() > 1; ++n)
+            typo = makeTypo(typo);
+        typos[i] = fvd.wideToUTF8(typo);
+    }
+
+    FrenchVerbDictionary::FuzzyOptions options;
+    options.maxDistance = numTypos;
+    size_t numFound = 0, numFirst = 0, numMatches = 0;
+    double t0 = getTime();
+    for (size_t i = 0; i < typos.size(); ++i)
+    {
+        vector<FrenchVerbDictionary::FuzzyMatch> matches;
+        fvd.fuzzyDeconjugate(typos[i], options, matches);
+        numMatches += matches.size();
+        string intended = fvd.wideToUTF8(forms[i]);
+        for (size_t j = 0; j < matches.size(); ++j)
+            if (matches[j].word == intended)
+            {
+                ++numFound;
+                numFirst += (j == 0);
+                break;
+            }
+    }
+    double t1 = getTime();
+    sink += numMatches;
+
+    cout << "fuzzy: " << typos.size() << " words with " << numTypos << " typo(s), "
+         << (t1 - t0) * 1e6 / typos.size() << " us per word, intended form found "
+         << 100.0 * numFound / typos.size() << "%, first "
+         << 100.0 * numFirst / typos.size() << "%\n";
+
+    if (numTypos != 1)
+        return;
+
+    // Brute force on the first typos only: it is much slower.
+    const size_t numBrute = min(typos.size(), size_t(100));
+    size_t numCandidates = 0;
+    t0 = getTime();
+    for (size_t i = 0; i < numBrute; ++i)
+    {
+        wstring typo = fvd.utf8ToWide(typos[i]);
+        vector<wstring> candidates;
+        for (size_t pos = 0; pos <= typo.length(); ++pos)
+        {
+            if (pos < typo.length())
+                candidates.push_back(wstring(typo).erase(pos, 1));
+            if (pos + 1 < typo.length())
+            {
+                wstring w = typo;
+                swap(w[pos], w[pos + 1]);
+                candidates.push_back(w);
+            }
+            for (set<wchar_t>::const_iterator c = letters.begin(); c != letters.end(); ++c)
+            {
+                candidates.push_back(wstring(typo).insert(pos, 1, *c));
+                if (pos < typo.length())
+                {
+                    wstring w = typo;
+                    w[pos] = *c;
+                    candidates.push_back(w);
+                }
+            }
+        }
+        for (size_t j = 0; j < candidates.size(); ++j)
+        {
+            vector<InflectionDesc> results;
+            fvd.deconjugate(fvd.wideToUTF8(candidates[j]), results);
+            sink += results.size();
+        }
+        numCandidates += candidates.size();
+    }
+    t1 = getTime();
+    cout << "fuzzy: brute force over " << double(numCandidates) / numBrute
+         << " candidates per word, " << (t1 - t0) * 1e6 / numBrute << " us per word\n";
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    try
+    {
+        double t0 = getTime();
+        FrenchVerbDictionary fvd(CONJUGATIONFRXML, VERBSFRXML, true,
+                                 FrenchVerbDictionary::FRENCH);
+        double t1 = getTime();
+        cout << "load: " << (t1 - t0) * 1000 << " ms\n";
+
+        vector<string> words;
+        if (argc > 1)
+            readWords(argv[1], words);
+        else
+            generateWords(fvd, words);
+        if (words.empty())
+        {
+            cout << testName << ": no words to look up" << endl;
+            return EXIT_FAILURE;
+        }
+        cout << "words: " << words.size() << "\n";
+
+        benchLoading();
+
+        benchTemplateDecoding(words);
+
+        benchUserVerbs(words);
+
+        benchMutations();
+
+        benchPrefilter(fvd, words);
+
+        benchTyping(fvd, words);
+        benchCompletion(fvd, words, 1, 10);
+        benchCompletion(fvd, words, 1, 0);
+        benchCompletion(fvd, words, 3, 10);
+        benchCompletion(fvd, words, 3, 0);
+        benchFuzzy(fvd, words, 1);
+        benchFuzzy(fvd, words, 2);
+
+        // Generation order, then random order as in running text.
+        for (int shuffled = 0; shuffled < 2; ++shuffled)
+        {
+            if (shuffled)
+            {
+                srand(42);
+                random_shuffle(words.begin(), words.end());
+                cout << "shuffled words:\n";
+            }
+            vector<wstring> keys(words.size());
+            for (size_t i = 0; i < words.size(); ++i)
+                keys[i] = fvd.utf8ToWide(words[i]);
+            benchTrieWalk< Trie<int> >("Trie", keys);
+            benchTrieWalk< BitmapTrie<int> >("BitmapTrie", keys);
+            benchSuccinctWalk(keys);
+        }
+
+        benchSuccinctVerbTrie(fvd, words);
+    }
+    catch (const logic_error &e)
+    {
+        cout << testName << ": " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -24,6 +24,7 @@
 
 #include <verbiste/misc-types.h>
 
+#include <assert.h>
 #include <iostream>
 #include <errno.h>
 #include <string.h>
@@ -166,26 +167,36 @@ verbiste_get_tense_name(Verbiste_Tense tense)
 
 static
 Verbiste_ModeTensePersonNumber *
-createModeTensePersonNumberArray(const vector<InflectionDesc> &vec)
+createModeTensePersonNumberArray(const vector<InflectionGroup> &groups)
 {
-    size_t vecSize = vec.size();
+    size_t arraySize = 0;
+    for (vector<InflectionGroup>::const_iterator g = groups.begin();
+                                                 g != groups.end(); ++g)
+        arraySize += g->mtpns.size();
 
     Verbiste_ModeTensePersonNumber *array =
-                        new Verbiste_ModeTensePersonNumber[vecSize + 1];
+                        new Verbiste_ModeTensePersonNumber[arraySize + 1];
     if (array == NULL)
         return NULL;
 
-    for (size_t i = 0; i < vecSize; i++)
+    size_t i = 0;
+    for (vector<InflectionGroup>::const_iterator g = groups.begin();
+                                                 g != groups.end(); ++g)
     {
-        array[i].infinitive_verb = strnew(vec[i].infinitive.c_str());
-        vec[i].mtpn.dump(array[i]);
+        for (vector<ModeTensePersonNumber>::const_iterator k = g->mtpns.begin();
+                                                 k != g->mtpns.end(); ++k, ++i)
+        {
+            array[i].infinitive_verb = strnew(g->infinitive);
+            k->dump(array[i]);
+        }
     }
+    assert(i == arraySize);
 
-    array[vecSize].infinitive_verb = NULL;
-    array[vecSize].mode = VERBISTE_INVALID_MODE;
-    array[vecSize].tense = VERBISTE_INVALID_TENSE;
-    array[vecSize].person = 0;
-    array[vecSize].plural = false;
+    array[arraySize].infinitive_verb = NULL;
+    array[arraySize].mode = VERBISTE_INVALID_MODE;
+    array[arraySize].tense = VERBISTE_INVALID_TENSE;
+    array[arraySize].person = 0;
+    array[arraySize].plural = false;
 
     return array;
 }
@@ -194,9 +205,37 @@ createModeTensePersonNumberArray(const vector<InflectionDesc> &vec)
 Verbiste_ModeTensePersonNumber *
 verbiste_deconjugate(const char *verb)
 {
-    vector<InflectionDesc> vec;
-    fvd->deconjugate(verb, vec);
-    return createModeTensePersonNumberArray(vec);
+    vector<InflectionGroup> groups;
+    fvd->deconjugate(verb, groups);
+    return createModeTensePersonNumberArray(groups);
+}
+
+
+int
+verbiste_set_lookup_cache(size_t max_entries)
+{
+    if (fvd == NULL)
+        return -1;
+
+    fvd->setLookupCache(max_entries);
+    return 0;
+}
+
+
+int
+verbiste_get_lookup_cache_statistics(Verbiste_LookupCacheStatistics *stats)
+{
+    LookupCache::Statistics s;
+    if (fvd == NULL || stats == NULL || !fvd->getLookupCacheStatistics(s))
+        return -1;
+
+    stats->hits = s.hits;
+    stats->misses = s.misses;
+    stats->insertions = s.insertions;
+    stats->evictions = s.evictions;
+    stats->entries = s.entries;
+    stats->bytes = s.bytes;
+    return 0;
 }
 
 
@@ -240,7 +279,7 @@ verbiste_get_verb_template_array(const char *infinitive_verb)
 {
     if (infinitive_verb == NULL)
         return NULL;
-    const std::set<std::string> &templateSet = fvd->getVerbTemplateSet(infinitive_verb);
+    const std::set<std::string> templateSet = fvd->getVerbTemplateSet(infinitive_verb);
     if (templateSet.empty())
         return NULL;
 
@@ -272,6 +311,75 @@ verbiste_free_verb_template_array(Verbiste_TemplateArray array)
 }
 
 
+// Passes the proposed words to a C callback.
+//
+class CallbackCompletionReceiver : public FrenchVerbDictionary::CompletionReceiver
+{
+public:
+    CallbackCompletionReceiver(Verbiste_CompletionCallback cb, void *ud)
+      : callback(cb), userData(ud) {}
+
+    virtual bool onCompletion(const string &utf8Word, const string &utf8Infinitive)
+    {
+        return callback(utf8Word.c_str(), utf8Infinitive.c_str(), userData) != 0;
+    }
+
+private:
+    Verbiste_CompletionCallback callback;
+    void *userData;
+};
+
+
+static FrenchVerbDictionary::CompletionOptions
+getCompletionOptions(size_t max_results, int flags)
+{
+    FrenchVerbDictionary::CompletionOptions options;
+    options.maxResults = max_results;
+    options.infinitivesOnly = (flags & VERBISTE_COMPLETE_INFINITIVES_ONLY) != 0;
+    options.ignoreAccents = (flags & VERBISTE_COMPLETE_IGNORE_ACCENTS) != 0;
+    return options;
+}
+
+
+int
+verbiste_complete(const char *prefix,
+                  size_t max_results,
+                  int flags,
+                  Verbiste_CompletionCallback callback,
+                  void *user_data)
+{
+    if (fvd == NULL || prefix == NULL || callback == NULL)
+        return -1;
+
+    CallbackCompletionReceiver receiver(callback, user_data);
+    return int(fvd->complete(prefix, getCompletionOptions(max_results, flags), receiver));
+}
+
+
+char **
+verbiste_get_completion_array(const char *prefix, size_t max_results, int flags)
+{
+    if (fvd == NULL || prefix == NULL)
+        return NULL;
+
+    vector<string> words;
+    fvd->complete(prefix, getCompletionOptions(max_results, flags), words);
+
+    char **a = new char *[words.size() + 1];
+    for (size_t i = 0; i < words.size(); ++i)
+        a[i] = strnew(words[i]);
+    a[words.size()] = NULL;
+    return a;
+}
+
+
+void
+verbiste_free_completion_array(char **array)
+{
+    free_string_array(array);
+}
+
+
 Verbiste_PersonArray
 verbiste_conjugate(const char *infinitive_verb,
                    const char *template_name,
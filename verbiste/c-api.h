@@ -109,6 +109,42 @@ typedef struct
 } Verbiste_ModeTense;
 
 
+typedef struct
+{
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long insertions;
+  unsigned long evictions;
+  size_t entries;  /* number of lookups currently cached */
+  size_t bytes;    /* estimated memory used by the cached results */
+
+/** Counters of the deconjugation cache. */
+} Verbiste_LookupCacheStatistics;
+
+
+/** Flags of verbiste_complete(). */
+enum
+{
+    VERBISTE_COMPLETE_INFINITIVES_ONLY = 1,  /* only propose infinitives */
+    VERBISTE_COMPLETE_IGNORE_ACCENTS = 2     /* "etio" proposes "étions"; since
+                                                verbiste_init() loads no forms
+                                                without accents, only the accents
+                                                of the terminations are ignored */
+};
+
+
+/** Receives a word proposed by verbiste_complete().
+    @param  word                UTF-8 word that begins with the prefix
+    @param  infinitive          UTF-8 infinitive of the verb of 'word'
+    @param  user_data           pointer passed to verbiste_complete()
+    @returns                    zero to stop the completion, non-zero
+                                to receive the next word
+*/
+typedef int (*Verbiste_CompletionCallback)(const char *word,
+                                           const char *infinitive,
+                                           void *user_data);
+
+
 extern const Verbiste_ModeTense verbiste_valid_modes_and_tenses[];
 
 
@@ -189,6 +225,25 @@ const char *verbiste_get_tense_name(Verbiste_Tense tense);
 Verbiste_ModeTensePersonNumber *verbiste_deconjugate(const char *verb);
 
 
+/** Caches the results of verbiste_deconjugate().
+    Replaces the current cache, if any, and discards its contents.
+    @param        max_entries   maximum number of cached lookups;
+                                zero disables the cache
+    @returns                    0 on success, or -1 if the dictionary
+                                has not been initialized
+*/
+int verbiste_set_lookup_cache(size_t max_entries);
+
+
+/** Obtains the counters of the cache set by verbiste_set_lookup_cache().
+    @param        stats         structure that receives the counters
+    @returns                    0 on success, or -1 if the dictionary
+                                has not been initialized or if no cache
+                                has been set
+*/
+int verbiste_get_lookup_cache_statistics(Verbiste_LookupCacheStatistics *stats);
+
+
 /** Frees the memory associated by the given array.
     @param        array         array to be freed;
                                 must have been allocated by a function such as
@@ -216,6 +271,48 @@ Verbiste_TemplateArray verbiste_get_verb_template_array(const char *infinitive_v
 void verbiste_free_verb_template_array(Verbiste_TemplateArray array);
 
 
+/** Proposes the known words, inflected forms or infinitives,
+    that begin with a prefix, e.g., to complete the word being typed.
+    The words are passed to the callback as they are found, the words
+    of the verbs added by the user first, and each word at most once.
+    @param  prefix              UTF-8 beginning of the words
+    @param  max_results         maximum number of proposed words,
+                                or zero for no limit
+    @param  flags               zero or VERBISTE_COMPLETE_* values
+                                combined with '|'
+    @param  callback            function that receives the words
+    @param  user_data           pointer passed to the callback
+    @returns                    the number of proposed words, or -1
+                                if the dictionary has not been initialized
+                                or if an argument is NULL
+*/
+int verbiste_complete(const char *prefix,
+                      size_t max_results,
+                      int flags,
+                      Verbiste_CompletionCallback callback,
+                      void *user_data);
+
+
+/** Returns the words proposed by verbiste_complete().
+    @returns                    an array of UTF-8 strings, the last element
+                                being a null pointer; a NULL pointer is
+                                returned if the dictionary has not been
+                                initialized; this array must be passed to
+                                verbiste_free_completion_array()
+                                to free the memory
+*/
+char **verbiste_get_completion_array(const char *prefix,
+                                     size_t max_results,
+                                     int flags);
+
+
+/** Frees the memory allocated by verbiste_get_completion_array().
+    @param  array               an array returned by verbiste_get_completion_array();
+                                can be NULL: this function does nothing in such a case
+*/
+void verbiste_free_completion_array(char **array);
+
+
 /** Conjugates a verb in a certain mode and tense.
     @param  infinitiveVerb      Latin-1 infinitive form of the verb
                                 to be conjugated
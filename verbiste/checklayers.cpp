@@ -0,0 +1,264 @@
+/*  $Id$
+    checklayers.cpp - Comparison of the ways of filling the user layer
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+/*  The same user verbs are given to three dictionaries: in the user's
+    verbs file, read by the constructor; to addUserVerbs(); and one by
+    one to addVerb().  The three dictionaries must give the same answers,
+    before and after removeVerb(), with and without the lookup cache.
+*/
+
+#ifndef VERBSFRXML
+#error VERBSFRXML expected to be a macro designating the verbs-fr.xml file
+#endif
+#ifndef CONJUGATIONFRXML
+#error CONJUGATIONFRXML expected to be a macro designating the conjugation-fr.xml file
+#endif
+
+#include <verbiste/FrenchVerbDictionary.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace verbiste;
+
+
+static const string testName = "checklayers";
+
+struct UserVerb
+{
+    const char *infinitive;
+    const char *templateName;
+    bool aspirateH;
+};
+
+// New verbs, one with accents and one with an aspirate h, and a verb
+// of the base layer that receives a second template.
+static const UserVerb userVerbs[] =
+{
+    { "bloguer", "aim:er", false },
+    { "t\xc3\xa9l\xc3\xa9verser", "aim:er", false },
+    { "hacker", "aim:er", true },
+    { "balayer", "grasse:yer", false },
+};
+
+static const size_t numUserVerbs = sizeof(userVerbs) / sizeof(userVerbs[0]);
+
+// Forms of the user verbs, with and without accents, and of verbs of
+// the base layer.
+static const char *words[] =
+{
+    "bloguer", "bloguons", "bloguerions", "blogu\xc3\xa9", "bloguerent",
+    "t\xc3\xa9l\xc3\xa9versons", "televersons", "t\xc3\xa9l\xc3\xa9vers\xc3\xa8rent",
+    "televerserent", "televerse",
+    "hacker", "hackais", "hackons",
+    "balaye", "balaie", "balayons", "balaierons",
+    "aimerions", "aime", "mangeons", "est", "fini", "pecher", "p\xc3\xaa" "cher",
+};
+
+static const size_t numWords = sizeof(words) / sizeof(words[0]);
+
+
+// Describes everything that the dictionary knows about the words
+// and the user verbs, one line per fact.
+//
+static string
+describe(const FrenchVerbDictionary &fvd)
+{
+    ostringstream s;
+    vector<InflectionDesc> results;
+    for (size_t i = 0; i < numWords; ++i)
+    {
+        results.clear();
+        fvd.deconjugate(words[i], results);
+        for (vector<InflectionDesc>::const_iterator it = results.begin(); it != results.end(); ++it)
+            s << words[i] << ": " << it->infinitive << " " << it->templateName
+              << " " << int(it->mtpn.mode) << " " << int(it->mtpn.tense)
+              << " " << int(it->mtpn.person) << " " << it->mtpn.plural << "\n";
+    }
+    for (size_t i = 0; i < numUserVerbs; ++i)
+    {
+        const char *infinitive = userVerbs[i].infinitive;
+        set<string> templates = fvd.getVerbTemplateSet(infinitive);
+        for (set<string>::const_iterator it = templates.begin(); it != templates.end(); ++it)
+            s << infinitive << " template " << *it << "\n";
+        s << infinitive << " aspirate h " << fvd.isVerbStartingWithAspirateH(infinitive) << "\n";
+    }
+    return s.str();
+}
+
+
+static string
+makeVerbsDocument(size_t skippedVerb)
+{
+    ostringstream s;
+    s << "<?xml version=\"1.0\"?>\n<verbs-fr>\n";
+    for (size_t i = 0; i < numUserVerbs; ++i)
+        if (i != skippedVerb)
+            s << "<v><i>" << userVerbs[i].infinitive << "</i>\t<t>"
+              << userVerbs[i].templateName << "</t>"
+              << (userVerbs[i].aspirateH ? " <aspirate-h/>" : "") << "</v>\n";
+    s << "</verbs-fr>\n";
+    return s.str();
+}
+
+
+static bool
+writeFile(const string &filename, const string &contents)
+{
+    ofstream file(filename.c_str());
+    file << contents;
+    return file.good();
+}
+
+
+// Reports the first line that differs between two descriptions.
+//
+static bool
+compare(const string &expected, const string &actual, const string &what)
+{
+    if (expected == actual)
+        return true;
+    istringstream e(expected), a(actual);
+    string expectedLine, actualLine;
+    for (;;)
+    {
+        bool hasExpected = getline(e, expectedLine).good();
+        bool hasActual = getline(a, actualLine).good();
+        if (!hasExpected && !hasActual)
+            break;
+        if (!hasExpected || !hasActual || expectedLine != actualLine)
+        {
+            cout << testName << ": " << what << ": expected \""
+                 << (hasExpected ? expectedLine : "(end)") << "\", got \""
+                 << (hasActual ? actualLine : "(end)") << "\"" << endl;
+            break;
+        }
+    }
+    return false;
+}
+
+
+int main()
+{
+    // The user's verbs file is created in a temporary $HOME.
+    char dir[] = "/tmp/checklayers.XXXXXX";
+    if (mkdtemp(dir) == NULL)
+    {
+        cout << testName << ": could not create a temporary directory" << endl;
+        return EXIT_FAILURE;
+    }
+    const string userDir = string(dir) + "/.verbiste";
+    const string userFilename = userDir + "/verbs-fr.xml";
+    const size_t removedVerb = 0;  // bloguer
+    const string reducedFilename = string(dir) + "/reduced-verbs-fr.xml";
+    if (mkdir(userDir.c_str(), 0700) != 0
+            || !writeFile(userFilename, makeVerbsDocument(numUserVerbs))
+            || !writeFile(reducedFilename, makeVerbsDocument(removedVerb)))
+    {
+        cout << testName << ": could not write the verbs files in " << dir << endl;
+        return EXIT_FAILURE;
+    }
+
+    size_t numErrors = 0;
+    try
+    {
+        setenv("HOME", dir, 1);
+        FrenchVerbDictionary fromHome(CONJUGATIONFRXML, VERBSFRXML, true,
+                                      FrenchVerbDictionary::FRENCH);
+        unsetenv("HOME");
+        FrenchVerbDictionary fromDocument(CONJUGATIONFRXML, VERBSFRXML, true,
+                                          FrenchVerbDictionary::FRENCH);
+        FrenchVerbDictionary fromVerbs(CONJUGATIONFRXML, VERBSFRXML, true,
+                                       FrenchVerbDictionary::FRENCH);
+        FrenchVerbDictionary reduced(CONJUGATIONFRXML, VERBSFRXML, true,
+                                     FrenchVerbDictionary::FRENCH);
+        const string baseDescription = describe(reduced);
+
+        fromDocument.addUserVerbs(userFilename);
+        for (size_t i = 0; i < numUserVerbs; ++i)
+            fromVerbs.addVerb(userVerbs[i].infinitive, userVerbs[i].templateName,
+                              userVerbs[i].aspirateH);
+        reduced.addUserVerbs(reducedFilename);
+
+        const string expected = describe(fromHome);
+        if (expected == baseDescription)
+        {
+            cout << testName << ": the user's verbs file was not read" << endl;
+            ++numErrors;
+        }
+
+        // Twice each: the second time, the answers come from the cache.
+        fromDocument.setLookupCache(1000);
+        fromVerbs.setLookupCache(1000);
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            if (!compare(expected, describe(fromDocument), "addUserVerbs()"))
+                ++numErrors;
+            if (!compare(expected, describe(fromVerbs), "addVerb()"))
+                ++numErrors;
+        }
+
+        // A form without accents, which has the templates of the verbs
+        // with accents, cannot be removed by itself.
+        if (fromVerbs.removeVerb("pecher"))
+        {
+            cout << testName << ": removeVerb() accepted a form without accents" << endl;
+            ++numErrors;
+        }
+        else if (!compare(expected, describe(fromVerbs), "removeVerb(\"pecher\")"))
+            ++numErrors;
+
+        // Removing a user verb must come back to the layer without it.
+        const string reducedDescription = describe(reduced);
+        FrenchVerbDictionary *dicts[] = { &fromHome, &fromDocument, &fromVerbs };
+        const char *names[] = { "verbs file", "addUserVerbs()", "addVerb()" };
+        for (size_t i = 0; i < 3; ++i)
+        {
+            if (!dicts[i]->removeVerb(userVerbs[removedVerb].infinitive))
+            {
+                cout << testName << ": " << names[i] << ": removeVerb() failed" << endl;
+                ++numErrors;
+            }
+            else if (!compare(reducedDescription, describe(*dicts[i]),
+                              string(names[i]) + " after removeVerb()"))
+                ++numErrors;
+        }
+    }
+    catch (const logic_error &e)
+    {
+        cout << testName << ": " << e.what() << endl;
+        ++numErrors;
+    }
+
+    unlink(userFilename.c_str());
+    unlink(reducedFilename.c_str());
+    rmdir(userDir.c_str());
+    rmdir(dir);
+
+    cout << numErrors << " error(s) found.\n";
+    return numErrors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,746 @@
+/*  $Id$
+    checklookup.cpp - Checks of the shortcuts taken by the lookups
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+/*  The forms of all the known verbs are generated from their templates,
+    with and without their accents.  The form filter must not reject
+    any of them.  The trie types must find the same prefixes of these
+    forms and of misspelled forms, and enumerate the same keys.  The
+    dictionary must give the same answers whatever the number of threads
+    that load it, and with its succinct trie.  A user verb must only
+    change the answers for its own forms, and removing the added verbs
+    must give the former answers back.  complete() must propose the
+    forms that begin with a prefix, and fuzzyDeconjugate() must find
+    the forms in which a typo has been made.
+*/
+
+#ifndef VERBSFRXML
+#error VERBSFRXML expected to be a macro designating the verbs-fr.xml file
+#endif
+#ifndef CONJUGATIONFRXML
+#error CONJUGATIONFRXML expected to be a macro designating the conjugation-fr.xml file
+#endif
+
+#include <verbiste/FrenchVerbDictionary.h>
+#include <verbiste/Trie.h>
+#include <verbiste/BitmapTrie.h>
+#include <verbiste/LoudsTrie.h>
+
+#include <algorithm>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace verbiste;
+
+
+static const string testName = "checklookup";
+
+// Number of failures of a check that are reported before going on
+// with the next check.
+static const size_t maxReportedErrors = 10;
+
+
+// Generates every correctly spelled form of every known verb,
+// in every mode and tense of each of its templates.
+//
+static void
+generateForms(const FrenchVerbDictionary &fvd, set<string> &forms)
+{
+    for (VerbTable::const_iterator it = fvd.beginKnownVerbs();
+                                   it != fvd.endKnownVerbs(); ++it)
+        for (set<string>::const_iterator tname = it->second.begin();
+                                         tname != it->second.end(); ++tname)
+        {
+            const TemplateSpec *templ = fvd.getTemplate(*tname);
+            if (templ == NULL)
+                continue;
+            string radical = FrenchVerbDictionary::getRadical(it->first, *tname);
+            for (TemplateSpec::const_iterator m = templ->begin(); m != templ->end(); ++m)
+                for (ModeSpec::const_iterator t = m->second.begin(); t != m->second.end(); ++t)
+                {
+                    vector< vector<string> > persons;
+                    fvd.generateTense(radical, *templ, m->first, t->first,
+                                      persons, false, false, false);
+                    for (size_t p = 0; p < persons.size(); ++p)
+                        forms.insert(persons[p].begin(), persons[p].end());
+                }
+        }
+}
+
+
+// Checks that mayBeConjugatedVerb() accepts every form, and the form
+// without its accents, which deconjugate() also finds.
+//
+static size_t
+checkFormFilter(const FrenchVerbDictionary &fvd, const set<string> &forms)
+{
+    size_t numErrors = 0;
+    for (set<string>::const_iterator it = forms.begin(); it != forms.end(); ++it)
+    {
+        string unaccented = fvd.removeUTF8Accents(*it);
+        const string *rejected = NULL;
+        if (!fvd.mayBeConjugatedVerb(*it))
+            rejected = &*it;
+        else if (!fvd.mayBeConjugatedVerb(unaccented))
+            rejected = &unaccented;
+        if (rejected == NULL)
+            continue;
+        cout << testName << ": verb rejected by the form filter: " << *rejected << endl;
+        if (++numErrors == maxReportedErrors)
+            break;
+    }
+    return numErrors;
+}
+
+
+// Writes the prefixes that a trie reports, with the number given
+// to each key as user data.
+//
+class RecordingReceiver : public TrieReceiver<int>
+{
+public:
+    RecordingReceiver(ostream &o) : out(o) {}
+    virtual bool onFoundPrefixWithUserData(const wstring &,
+                                           wstring::size_type index,
+                                           const int *userData)
+    {
+        out << " " << index << ":" << *userData;
+        return true;
+    }
+private:
+    ostream &out;
+};
+
+
+// Describes what get() finds for each query and what getWithPrefix()
+// enumerates for each prefix, one line per search.
+//
+template <class TrieType>
+static string
+describeSearches(const TrieType &trie,
+                 const vector<wstring> &queries,
+                 const vector<wstring> &prefixes)
+{
+    ostringstream s;
+    RecordingReceiver receiver(s);
+    for (size_t i = 0; i < queries.size(); ++i)
+    {
+        s << "get " << i << ":";
+        const int *found = trie.get(queries[i], receiver);
+        s << " -> " << (found == NULL ? -1 : *found) << "\n";
+    }
+    for (size_t i = 0; i < prefixes.size(); ++i)
+    {
+        s << "prefix " << i << ":";
+        (void) trie.getWithPrefix(prefixes[i], receiver);
+        s << "\n";
+    }
+    return s.str();
+}
+
+
+// Reports the first line that differs between two descriptions.
+//
+static bool
+compare(const string &expected, const string &actual, const string &what)
+{
+    if (expected == actual)
+        return true;
+    istringstream e(expected), a(actual);
+    string expectedLine, actualLine;
+    for (;;)
+    {
+        bool hasExpected = getline(e, expectedLine).good();
+        bool hasActual = getline(a, actualLine).good();
+        if (!hasExpected && !hasActual)
+            break;
+        if (!hasExpected || !hasActual || expectedLine != actualLine)
+        {
+            cout << testName << ": " << what << ": expected \""
+                 << (hasExpected ? expectedLine : "(end)") << "\", got \""
+                 << (hasActual ? actualLine : "(end)") << "\"" << endl;
+            break;
+        }
+    }
+    return false;
+}
+
+
+// Checks that BitmapTrie<T>, filled with add() or with build(), and
+// LoudsTrie<T> find the same prefixes as Trie<T>, and that after remove()
+// a BitmapTrie<T> is the same as a trie to which the removed keys were
+// never added.
+// The keys are the forms; the queries are every third form, its first
+// half, and the form with a changed or an added last letter.
+//
+static size_t
+checkTries(const FrenchVerbDictionary &fvd, const set<string> &forms)
+{
+    vector<wstring> keys;
+    for (set<string>::const_iterator it = forms.begin(); it != forms.end(); ++it)
+        keys.push_back(fvd.utf8ToWide(*it));
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    vector<int> numbers(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+        numbers[i] = int(i);
+
+    vector<wstring> queries, prefixes;
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        const wstring &k = keys[i];
+        if (i == 0 || keys[i - 1].compare(0, 2, k, 0, 2) != 0)
+            prefixes.push_back(k.substr(0, 2));
+        if (i % 3 != 0)
+            continue;
+        queries.push_back(k);
+        queries.push_back(k.substr(0, k.length() / 2));
+        queries.push_back(k.substr(0, k.length() - 1) + L'z');
+        queries.push_back(k + L's');
+    }
+    prefixes.push_back(L"");
+    prefixes.push_back(L"\x00e9t");  // "ét"
+    prefixes.push_back(L"zzz");
+
+    size_t numErrors = 0;
+    string expected;
+    {
+        Trie<int> trie(false);
+        for (size_t i = 0; i < keys.size(); ++i)
+            trie.add(keys[i], &numbers[i]);
+        expected = describeSearches(trie, queries, prefixes);
+    }
+
+    BitmapTrie<int>::EntryList entries;
+    for (size_t i = 0; i < keys.size(); ++i)
+        entries.push_back(make_pair(keys[i], &numbers[i]));
+    for (size_t numThreads = 1; numThreads <= 4; numThreads *= 4)
+    {
+        BitmapTrie<int> trie(false);
+        trie.build(entries, numThreads);
+        ostringstream what;
+        what << "BitmapTrie::build() with " << numThreads << " thread(s)";
+        if (!compare(expected, describeSearches(trie, queries, prefixes), what.str()))
+            ++numErrors;
+    }
+
+    LoudsTrie<int> loudsTrie(false);
+    if (!loudsTrie.build(entries))
+    {
+        cout << testName << ": LoudsTrie::build() failed" << endl;
+        ++numErrors;
+    }
+    else if (!compare(expected, describeSearches(loudsTrie, queries, prefixes),
+                      "LoudsTrie::build()"))
+        ++numErrors;
+
+    // Every other key is added to the reference trie, and all of
+    // them to the bitmap trie, from which the others are then removed.
+    // The keys are added from the last one, so that the dense codes
+    // of the characters are not given in increasing order.
+    Trie<int> halfTrie(false);
+    BitmapTrie<int> trie(false);
+    for (size_t i = keys.size(); i-- > 0; )
+    {
+        trie.add(keys[i], &numbers[i]);
+        if (i % 2 == 0)
+            halfTrie.add(keys[i], &numbers[i]);
+    }
+    if (!compare(expected, describeSearches(trie, queries, prefixes), "BitmapTrie::add()"))
+        ++numErrors;
+    for (size_t i = 1; i < keys.size(); i += 2)
+        if (trie.remove(keys[i]) != &numbers[i])
+        {
+            cout << testName << ": BitmapTrie::remove() did not find a key" << endl;
+            ++numErrors;
+            break;
+        }
+    if (!compare(describeSearches(halfTrie, queries, prefixes),
+                 describeSearches(trie, queries, prefixes), "BitmapTrie::remove()"))
+        ++numErrors;
+
+    return numErrors;
+}
+
+
+// Describes the results of deconjugate() for each word.
+//
+static string
+describeDeconjugations(const FrenchVerbDictionary &fvd, const vector<string> &words)
+{
+    ostringstream s;
+    for (size_t i = 0; i < words.size(); ++i)
+    {
+        vector<InflectionGroup> groups;
+        fvd.deconjugate(words[i], groups);
+        s << words[i] << ":";
+        for (vector<InflectionGroup>::const_iterator g = groups.begin(); g != groups.end(); ++g)
+        {
+            s << " " << g->infinitive << " " << g->templateName << " " << g->correctRadical;
+            for (vector<ModeTensePersonNumber>::const_iterator k = g->mtpns.begin();
+                                                               k != g->mtpns.end(); ++k)
+                s << " " << int(k->mode) << "," << int(k->tense) << ","
+                  << int(k->person) << "," << k->plural << "," << k->correct;
+        }
+        s << "\n";
+    }
+    return s.str();
+}
+
+
+// Describes the results of deconjugate() for each word, then the
+// words that complete() proposes for the first two letters of each
+// word, and those that fuzzyDeconjugate() finds for every 50th word.
+//
+static string
+describeLookups(const FrenchVerbDictionary &fvd, const vector<string> &words)
+{
+    ostringstream s;
+    s << describeDeconjugations(fvd, words);
+
+    FrenchVerbDictionary::CompletionOptions completionOptions;
+    completionOptions.maxResults = 0;
+    set<string> prefixes;
+    for (size_t i = 0; i < words.size(); ++i)
+        prefixes.insert(words[i].substr(0, 2));
+    for (set<string>::const_iterator it = prefixes.begin(); it != prefixes.end(); ++it)
+    {
+        vector<string> completions;
+        fvd.complete(*it, completionOptions, completions);
+        s << "complete " << *it << ":";
+        for (size_t i = 0; i < completions.size(); ++i)
+            s << " " << completions[i];
+        s << "\n";
+    }
+
+    FrenchVerbDictionary::FuzzyOptions fuzzyOptions;
+    fuzzyOptions.maxDistance = 1;
+    for (size_t i = 0; i < words.size(); i += 50)
+    {
+        vector<FrenchVerbDictionary::FuzzyMatch> matches;
+        fvd.fuzzyDeconjugate(words[i], fuzzyOptions, matches);
+        s << "fuzzy " << words[i] << ":";
+        for (size_t j = 0; j < matches.size(); ++j)
+            s << " " << matches[j].word << " " << matches[j].distance
+              << " " << matches[j].group.infinitive;
+        s << "\n";
+    }
+    return s.str();
+}
+
+
+// Appends to 'expected' the words of 'sortedWords' that begin with
+// 'prefix', in the order of 'sortedWords'.
+//
+static void
+findWithPrefix(const vector< pair<string, string> > &sortedWords,
+               const string &prefix, set<string> &expected)
+{
+    vector< pair<string, string> >::const_iterator it =
+            lower_bound(sortedWords.begin(), sortedWords.end(), make_pair(prefix, string()));
+    for ( ; it != sortedWords.end() && it->first.compare(0, prefix.length(), prefix) == 0; ++it)
+        expected.insert(it->second);
+}
+
+
+// Checks a completion for each prefix of two characters of the forms:
+// complete() must propose each form that begins with the prefix once,
+// and nothing else; with a limit of k words, it must propose the first
+// k words that it proposes without a limit.  With ignoreAccents, the
+// forms are those that begin with the prefix once the accents of both
+// are removed.  With infinitivesOnly, they are the known infinitives.
+//
+static size_t
+checkCompletion(const FrenchVerbDictionary &fvd, const set<string> &forms,
+                const set<string> &infinitives)
+{
+    // Each form with the key by which it is searched, the form itself
+    // or the form without its accents.
+    vector< pair<string, string> > byForm, byUnaccentedForm, byInfinitive;
+    set<string> prefixes;
+    for (set<string>::const_iterator it = forms.begin(); it != forms.end(); ++it)
+    {
+        byForm.push_back(make_pair(*it, *it));
+        byUnaccentedForm.push_back(make_pair(fvd.removeUTF8Accents(*it), *it));
+        prefixes.insert(fvd.wideToUTF8(fvd.utf8ToWide(*it).substr(0, 2)));
+    }
+    for (set<string>::const_iterator it = infinitives.begin(); it != infinitives.end(); ++it)
+        byInfinitive.push_back(make_pair(*it, *it));
+    sort(byUnaccentedForm.begin(), byUnaccentedForm.end());
+
+    size_t numErrors = 0;
+    for (int mode = 0; mode < 3; ++mode)
+    {
+        FrenchVerbDictionary::CompletionOptions options;
+        options.maxResults = 0;
+        options.ignoreAccents = (mode == 1);
+        options.infinitivesOnly = (mode == 2);
+        const char *modeName = (mode == 0 ? "" : mode == 1 ? " ignoring accents"
+                                                           : " of infinitives");
+
+        for (set<string>::const_iterator p = prefixes.begin(); p != prefixes.end(); ++p)
+        {
+            set<string> expected;
+            if (options.ignoreAccents)
+                findWithPrefix(byUnaccentedForm, fvd.removeUTF8Accents(*p), expected);
+            else
+                findWithPrefix(options.infinitivesOnly ? byInfinitive : byForm, *p, expected);
+
+            options.maxResults = 0;
+            vector<string> all;
+            fvd.complete(*p, options, all);
+            set<string> proposed(all.begin(), all.end());
+            if (proposed != expected || proposed.size() != all.size())
+            {
+                cout << testName << ": completion" << modeName << " of \"" << *p
+                     << "\": " << all.size() << " word(s) proposed, "
+                     << proposed.size() << " distinct, "
+                     << expected.size() << " expected" << endl;
+                if (++numErrors == maxReportedErrors)
+                    return numErrors;
+                continue;
+            }
+
+            for (options.maxResults = 1; options.maxResults <= 100; options.maxResults *= 10)
+            {
+                vector<string> first;
+                fvd.complete(*p, options, first);
+                size_t k = min(options.maxResults, all.size());
+                if (first.size() != k || !equal(first.begin(), first.end(), all.begin()))
+                {
+                    cout << testName << ": completion" << modeName << " of \"" << *p
+                         << "\" limited to " << options.maxResults
+                         << " word(s) is not the beginning of the whole completion" << endl;
+                    if (++numErrors == maxReportedErrors)
+                        return numErrors;
+                }
+            }
+        }
+    }
+    return numErrors;
+}
+
+
+// Returns true if fuzzyDeconjugate() finds 'expected' with the verb
+// 'infinitive' at 'distance' among the first 'maxRank' results for
+// 'word', and reports an error otherwise.
+//
+static bool
+checkFuzzyMatch(const FrenchVerbDictionary &fvd, const char *word,
+                const char *expected, const char *infinitive,
+                unsigned distance, size_t maxRank)
+{
+    FrenchVerbDictionary::FuzzyOptions options;
+    vector<FrenchVerbDictionary::FuzzyMatch> matches;
+    fvd.fuzzyDeconjugate(word, options, matches);
+    for (size_t i = 0; i < matches.size() && i < maxRank; ++i)
+        if (matches[i].word == expected)
+        {
+            if (matches[i].distance == distance && matches[i].group.infinitive == infinitive)
+                return true;
+            break;
+        }
+    cout << testName << ": fuzzyDeconjugate(\"" << word << "\") does not give \""
+         << expected << "\" (" << infinitive << ") at distance " << distance
+         << " among its first " << maxRank << " result(s)" << endl;
+    return false;
+}
+
+
+// Checks fuzzyDeconjugate() on typical typos, then on a typo made in
+// every 100th form: a deleted, doubled or replaced letter, or two
+// transposed letters.  The form must be found at a distance of at most
+// one, and the results must be sorted by distance.
+//
+static size_t
+checkFuzzy(const FrenchVerbDictionary &fvd, const set<string> &forms)
+{
+    size_t numErrors = 0;
+    if (!checkFuzzyMatch(fvd, "mangons", "mangeons", "manger", 1, 10))
+        ++numErrors;
+    if (!checkFuzzyMatch(fvd, "apeller", "appeler", "appeler", 2, 1))
+        ++numErrors;
+    if (!checkFuzzyMatch(fvd, "mangeons", "mangeons", "manger", 0, 1))
+        ++numErrors;
+
+    FrenchVerbDictionary::FuzzyOptions options;
+    options.maxDistance = 1;
+    options.maxResults = 0;
+    size_t counter = 0;
+    for (set<string>::const_iterator it = forms.begin(); it != forms.end(); ++it)
+    {
+        if (counter++ % 100 != 0)
+            continue;
+        wstring typo = fvd.utf8ToWide(*it);
+        if (typo.length() < 2)
+            continue;
+        size_t pos = (counter / 100) % (typo.length() - 1);
+        switch ((counter / 100) % 4)
+        {
+            case 0: typo.erase(pos, 1); break;
+            case 1: typo.insert(pos, 1, typo[pos]); break;
+            case 2: swap(typo[pos], typo[pos + 1]); break;
+            default: typo[pos] = (typo[pos] == L'x' ? L'y' : L'x'); break;
+        }
+        const string utf8Typo = fvd.wideToUTF8(typo);
+
+        vector<FrenchVerbDictionary::FuzzyMatch> matches;
+        fvd.fuzzyDeconjugate(utf8Typo, options, matches);
+        bool found = false, sorted = true;
+        for (size_t i = 0; i < matches.size(); ++i)
+        {
+            found = found || matches[i].word == *it;
+            sorted = sorted && (i == 0 || matches[i - 1].distance <= matches[i].distance)
+                     && matches[i].distance <= options.maxDistance;
+        }
+        if (!found || !sorted)
+        {
+            cout << testName << ": fuzzyDeconjugate(\"" << utf8Typo << "\") ";
+            if (found)
+                cout << "gives results out of order" << endl;
+            else
+                cout << "does not find " << *it << endl;
+            if (++numErrors == maxReportedErrors)
+                break;
+        }
+    }
+    return numErrors;
+}
+
+
+// Makes the words looked up by the checks of the dictionary: every
+// third form, the same form without its accents, and the form with
+// a changed last letter.
+//
+static void
+makeWords(const FrenchVerbDictionary &fvd, const set<string> &forms, vector<string> &words)
+{
+    size_t counter = 0;
+    for (set<string>::const_iterator it = forms.begin(); it != forms.end(); ++it)
+    {
+        if (counter++ % 3 != 0)
+            continue;
+        words.push_back(*it);
+        words.push_back(fvd.removeUTF8Accents(*it));
+        words.push_back(it->substr(0, it->length() - 1) + "z");
+    }
+}
+
+
+// Checks that the number of threads that load the documents changes
+// none of the answers of the dictionary.
+//
+static size_t
+checkLoading(const FrenchVerbDictionary &fvd, const vector<string> &words)
+{
+    const string expected = describeLookups(fvd, words);
+
+    static const size_t threadCounts[] = { 1, 3, 8 };
+    size_t numErrors = 0;
+    for (size_t i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); ++i)
+    {
+        FrenchVerbDictionary other(CONJUGATIONFRXML, VERBSFRXML, true,
+                                   FrenchVerbDictionary::FRENCH, threadCounts[i]);
+        ostringstream what;
+        what << "loading with " << threadCounts[i] << " thread(s)";
+        if (!compare(expected, describeLookups(other, words), what.str()))
+            ++numErrors;
+    }
+    return numErrors;
+}
+
+
+// Checks that adding a document of user verbs with addUserVerbs()
+// changes the answers for the forms of these verbs only.
+//
+static size_t
+checkUserLayer(const vector<string> &words)
+{
+    char filename[] = "/tmp/checklookup.XXXXXX";
+    int fd = mkstemp(filename);
+    if (fd < 0)
+    {
+        cout << testName << ": could not create a temporary file" << endl;
+        return 1;
+    }
+    static const char document[] =
+        "<?xml version=\"1.0\"?>\n"
+        "<verbs-fr>\n"
+        "<v><i>bloguer</i>\t<t>aim:er</t></v>\n"
+        "</verbs-fr>\n";
+    bool written = (write(fd, document, sizeof(document) - 1) == ssize_t(sizeof(document) - 1));
+    close(fd);
+    if (!written)
+    {
+        unlink(filename);
+        cout << testName << ": could not write " << filename << endl;
+        return 1;
+    }
+
+    vector<string> otherWords;
+    for (size_t i = 0; i < words.size(); ++i)
+        if (words[i].compare(0, 4, "blog") != 0)
+            otherWords.push_back(words[i]);
+
+    FrenchVerbDictionary fvd(CONJUGATIONFRXML, VERBSFRXML, true,
+                             FrenchVerbDictionary::FRENCH);
+    const string expected = describeDeconjugations(fvd, otherWords);
+    fvd.addUserVerbs(filename);
+    unlink(filename);
+
+    size_t numErrors = 0;
+    if (!compare(expected, describeDeconjugations(fvd, otherWords), "addUserVerbs()"))
+        ++numErrors;
+    vector<InflectionGroup> results;
+    fvd.deconjugate("bloguons", results);
+    if (results.empty())
+    {
+        cout << testName << ": verb of the user layer not found" << endl;
+        ++numErrors;
+    }
+    return numErrors;
+}
+
+
+// Checks that adding verbs with addVerb(), then removing them with
+// removeVerb(), gives the answers of the dictionary back, and that
+// removing a verb of the base layer hides it.  The radicals of the
+// added verbs have an accent, so that their forms without accents
+// are added and removed too.
+//
+static size_t
+checkMutations(const vector<string> &words)
+{
+    FrenchVerbDictionary fvd(CONJUGATIONFRXML, VERBSFRXML, true,
+                             FrenchVerbDictionary::FRENCH);
+    const string expected = describeDeconjugations(fvd, words);
+
+    vector<string> neologisms;
+    for (char a = 'a'; a <= 'z'; ++a)
+        for (char b = 'a'; b <= 'z'; b += 5)
+            neologisms.push_back(string("bl\303\251") + a + b + "xer");  // "blé..xer"
+    for (size_t i = 0; i < neologisms.size(); ++i)
+        fvd.addVerb(neologisms[i], "aim:er", false);
+
+    size_t numErrors = 0;
+    vector<InflectionGroup> results;
+    fvd.deconjugate("bleaaxons", results);  // without the accent
+    if (results.empty())
+    {
+        cout << testName << ": added verb not found" << endl;
+        ++numErrors;
+    }
+
+    for (size_t i = 0; i < neologisms.size(); ++i)
+        if (!fvd.removeVerb(neologisms[i]))
+        {
+            cout << testName << ": added verb " << neologisms[i] << " not removed" << endl;
+            ++numErrors;
+        }
+    if (!compare(expected, describeDeconjugations(fvd, words), "addVerb() and removeVerb()"))
+        ++numErrors;
+
+    results.clear();
+    if (!fvd.removeVerb("aimer"))
+    {
+        cout << testName << ": verb of the base layer not removed" << endl;
+        ++numErrors;
+    }
+    fvd.deconjugate("aimons", results);
+    if (!results.empty())
+    {
+        cout << testName << ": removed verb of the base layer still found" << endl;
+        ++numErrors;
+    }
+    return numErrors;
+}
+
+
+// Checks that useSuccinctTrie() changes none of the answers of the
+// dictionary.
+//
+static size_t
+checkSuccinctTrie(const vector<string> &words)
+{
+    FrenchVerbDictionary fvd(CONJUGATIONFRXML, VERBSFRXML, true,
+                             FrenchVerbDictionary::FRENCH);
+    const string expected = describeLookups(fvd, words);
+    if (!fvd.useSuccinctTrie())
+    {
+        cout << testName << ": useSuccinctTrie() failed" << endl;
+        return 1;
+    }
+    return compare(expected, describeLookups(fvd, words), "useSuccinctTrie()") ? 0 : 1;
+}
+
+
+int main()
+{
+    size_t numErrors = 0;
+    try
+    {
+        FrenchVerbDictionary fvd(CONJUGATIONFRXML, VERBSFRXML, true,
+                                 FrenchVerbDictionary::FRENCH);
+
+        // The known verbs of 'fvd' include their spellings without
+        // accents, whose radicals would be wrong.
+        set<string> forms, infinitives;
+        {
+            FrenchVerbDictionary correct(CONJUGATIONFRXML, VERBSFRXML, false,
+                                         FrenchVerbDictionary::FRENCH);
+            generateForms(correct, forms);
+            for (VerbTable::const_iterator it = correct.beginKnownVerbs();
+                                           it != correct.endKnownVerbs(); ++it)
+                infinitives.insert(it->first);
+        }
+        if (forms.empty())
+        {
+            cout << testName << ": no forms generated" << endl;
+            ++numErrors;
+        }
+
+        numErrors += checkFormFilter(fvd, forms);
+        numErrors += checkTries(fvd, forms);
+        numErrors += checkCompletion(fvd, forms, infinitives);
+        numErrors += checkFuzzy(fvd, forms);
+
+        vector<string> words, someWords;
+        makeWords(fvd, forms, words);
+        for (size_t i = 0; i < words.size(); i += 5)
+            someWords.push_back(words[i]);
+        numErrors += checkLoading(fvd, someWords);
+        numErrors += checkUserLayer(someWords);
+        numErrors += checkMutations(someWords);
+        numErrors += checkSuccinctTrie(words);
+    }
+    catch (const logic_error &e)
+    {
+        cout << testName << ": " << e.what() << endl;
+        ++numErrors;
+    }
+
+    cout << numErrors << " error(s) found.\n";
+    return numErrors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,141 @@
+/*  $Id$
+    checkpersons.cpp - Checks the person counters of ModeTensePersonNumber
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+/*  For every mode, tense and person of the conjugation documents of
+    every language, ModeTensePersonNumber::set() is given the position
+    of the person in its tense, as when the dictionary is loaded, and
+    getPersonCounter() must give that position back.
+*/
+
+#ifndef LIBDATADIR
+#error LIBDATADIR expected to be a macro designating the directory of the XML files
+#endif
+
+#include <verbiste/misc-types.h>
+
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdlib.h>
+
+#include <libxml/xmlmemory.h>
+#include <libxml/parser.h>
+
+using namespace std;
+
+
+static const string testName = "checkpersons";
+
+
+static bool
+isElement(xmlNodePtr node)
+{
+    return xmlStrcmp(node->name, reinterpret_cast<const xmlChar *>("text")) != 0
+            && xmlStrcmp(node->name, reinterpret_cast<const xmlChar *>("comment")) != 0;
+}
+
+
+// Checks the persons of the conjugation document of a language.
+// Each combination of a mode, a tense and a person is checked once.
+//
+static size_t
+checkLanguage(const string &languageCode, bool isItalian)
+{
+    const string filename = string(LIBDATADIR) + "/conjugation-" + languageCode + ".xml";
+    xmlDocPtr doc = xmlParseFile(filename.c_str());
+    if (doc == NULL)
+    {
+        cout << testName << ": could not open " << filename << endl;
+        return 1;
+    }
+    xmlNodePtr root = xmlDocGetRootElement(doc);
+    if (root == NULL)
+    {
+        cout << testName << ": could not get XML root element of " << filename << endl;
+        xmlFreeDoc(doc);
+        return 1;
+    }
+
+    size_t numErrors = 0;
+    set<string> checked;
+    for (xmlNodePtr templ = root->xmlChildrenNode; templ != NULL; templ = templ->next)
+    {
+        if (!isElement(templ))
+            continue;
+        for (xmlNodePtr mode = templ->xmlChildrenNode; mode != NULL; mode = mode->next)
+        {
+            if (!isElement(mode))
+                continue;
+            const char *modeName = reinterpret_cast<const char *>(mode->name);
+            for (xmlNodePtr tense = mode->xmlChildrenNode; tense != NULL; tense = tense->next)
+            {
+                if (!isElement(tense))
+                    continue;
+                const char *tenseName = reinterpret_cast<const char *>(tense->name);
+                int personCounter = 0;
+                for (xmlNodePtr person = tense->xmlChildrenNode;
+                                person != NULL; person = person->next)
+                {
+                    if (xmlStrcmp(person->name, reinterpret_cast<const xmlChar *>("p")) != 0)
+                        continue;
+                    ++personCounter;
+
+                    ostringstream combination;
+                    combination << modeName << " " << tenseName << " " << personCounter;
+                    if (!checked.insert(combination.str()).second)
+                        continue;
+
+                    ModeTensePersonNumber mtpn(modeName, tenseName, personCounter,
+                                               true, isItalian);
+                    int result = mtpn.getPersonCounter(isItalian);
+                    if (result != personCounter)
+                    {
+                        cout << testName << ": " << languageCode << ": "
+                             << combination.str() << ": getPersonCounter() gives "
+                             << result << endl;
+                        ++numErrors;
+                    }
+                }
+            }
+        }
+    }
+
+    if (checked.empty())
+    {
+        cout << testName << ": no persons found in " << filename << endl;
+        ++numErrors;
+    }
+    xmlFreeDoc(doc);
+    return numErrors;
+}
+
+
+int main()
+{
+    size_t numErrors = 0;
+    numErrors += checkLanguage("fr", false);
+    numErrors += checkLanguage("it", true);
+    numErrors += checkLanguage("el", false);
+
+    cout << numErrors << " error(s) found.\n";
+    return numErrors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
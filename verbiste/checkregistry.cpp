@@ -0,0 +1,216 @@
+/*  $Id$
+    checkregistry.cpp - Test of the dictionaries kept by DictionaryRegistry
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+/*  Checks the eviction of the least recently used dictionary, the
+    limit on the dictionaries loaded by the prefetch thread, get()
+    waiting for a dictionary that this thread is loading, and the
+    destruction of a registry while this thread is loading.
+*/
+
+#ifndef LIBDATADIR
+#error LIBDATADIR expected to be a macro designating the directory of the XML files
+#endif
+
+#include <verbiste/DictionaryRegistry.h>
+
+#include <iostream>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace verbiste;
+
+
+static const string testName = "checkregistry";
+
+static const FrenchVerbDictionary::Language french = FrenchVerbDictionary::FRENCH;
+static const FrenchVerbDictionary::Language italian = FrenchVerbDictionary::ITALIAN;
+static const FrenchVerbDictionary::Language greek = FrenchVerbDictionary::GREEK;
+
+static size_t numErrors = 0;
+
+
+static void
+check(bool condition, const string &what)
+{
+    if (!condition)
+    {
+        cout << testName << ": " << what << endl;
+        ++numErrors;
+    }
+}
+
+
+static double
+getTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+
+// Waits for the prefetch thread to load the dictionary of a language.
+//
+static bool
+waitForLoad(const DictionaryRegistry &registry, FrenchVerbDictionary::Language lang)
+{
+    for (int i = 0; i < 3000; ++i)  // at most 30 seconds
+    {
+        if (registry.isLoaded(lang))
+            return true;
+        usleep(10000);
+    }
+    return false;
+}
+
+
+static bool
+knowsVerb(FrenchVerbDictionary *fvd, const char *infinitive)
+{
+    return fvd != NULL && !fvd->getVerbTemplateSet(infinitive).empty();
+}
+
+
+// The least recently used dictionary is evicted first, but never
+// the one of the current language.
+//
+static void
+checkEviction()
+{
+    DictionaryRegistry registry(false, 2);
+    FrenchVerbDictionary *fr = registry.get(french);
+    check(knowsVerb(fr, "aimer"), "French dictionary without aimer");
+    check(knowsVerb(registry.get(italian), "amare"), "Italian dictionary without amare");
+    check(registry.get(french) == fr, "French dictionary loaded again");
+
+    // Italian is now the least recently used language.
+    check(knowsVerb(registry.get(greek), "bazbar"), "Greek dictionary without bazbar");
+    check(registry.getNumLoaded() == 2, "more than 2 dictionaries kept");
+    check(registry.isLoaded(french), "French evicted instead of Italian");
+    check(!registry.isLoaded(italian), "Italian not evicted");
+
+    registry.setMaxResident(1);
+    check(registry.getNumLoaded() == 1, "no eviction by setMaxResident()");
+    check(registry.isLoaded(greek), "current language evicted by setMaxResident()");
+
+    registry.setMaxResident(0);
+    (void) registry.get(french);
+    check(registry.evictUnused() == 1, "evictUnused() did not evict 1 dictionary");
+    check(registry.getNumLoaded() == 1 && registry.isLoaded(french),
+          "current language evicted by evictUnused()");
+}
+
+
+// The prefetch thread stops when the limit is reached, instead of
+// evicting.
+//
+static void
+checkPrefetchLimit()
+{
+    DictionaryRegistry registry(false, 2);
+    (void) registry.get(french);
+
+    vector<FrenchVerbDictionary::Language> langs;
+    langs.push_back(italian);
+    langs.push_back(greek);
+    double start = getTime();
+    check(registry.prefetch(langs), "prefetch thread not started");
+    if (!waitForLoad(registry, italian))
+    {
+        check(false, "Italian not prefetched");
+        return;
+    }
+
+    // Give the thread as much time again, in which it would have
+    // loaded the Greek dictionary if it ignored the limit.
+    double loadTime = getTime() - start;
+    usleep(useconds_t(loadTime * 2e6) + 100000);
+    check(!registry.isLoaded(greek), "Greek prefetched beyond the limit");
+    check(registry.getNumLoaded() == 2, "prefetch changed the number of dictionaries");
+    check(registry.isLoaded(french), "current language evicted by the prefetch");
+}
+
+
+// get() waits for the dictionary that the prefetch thread is loading,
+// instead of loading it a second time.
+//
+static void
+checkWaitForPrefetch()
+{
+    DictionaryRegistry registry(false);
+    vector<FrenchVerbDictionary::Language> langs(1, italian);
+    check(registry.prefetch(langs), "prefetch thread not started");
+    check(!registry.isLoaded(italian), "Italian loaded before the prefetch thread ran");
+
+    FrenchVerbDictionary *it = registry.get(italian);
+    check(knowsVerb(it, "amare"), "prefetched Italian dictionary without amare");
+    check(registry.getNumLoaded() == 1, "Italian loaded twice");
+    check(registry.get(italian) == it, "prefetched Italian dictionary replaced");
+}
+
+
+// The destructor stops the prefetch thread after the dictionary that
+// it is loading, and destroys the loaded ones.
+//
+static void
+checkDestructionDuringPrefetch()
+{
+    static const useconds_t delays[] = { 0, 1000, 20000, 100000 };
+    for (size_t i = 0; i < sizeof(delays) / sizeof(delays[0]); ++i)
+    {
+        DictionaryRegistry *registry = new DictionaryRegistry(false);
+        vector<FrenchVerbDictionary::Language> langs;
+        langs.push_back(french);
+        langs.push_back(italian);
+        langs.push_back(greek);
+        check(registry->prefetch(langs), "prefetch thread not started");
+        usleep(delays[i]);
+        delete registry;
+    }
+}
+
+
+int main()
+{
+    // The dictionaries are read from the source tree, unless they are
+    // compiled into the library, and the user's verbs are not read.
+    setenv("LIBDATADIR", LIBDATADIR, 1);
+    unsetenv("HOME");
+
+    try
+    {
+        checkEviction();
+        checkPrefetchLimit();
+        checkWaitForPrefetch();
+        checkDestructionDuringPrefetch();
+    }
+    catch (const logic_error &e)
+    {
+        cout << testName << ": " << e.what() << endl;
+        ++numErrors;
+    }
+
+    cout << numErrors << " error(s) found.\n";
+    return numErrors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,329 @@
+/*  $Id$
+    checkreload.cpp - Stress test of the reloading of a dictionary
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+/*  Reader threads look up verbs without interruption while the main
+    thread rewrites the verbs file, alternately with and without an
+    extra verb, and lets the watcher thread reload it, or reloads it
+    itself.  The file is also rewritten in place with the same size
+    and second of modification.  Each reader checks that the version it sees is consistent
+    and that the versions only move forward.
+*/
+
+#ifndef VERBSFRXML
+#error VERBSFRXML expected to be a macro designating the verbs-fr.xml file
+#endif
+#ifndef CONJUGATIONFRXML
+#error CONJUGATIONFRXML expected to be a macro designating the conjugation-fr.xml file
+#endif
+
+#include <verbiste/ReloadableDictionary.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace verbiste;
+
+
+static const string testName = "checkreload";
+
+static const size_t numReaders = 4;
+static const int numRewrites = 6;  // each one reloaded by the watcher
+static const int numReloads = 10;  // done by the main thread
+
+// Verb added by every other version of the verbs file.
+static const string extraVerbLine = "<v><i>bloguer</i>\t<t>aim:er</t></v>\n";
+
+
+struct Reader
+{
+    const ReloadableDictionary *dict;
+    volatile bool *stop;
+    pthread_t thread;
+    unsigned long numLookups;
+    unsigned long numVersionsSeen;
+    string error;  // empty if no inconsistency was found
+};
+
+
+static bool
+hasInfinitive(const vector<InflectionDesc> &results, const char *infinitive)
+{
+    for (vector<InflectionDesc>::const_iterator it = results.begin(); it != results.end(); ++it)
+        if (it->infinitive == infinitive)
+            return true;
+    return false;
+}
+
+
+static void *
+runReader(void *arg)
+{
+    Reader &r = *static_cast<Reader *>(arg);
+    unsigned long lastVersion = 0;
+    vector<InflectionDesc> results;
+    while (!*r.stop && r.error.empty())
+    {
+        ReloadableDictionary::ReadGuard fvd(*r.dict);
+        if (fvd.getVersion() < lastVersion)
+        {
+            ostringstream s;
+            s << "version " << fvd.getVersion() << " seen after " << lastVersion;
+            r.error = s.str();
+            break;
+        }
+        if (fvd.getVersion() != lastVersion)
+            ++r.numVersionsSeen;
+        lastVersion = fvd.getVersion();
+
+        results.clear();
+        fvd->deconjugate("aimerions", results);
+        if (!hasInfinitive(results, "aimer"))
+            r.error = "aimerions not recognized";
+
+        // The extra verb must be known by the whole version or not at all.
+        bool hasExtraVerb = !fvd->getVerbTemplateSet("bloguer").empty();
+        results.clear();
+        fvd->deconjugate("bloguons", results);
+        if (hasInfinitive(results, "bloguer") != hasExtraVerb)
+            r.error = "bloguons inconsistent with the templates of bloguer";
+
+        ++r.numLookups;
+    }
+    return NULL;
+}
+
+
+static bool
+readFile(const string &filename, string &contents)
+{
+    ifstream file(filename.c_str());
+    if (!file)
+        return false;
+    ostringstream s;
+    s << file.rdbuf();
+    contents = s.str();
+    return true;
+}
+
+
+// Replaces the file in one step, as editors and package managers do.
+//
+static bool
+writeFile(const string &filename, const string &contents)
+{
+    string tmpFilename = filename + ".tmp";
+    {
+        ofstream file(tmpFilename.c_str());
+        file << contents;
+        if (!file)
+            return false;
+    }
+    return rename(tmpFilename.c_str(), filename.c_str()) == 0;
+}
+
+
+// Rewrites the file in place, keeping its inode, as some editors do,
+// and gives it the modification time of the previous contents, to the
+// second, as if it were written within the same second.
+//
+static bool
+overwriteFile(const string &filename, const string &contents)
+{
+    struct stat statbuf;
+    if (stat(filename.c_str(), &statbuf) != 0)
+        return false;
+    int fd = open(filename.c_str(), O_WRONLY | O_TRUNC);
+    if (fd < 0)
+        return false;
+    bool ok = write(fd, contents.data(), contents.size()) == ssize_t(contents.size());
+    struct timespec times[2];
+    times[0].tv_sec = statbuf.st_atime;
+    times[0].tv_nsec = 0;
+    times[1].tv_sec = statbuf.st_mtime;
+    times[1].tv_nsec = 0;
+    ok = futimens(fd, times) == 0 && ok;
+    return close(fd) == 0 && ok;
+}
+
+
+// Waits for the watcher thread to publish a version after 'version'.
+//
+static bool
+waitForReload(const ReloadableDictionary &dict, unsigned long version)
+{
+    for (int i = 0; i < 1000; ++i)  // at most 10 seconds
+    {
+        if (dict.getVersion() > version)
+            return true;
+        usleep(10000);
+    }
+    return false;
+}
+
+
+int main()
+{
+    string baseVerbs;
+    if (!readFile(VERBSFRXML, baseVerbs))
+    {
+        cout << testName << ": could not read " << VERBSFRXML << endl;
+        return EXIT_FAILURE;
+    }
+    string::size_type end = baseVerbs.rfind("</verbs-fr>");
+    if (end == string::npos)
+    {
+        cout << testName << ": no </verbs-fr> in " << VERBSFRXML << endl;
+        return EXIT_FAILURE;
+    }
+    string extendedVerbs = baseVerbs;
+    extendedVerbs.insert(end, extraVerbLine);
+
+    // $HOME is pointed to the same directory, so that the user's
+    // verbs are not read.
+    char dir[] = "/tmp/checkreload.XXXXXX";
+    if (mkdtemp(dir) == NULL)
+    {
+        cout << testName << ": could not create a temporary directory" << endl;
+        return EXIT_FAILURE;
+    }
+    setenv("HOME", dir, 1);
+    const string verbsFilename = string(dir) + "/verbs-fr.xml";
+    if (!writeFile(verbsFilename, baseVerbs))
+    {
+        cout << testName << ": could not write " << verbsFilename << endl;
+        return EXIT_FAILURE;
+    }
+
+    size_t numErrors = 0;
+    {
+        ReloadableDictionary dict(CONJUGATIONFRXML, verbsFilename, false,
+                                  FrenchVerbDictionary::FRENCH);
+        if (!dict.startWatching())
+        {
+            cout << testName << ": could not start watching" << endl;
+            return EXIT_FAILURE;
+        }
+
+        volatile bool stop = false;
+        Reader readers[numReaders];
+        for (size_t i = 0; i < numReaders; ++i)
+        {
+            readers[i].dict = &dict;
+            readers[i].stop = &stop;
+            readers[i].numLookups = 0;
+            readers[i].numVersionsSeen = 0;
+            pthread_create(&readers[i].thread, NULL, runReader, &readers[i]);
+        }
+
+        for (int i = 0; i < numRewrites; ++i)
+        {
+            unsigned long version = dict.getVersion();
+            if (!writeFile(verbsFilename, i % 2 == 0 ? extendedVerbs : baseVerbs))
+            {
+                cout << testName << ": could not write " << verbsFilename << endl;
+                ++numErrors;
+                break;
+            }
+            if (!waitForReload(dict, version))
+            {
+                cout << testName << ": rewrite #" << i << " not reloaded" << endl;
+                ++numErrors;
+            }
+        }
+
+        // A rewrite in place of the same size has the inode, size and
+        // second of modification of the previous one.
+        string renamedVerbs = extendedVerbs;
+        renamedVerbs.replace(renamedVerbs.find("bloguer"), 7, "tweeter");
+        for (int i = 0; i < 2; ++i)
+        {
+            unsigned long version = dict.getVersion();
+            if (!overwriteFile(verbsFilename, i == 0 ? extendedVerbs : renamedVerbs))
+            {
+                cout << testName << ": could not write " << verbsFilename << endl;
+                ++numErrors;
+                break;
+            }
+            if (!waitForReload(dict, version))
+            {
+                cout << testName << ": rewrite in place #" << i << " not reloaded" << endl;
+                ++numErrors;
+            }
+        }
+        {
+            ReloadableDictionary::ReadGuard fvd(dict);
+            if (fvd->getVerbTemplateSet("tweeter").empty())
+            {
+                cout << testName << ": rewrite of the same size not reloaded" << endl;
+                ++numErrors;
+            }
+        }
+
+        for (int i = 0; i < numReloads; ++i)
+            if (!dict.reload())
+            {
+                cout << testName << ": reload failed: " << dict.getLastReloadError() << endl;
+                ++numErrors;
+            }
+
+        // A broken file must keep the current version.
+        unsigned long version = dict.getVersion();
+        if (!writeFile(verbsFilename, "<verbs-fr>"))
+            ++numErrors;
+        else if (dict.reload() || dict.getLastReloadError().empty()
+                 || dict.getVersion() != version)
+        {
+            cout << testName << ": broken file not rejected" << endl;
+            ++numErrors;
+        }
+
+        dict.stopWatching();
+        stop = true;
+        for (size_t i = 0; i < numReaders; ++i)
+        {
+            pthread_join(readers[i].thread, NULL);
+            if (!readers[i].error.empty())
+            {
+                cout << testName << ": reader #" << i << ": " << readers[i].error << endl;
+                ++numErrors;
+            }
+            else if (readers[i].numLookups == 0)
+            {
+                cout << testName << ": reader #" << i << " did no lookup" << endl;
+                ++numErrors;
+            }
+        }
+    }
+
+    unlink(verbsFilename.c_str());
+    rmdir(dir);
+
+    cout << numErrors << " error(s) found.\n";
+    return numErrors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -103,6 +103,31 @@ ModeTensePersonNumber::set(const char *modeName,
 }
 
 
+int
+ModeTensePersonNumber::getPersonCounter(bool isItalian) const
+{
+    if (mode == INVALID_MODE)
+        return 0;
+
+    if (mode == IMPERATIVE_MODE)
+    {
+        if (person == 0)
+            return 0;
+        if (isItalian)
+            return plural ? person + 2 : person - 1;
+        return plural ? person + 1 : 1;
+    }
+
+    if (mode == PARTICIPLE_MODE)
+        return (person == 5 ? 3 : 1) + (plural ? 1 : 0);
+
+    if (person == 0)  // infinitive or gerund: a single person
+        return 1;
+
+    return person + (plural ? 3 : 0);
+}
+
+
 void
 ModeTensePersonNumber::dump(Verbiste_ModeTensePersonNumber &destination) const
 {
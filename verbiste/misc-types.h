@@ -162,6 +162,17 @@ public:
     void set(const char *modeName, const char *tenseName, int personNum, bool isCorrect, bool isItalian);
 
 
+    /** Returns the person "counter" that set() was given, i.e., the
+        position (from 1) of this person in its tense, as in the
+        conjugation templates and in the persons that
+        FrenchVerbDictionary::generateTense() produces.
+        @param    isItalian     true for Italian, false for French
+        @returns                a value from 1 to 6, or 0 if this object
+                                does not designate a valid person
+    */
+    int getPersonCounter(bool isItalian) const;
+
+
     /**
         Dumps the fields of this object into those of the destination object.
         @param    destination   object whose fields (mode, tense, person,
@@ -282,4 +293,47 @@ public:
 };
 
 
+/**
+    Description of the inflections of a conjugated verb that belong
+    to a single verb and conjugation template.
+    For example, "aime" is described by one group for the verb "aimer"
+    and the template "aim:er", which contains five mode-tense-person
+    combinations.
+*/
+class InflectionGroup
+{
+public:
+
+    /** Infinitive form of the conjugated verb (UTF-8). */
+    std::string infinitive;
+
+    /** Conjugated template used by the verb (e.g. "aim:er") (UTF-8). */
+    std::string templateName;
+
+    /** Modes, tenses, persons and numbers of the inflection,
+        in the order in which the template defines them.
+    */
+    std::vector<ModeTensePersonNumber> mtpns;
+
+    /** Indicates if the radical of the conjugated verb was correctly
+        spelled (false if it was only recognized by tolerating
+        missing accents).
+    */
+    bool correctRadical;
+
+    /**
+        Constructs an inflection group from optional arguments.
+    */
+    InflectionGroup(const std::string &inf = "",
+                    const std::string &tname = "",
+                    bool isCorrectRadical = true)
+      : infinitive(inf),
+        templateName(tname),
+        mtpns(),
+        correctRadical(isCorrectRadical)
+    {
+    }
+};
+
+
 #endif  /* _H_misc_types */
@@ -0,0 +1,347 @@
+/*  $Id$
+    mkdictimage.cpp - Generates the dictionary images compiled into the library
+
+    verbiste - French conjugation system
+    Copyright (C) 2003-2010 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+    02111-1307, USA.
+*/
+
+/*  Usage: mkdictimage DATADIR LANGCODE...
+    Reads DATADIR/conjugation-LANGCODE.xml and DATADIR/verbs-LANGCODE.xml
+    for each language and writes to the standard output a C++ source
+    file that defines the DictionaryImage tables of these languages
+    (see DictionaryImage.h).
+    The documents are walked the way FrenchVerbDictionary walks them,
+    so that the tables give the same dictionary.
+*/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+#include <libxml/xmlmemory.h>
+#include <libxml/parser.h>
+
+using namespace std;
+
+
+static const string programName = "mkdictimage";
+
+
+class AutoDoc
+{
+public:
+    AutoDoc(xmlDocPtr d) : doc(d) {}
+    ~AutoDoc() { if (doc != NULL) xmlFreeDoc(doc); }
+    xmlDocPtr get() const { return doc; }
+    bool operator ! () const { return doc == NULL; }
+private:
+    xmlDocPtr doc;
+
+    // Forbidden operations:
+    AutoDoc(const AutoDoc &);
+    AutoDoc &operator = (const AutoDoc &);
+};
+
+
+inline bool
+equal(const xmlChar *a, const char *b)
+{
+    return xmlStrcmp(a, reinterpret_cast<const xmlChar *>(b)) == 0;
+}
+
+
+// Returns the text of a list of nodes, or an empty string.
+//
+static string
+getNodeText(xmlDocPtr doc, xmlNodePtr node)
+{
+    xmlChar *s = xmlNodeListGetString(doc, node, 1);
+    if (s == NULL)
+        return string();
+    string text = reinterpret_cast<char *>(s);
+    xmlFree(s);
+    return text;
+}
+
+
+// Returns a C++ string literal for a UTF-8 string.
+// The bytes outside printable ASCII are written as octal escapes,
+// which always have three digits and thus cannot absorb the next
+// character.  '?' is escaped to avoid trigraphs.
+//
+static string
+quote(const string &s)
+{
+    static const char digits[] = "01234567";
+    string literal = "\"";
+    for (string::const_iterator it = s.begin(); it != s.end(); ++it)
+    {
+        unsigned char c = (unsigned char) *it;
+        if (c == '"' || c == '\\' || c == '?')
+        {
+            literal += '\\';
+            literal += char(c);
+        }
+        else if (c >= 0x20 && c < 0x7F)
+            literal += char(c);
+        else
+        {
+            literal += '\\';
+            literal += digits[(c >> 6) & 7];
+            literal += digits[(c >> 3) & 7];
+            literal += digits[c & 7];
+        }
+    }
+    return literal + "\"";
+}
+
+
+static string
+quoteOrNull(const xmlChar *s)
+{
+    return s == NULL ? string("NULL") : quote(reinterpret_cast<const char *>(s));
+}
+
+
+// Adds a row to the table of template rows.
+//
+static void
+addRow(ostream &rows, size_t &numRows, const xmlChar *mode, const xmlChar *tense,
+       int person, bool startsPerson, const string *inflection)
+{
+    rows << "    { " << quoteOrNull(mode)
+         << ", " << quoteOrNull(tense)
+         << ", " << person
+         << ", " << (startsPerson ? "true" : "false")
+         << ", " << (inflection == NULL ? string("NULL") : quote(*inflection))
+         << " },\n";
+    ++numRows;
+}
+
+
+// Writes the tables of the conjugation document of a language.
+// Returns false, after printing an error message, if the document
+// is not as expected.
+//
+static bool
+writeConjugation(const string &filename, const string &langCode, ostream &out)
+{
+    AutoDoc doc(xmlParseFile(filename.c_str()));
+    if (!doc)
+    {
+        cerr << programName << ": could not parse " << filename << endl;
+        return false;
+    }
+
+    xmlNodePtr root = xmlDocGetRootElement(doc.get());
+    if (root == NULL || !equal(root->name, ("conjugation-" + langCode).c_str()))
+    {
+        cerr << programName << ": " << filename << ": expected <conjugation-"
+             << langCode << "> as the top node" << endl;
+        return false;
+    }
+
+    ostringstream templates, rows;
+    size_t numRows = 0;
+    for (xmlNodePtr templ = root->xmlChildrenNode; templ != NULL; templ = templ->next)
+    {
+        if (!equal(templ->name, "template"))
+            continue;
+
+        xmlChar *name = xmlGetProp(templ, reinterpret_cast<const xmlChar *>("name"));
+        string tname = (name != NULL ? reinterpret_cast<char *>(name) : "");
+        xmlFree(name);
+        if (tname.empty())
+        {
+            cerr << programName << ": " << filename << ": missing template name attribute" << endl;
+            return false;
+        }
+        if (tname.find(':') == string::npos)
+        {
+            cerr << programName << ": " << filename << ": missing colon in template name "
+                 << tname << endl;
+            return false;
+        }
+
+        size_t firstRow = numRows;
+        for (xmlNodePtr mode = templ->xmlChildrenNode; mode != NULL; mode = mode->next)
+        {
+            if (equal(mode->name, "text") || equal(mode->name, "comment"))
+                continue;
+
+            size_t modeRow = numRows;
+            for (xmlNodePtr tense = mode->xmlChildrenNode; tense != NULL; tense = tense->next)
+            {
+                if (equal(tense->name, "text") || equal(tense->name, "comment"))
+                    continue;
+
+                size_t tenseRow = numRows;
+                int personCounter = 0;
+                for (xmlNodePtr person = tense->xmlChildrenNode; person != NULL; person = person->next)
+                {
+                    if (!equal(person->name, "p"))
+                        continue;
+
+                    ++personCounter;
+                    bool startsPerson = true;
+                    for (xmlNodePtr inf = person->xmlChildrenNode; inf != NULL; inf = inf->next)
+                    {
+                        string inflection = getNodeText(doc.get(), inf->xmlChildrenNode);
+                        addRow(rows, numRows, mode->name, tense->name,
+                               personCounter, startsPerson, &inflection);
+                        startsPerson = false;
+                    }
+                    if (startsPerson)  // person without inflection
+                        addRow(rows, numRows, mode->name, tense->name,
+                               personCounter, true, NULL);
+                }
+                if (numRows == tenseRow)  // tense without person
+                    addRow(rows, numRows, mode->name, tense->name, 0, false, NULL);
+            }
+            if (numRows == modeRow)  // mode without tense
+                addRow(rows, numRows, mode->name, NULL, 0, false, NULL);
+        }
+
+        templates << "    { " << quote(tname) << ", " << firstRow << ", "
+                  << numRows - firstRow << " },\n";
+    }
+
+    out << "static const DictionaryImage::Template templates_" << langCode << "[] =\n"
+        << "{\n"
+        << templates.str()
+        << "    { NULL, 0, 0 }  // end marker, not counted\n"
+        << "};\n"
+        << "\n"
+        << "static const DictionaryImage::TemplateRow templateRows_" << langCode << "[] =\n"
+        << "{\n"
+        << rows.str()
+        << "    { NULL, NULL, 0, false, NULL }  // end marker, not counted\n"
+        << "};\n"
+        << "\n";
+    return true;
+}
+
+
+// Writes the table of the verbs document of a language.
+// Returns false, after printing an error message, if the document
+// is not as expected.
+//
+static bool
+writeVerbs(const string &filename, const string &langCode, ostream &out)
+{
+    AutoDoc doc(xmlParseFile(filename.c_str()));
+    if (!doc)
+    {
+        cerr << programName << ": could not parse " << filename << endl;
+        return false;
+    }
+
+    xmlNodePtr root = xmlDocGetRootElement(doc.get());
+    if (root == NULL || !equal(root->name, ("verbs-" + langCode).c_str()))
+    {
+        cerr << programName << ": " << filename << ": expected <verbs-"
+             << langCode << "> as the top node" << endl;
+        return false;
+    }
+
+    out << "static const DictionaryImage::Verb verbs_" << langCode << "[] =\n"
+        << "{\n";
+    for (xmlNodePtr v = root->xmlChildrenNode; v != NULL; v = v->next)
+    {
+        if (equal(v->name, "text") || equal(v->name, "comment"))
+            continue;
+
+        xmlNodePtr i = v->xmlChildrenNode;
+        xmlNodePtr t = (i != NULL && i->next != NULL ? i->next->next : NULL);
+        if (i == NULL || i->xmlChildrenNode == NULL || t == NULL)
+        {
+            cerr << programName << ": " << filename << ": missing <i> or <t> node" << endl;
+            return false;
+        }
+
+        string infinitive = getNodeText(doc.get(), i->xmlChildrenNode);
+        string tname = getNodeText(doc.get(), t->xmlChildrenNode);
+        bool aspirateH = (t->next != NULL && t->next->next != NULL);
+        out << "    { " << quote(infinitive) << ", " << quote(tname) << ", "
+            << (aspirateH ? "true" : "false") << " },\n";
+    }
+    out << "    { NULL, NULL, false }  // end marker, not counted\n"
+        << "};\n"
+        << "\n";
+    return true;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        cerr << "Usage: " << programName << " DATADIR LANGCODE..." << endl;
+        return EXIT_FAILURE;
+    }
+
+    const string dataDir = argv[1];
+    ostringstream out;
+    out << "// Generated by " << programName << " from the documents of " << dataDir << ".\n"
+        << "// Do not edit.\n"
+        << "\n"
+        << "#include \"DictionaryImage.h\"\n"
+        << "\n"
+        << "\n"
+        << "namespace verbiste {\n"
+        << "\n"
+        << "\n";
+
+    for (int a = 2; a < argc; ++a)
+    {
+        const string langCode = argv[a];
+        if (!writeConjugation(dataDir + "/conjugation-" + langCode + ".xml", langCode, out))
+            return EXIT_FAILURE;
+        if (!writeVerbs(dataDir + "/verbs-" + langCode + ".xml", langCode, out))
+            return EXIT_FAILURE;
+    }
+
+    out << "const DictionaryImage dictionaryImages[] =\n"
+        << "{\n";
+    for (int a = 2; a < argc; ++a)
+    {
+        const string langCode = argv[a];
+        out << "    {\n"
+            << "        " << quote(langCode) << ",\n"
+            << "        templates_" << langCode << ",\n"
+            << "        sizeof(templates_" << langCode << ") / sizeof(templates_"
+                                        << langCode << "[0]) - 1,\n"
+            << "        templateRows_" << langCode << ",\n"
+            << "        verbs_" << langCode << ",\n"
+            << "        sizeof(verbs_" << langCode << ") / sizeof(verbs_"
+                                        << langCode << "[0]) - 1\n"
+            << "    },\n";
+    }
+    out << "};\n"
+        << "\n"
+        << "const size_t numDictionaryImages = " << argc - 2 << ";\n"
+        << "\n"
+        << "\n"
+        << "}  // namespace verbiste\n";
+
+    cout << out.str();
+    return cout.good() ? EXIT_SUCCESS : EXIT_FAILURE;
+}